@@ -14,17 +14,11 @@
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
 
-/* Error codes */
-#define INVALID_VAL -1 /* Invalid argument */
-#define COMM_ERR    -2 /* Communication error on receive */
-#define TIMEOUT     -3 /* A timeout has occured */
-
 /*
- * Post reset delay required to ensure all internal config done
- * A time of 2ms should be enough based on the data sheet, but 4ms
- * chosen to provide enough margin, in case mdelay is not accurate.
+ * The serial interface is back 64 MCLK cycles (104 us at 614.4 kHz) after a
+ * reset, the rest of the internal setup is polled for with SPI_IGNORE_ERR.
  */
-#define AD7124_POST_RESET_DELAY      4
+#define AD7124_POST_RESET_DELAY_US   110
 #define buflen 8
 
 
@@ -230,12 +224,18 @@ int32_t ad7124_reset(struct ad7124_dev *dev)
 	/* CRC is disabled after reset */
 	dev->use_crc = AD7124_DISABLE_CRC;
 
+	sleep_us(AD7124_POST_RESET_DELAY_US);
+
+	/* The device ignores the bus until its internal setup is done */
+	ret = ad7124_wait_for_spi_ready(dev,
+					dev->spi_rdy_poll_cnt);
+	if (ret < 0)
+		return ret;
+
 	/* Read POR bit to clear */
 	ret = ad7124_wait_to_power_on(dev,
 				      dev->spi_rdy_poll_cnt);
 
-	sleep_ms(4);
-
 	return ret;
 }
 
@@ -449,6 +449,37 @@ void ad7124_update_dev_spi_settings(struct ad7124_dev *dev)
 	}
 }
 
+/***************************************************************************//**
+ * @brief Returns the value a register has after a reset.
+ *
+ * @param reg - The register.
+ *
+ * @return The power-on value, or -1 for registers without a fixed one (read
+ *         only, factory calibrated).
+*******************************************************************************/
+static int32_t ad7124_power_on_value(enum ad7124_registers reg)
+{
+	if (reg == AD7124_Channel_0)
+		return 0x8001;
+	if (reg > AD7124_Channel_0 && reg <= AD7124_Channel_15)
+		return 0x0001;
+	if (reg >= AD7124_Config_0 && reg <= AD7124_Config_7)
+		return 0x0860;
+	if (reg >= AD7124_Filter_0 && reg <= AD7124_Filter_7)
+		return 0x060180;
+
+	switch (reg) {
+	case AD7124_ADC_Control:
+	case AD7124_IOCon1:
+	case AD7124_IOCon2:
+		return 0;
+	case AD7124_Error_En:
+		return 0x000040;
+	default:
+		return -1;
+	}
+}
+
 /***************************************************************************//**
  * @brief Initializes the AD7124.
  *
@@ -471,20 +502,26 @@ int32_t ad7124_setup(struct ad7124_dev **device,
 
 	dev->regs = init_param.regs;
 	dev->spi_rdy_poll_cnt = init_param.spi_rdy_poll_cnt;	
+	dev->check_ready = 1;
 
 	/*  Reset the device interface.*/
 	ret = ad7124_reset(dev);
-	if (ret < 0)
+	if (ret < 0) {
+		/* *device is left as it was, nothing else holds dev */
+		free(dev);
 		return ret;
+	}
 
-	/* Update the device structure with power-on/reset settings */
-	dev->check_ready = 1;
-
-	/* Initialize registers AD7124_ADC_Control through AD7124_Filter_7. */
-	for(reg_nr = AD7124_Status; (reg_nr < AD7124_Offset_0) && !(ret < 0);
+	/*
+	 * Initialize registers AD7124_IOCon1 through AD7124_Filter_7. Those
+	 * still at their power-on value are skipped. Nothing here can make the
+	 * device ignore the bus, the ready check after the reset covers them.
+	 */
+	for(reg_nr = AD7124_IOCon1; (reg_nr < AD7124_Offset_0) && !(ret < 0);
 	    reg_nr++) {
-		if (dev->regs[reg_nr].rw == AD7124_RW) {
-			ret = ad7124_write_register(dev, dev->regs[reg_nr]);
+		if (dev->regs[reg_nr].rw == AD7124_RW &&
+		    dev->regs[reg_nr].value != ad7124_power_on_value(reg_nr)) {
+			ret = ad7124_no_check_write_register(dev, dev->regs[reg_nr]);
 			if (ret < 0)
 				break;
 		}
@@ -496,6 +533,11 @@ int32_t ad7124_setup(struct ad7124_dev **device,
 		}
 	}
 
+	/* The mode goes last, with everything it converts set up */
+	if (!(ret < 0) &&
+	    dev->regs[AD7124_ADC_Control].value != ad7124_power_on_value(AD7124_ADC_Control))
+		ret = ad7124_write_register(dev, dev->regs[AD7124_ADC_Control]);
+
 	*device = dev;
 
 	return ret;
@@ -322,6 +322,11 @@ struct ad7124_init_param {
 #define AD7124_DISABLE_CRC 0
 #define AD7124_USE_CRC 1
 
+/* Error codes */
+#define INVALID_VAL -1 /* Invalid argument */
+#define COMM_ERR    -2 /* Communication error on receive */
+#define TIMEOUT     -3 /* A timeout has occured */
+
 /*! Reads the value of the specified register. */
 int32_t ad7124_read_register(struct ad7124_dev *dev,
 			     struct ad7124_st_reg* p_reg);
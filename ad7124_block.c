@@ -0,0 +1,153 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_block.c
+
+  @brief: Channel-major sample blocks, triple buffered between the stream
+          and its consumers
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "ad7124_block.h"
+#include "ad7124_stats.h"
+
+struct ad7124_blocks ad7124_blocks = {
+	.filling = &ad7124_blocks.buffers[0],
+};
+
+static void clear_block(struct ad7124_block *block, uint16_t channels)
+{
+	block->sequence = ad7124_blocks.completed;
+	block->channels = channels;
+	block->scans = 0;
+	memset(block->valid, 0, sizeof(block->valid));
+}
+
+/*!
+ * @brief      Publishes the filling block and returns the next one
+ *
+ * @details    When the consumer still holds every other buffer the block is
+ *             dropped and filled again, the consumer sees the gap in the
+ *             sequence numbers. Never waits.
+ */
+struct ad7124_block *ad7124_block_swap(void)
+{
+	struct ad7124_blocks *blocks = &ad7124_blocks;
+	uint32_t start = time_us_32();
+	uint32_t head = blocks->head;
+	uint16_t channels = blocks->filling->channels;
+	uint32_t swap_us;
+
+	blocks->filling->completed_us = start;
+	blocks->completed++;
+	if (head - blocks->tail < AD7124_BLOCK_BUFFERS - 1) {
+		// make the block visible before the index that publishes it
+		__dmb();
+		blocks->head = ++head;
+		blocks->filling = &blocks->buffers[head % AD7124_BLOCK_BUFFERS];
+		ad7124_stats_queue_depth(ad7124_stats_this_core(), head - blocks->tail);
+	} else {
+		blocks->dropped++;
+	}
+	clear_block(blocks->filling, channels);
+
+	swap_us = time_us_32() - start;
+	if (swap_us > blocks->swap_max_us)
+		blocks->swap_max_us = swap_us;
+	return blocks->filling;
+}
+
+/*!
+ * @brief      Turns the collection of blocks on or off, for consumers
+ *
+ * @details    Takes effect with the next stream.
+ */
+void ad7124_block_enable(bool enable)
+{
+	ad7124_blocks.enabled = enable;
+}
+
+/*!
+ * @brief      Starts the rows of a new stream in a cleared block
+ *
+ * @details    Blocks still held or queued for the consumer stay valid.
+ */
+void ad7124_block_start(uint16_t channels)
+{
+	struct ad7124_blocks *blocks = &ad7124_blocks;
+
+	blocks->completed = 0;
+	blocks->dropped = 0;
+	blocks->swap_max_us = 0;
+	blocks->latency_max_us = 0;
+	blocks->filling = &blocks->buffers[blocks->head % AD7124_BLOCK_BUFFERS];
+	clear_block(blocks->filling, channels);
+}
+
+/*!
+ * @brief      Publishes the rows collected when the stream stops
+ *
+ * @details
+ */
+void ad7124_block_flush(void)
+{
+	if (ad7124_blocks.enabled && ad7124_blocks.filling->scans > 0)
+		ad7124_block_swap();
+}
+
+/*!
+ * @brief      Oldest published block, NULL when there is none
+ *
+ * @details    The block belongs to the consumer until ad7124_block_release().
+ */
+const struct ad7124_block *ad7124_block_acquire(void)
+{
+	struct ad7124_blocks *blocks = &ad7124_blocks;
+	uint32_t tail = blocks->tail;
+	const struct ad7124_block *block;
+	uint32_t latency_us;
+
+	if (tail == blocks->head)
+		return NULL;
+
+	__dmb();
+	block = &blocks->buffers[tail % AD7124_BLOCK_BUFFERS];
+	latency_us = time_us_32() - block->completed_us;
+	if (latency_us > blocks->latency_max_us)
+		blocks->latency_max_us = latency_us;
+	return block;
+}
+
+/*!
+ * @brief      Hands the block from ad7124_block_acquire() back to the stream
+ *
+ * @details
+ */
+void ad7124_block_release(void)
+{
+	// done reading the block before the producer may reuse it
+	__dmb();
+	ad7124_blocks.tail++;
+}
+
+/*!
+ * @brief      Prints the block counters of the last stream
+ *
+ * @details
+ */
+void ad7124_block_print(void)
+{
+	struct ad7124_blocks *blocks = &ad7124_blocks;
+
+	if (!blocks->enabled && !blocks->completed)
+		return;
+	printf("blocks of %u scans %lu, dropped %lu, swap max %lu us, consumer latency max %lu us\r\n",
+	       AD7124_BLOCK_SCANS, blocks->completed, blocks->dropped,
+	       blocks->swap_max_us, blocks->latency_max_us);
+}
@@ -0,0 +1,91 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_block.h
+
+  @brief: Channel-major sample blocks, triple buffered between the stream
+          and its consumers
+
+  @details: The stream writes every scan as one row of a block: the row's
+            timestamp goes in a shared column, each channel's code in that
+            channel's contiguous array and a bit in the channel's validity
+            map tells a read conversion from a lost one. Full blocks are
+            published to a single producer / single consumer ring of
+            AD7124_BLOCK_BUFFERS blocks, so a consumer on either core can
+            work on one block while the stream fills the next. Blocks are
+            only collected while a consumer has enabled them.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_BLOCK_H_
+#define AD7124_BLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AD7124_BLOCK_CHANNELS	16
+/* Scans per block, one bit each in the validity maps */
+#define AD7124_BLOCK_SCANS	32
+/* One filling, up to two with the consumer */
+#define AD7124_BLOCK_BUFFERS	3
+
+struct ad7124_block {
+	uint32_t sequence;		/* blocks completed before, gaps are dropped blocks */
+	uint32_t completed_us;
+	uint16_t channels;		/* enabled channel mask */
+	uint8_t scans;			/* rows filled, fewer only when the stream stopped */
+	uint32_t valid[AD7124_BLOCK_CHANNELS];	/* bit per scan */
+	uint32_t timestamp_us[AD7124_BLOCK_SCANS];	/* first conversion of each scan */
+	int32_t codes[AD7124_BLOCK_CHANNELS][AD7124_BLOCK_SCANS];
+};
+
+struct ad7124_blocks {
+	struct ad7124_block buffers[AD7124_BLOCK_BUFFERS];
+	struct ad7124_block *filling;
+	// head is only written by the producer, tail only by the consumer
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile bool enabled;
+	uint32_t completed;
+	uint32_t dropped;		/* completed while the consumer held the others */
+	uint32_t swap_max_us;		/* producer time to publish and take the next buffer */
+	uint32_t latency_max_us;	/* completion to acquire by the consumer */
+};
+
+extern struct ad7124_blocks ad7124_blocks;
+
+struct ad7124_block *ad7124_block_swap(void);
+
+/* Opens the row of a new scan, called for the first channel of each scan */
+static inline void ad7124_block_row(uint32_t timestamp_us)
+{
+	struct ad7124_block *block = ad7124_blocks.filling;
+
+	if (!ad7124_blocks.enabled)
+		return;
+	if (block->scans == AD7124_BLOCK_SCANS)
+		block = ad7124_block_swap();
+	block->timestamp_us[block->scans++] = timestamp_us;
+}
+
+/* Stores a channel of the open row, lost conversions are stored as invalid */
+static inline void ad7124_block_put(uint8_t channel, int32_t code, bool valid)
+{
+	struct ad7124_block *block = ad7124_blocks.filling;
+	uint8_t scan;
+
+	if (!ad7124_blocks.enabled || block->scans == 0)
+		return;
+	scan = block->scans - 1;
+	block->codes[channel][scan] = code;
+	if (valid)
+		block->valid[channel] |= 1u << scan;
+}
+
+void ad7124_block_enable(bool enable);
+void ad7124_block_start(uint16_t channels);
+void ad7124_block_flush(void);
+const struct ad7124_block *ad7124_block_acquire(void);
+void ad7124_block_release(void);
+void ad7124_block_print(void);
+
+#endif /* AD7124_BLOCK_H_ */
@@ -0,0 +1,40 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_boot.c
+
+  @brief: Timestamps of the boot stages, from reset to the first sample
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+
+#include "ad7124_boot.h"
+
+uint32_t ad7124_boot_us[AD7124_BOOT_STAGES];
+
+static const char *const stage_names[AD7124_BOOT_STAGES] = {
+	"main", "stdio", "spi/gpio", "adc setup", "verify", "calibration",
+	"first sample"
+};
+
+/*!
+ * @brief      Prints the time of every stage since reset and since the
+ *             previous stage
+ *
+ * @details    Stages not reached yet, e.g. no stream since boot, are left out.
+ */
+void ad7124_boot_print(void)
+{
+	uint32_t previous = 0;
+
+	printf("boot stages, us since reset (step):\r\n");
+	for (uint8_t stage = 0; stage < AD7124_BOOT_STAGES; stage++) {
+		if (ad7124_boot_us[stage] == 0)
+			continue;
+		printf("  %-12s %8lu (%lu)\r\n", stage_names[stage],
+		       ad7124_boot_us[stage], ad7124_boot_us[stage] - previous);
+		previous = ad7124_boot_us[stage];
+	}
+}
@@ -0,0 +1,40 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_boot.h
+
+  @brief: Timestamps of the boot stages, from reset to the first sample
+
+  @details: Each stage is stamped once with the microsecond timer, which
+            starts counting at reset, so the first stamp includes the boot
+            ROM and the runtime init. Later marks of a stage are ignored.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_BOOT_H_
+#define AD7124_BOOT_H_
+
+#include <stdint.h>
+#include "hardware/timer.h"
+
+enum ad7124_boot_stage {
+	AD7124_BOOT_MAIN = 0,		/* entry of main() */
+	AD7124_BOOT_STDIO,		/* stdio and command input up */
+	AD7124_BOOT_IO,			/* SPI and gpios configured */
+	AD7124_BOOT_ADC_SETUP,		/* reset and register writes done */
+	AD7124_BOOT_VERIFY,		/* register image read back */
+	AD7124_BOOT_CALIBRATION,	/* stored calibration restored */
+	AD7124_BOOT_FIRST_SAMPLE,	/* first conversion read by the stream */
+	AD7124_BOOT_STAGES
+};
+
+extern uint32_t ad7124_boot_us[AD7124_BOOT_STAGES];
+
+static inline void ad7124_boot_mark(enum ad7124_boot_stage stage)
+{
+	if (ad7124_boot_us[stage] == 0)
+		ad7124_boot_us[stage] = time_us_32();
+}
+
+void ad7124_boot_print(void);
+
+#endif /* AD7124_BOOT_H_ */
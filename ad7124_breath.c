@@ -0,0 +1,208 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_breath.c
+
+  @brief: Breath detection on one channel, for the respiratory boards
+
+  @details: The filter coefficients are designed once per stream in floating
+            point, the samples only see integer arithmetic. The high pass
+            starts from the first sample so the offset of the channel does
+            not ring through the filters. Peaks are delayed by the group
+            delay of the filters, a few hundred ms.
+ -----------------------------------------------------------------------------
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "ad7124_breath.h"
+
+struct ad7124_breath ad7124_breath = {
+	.min_amplitude = AD7124_BREATH_DEFAULT_MIN_AMPLITUDE,
+};
+
+static int32_t q28(double value)
+{
+	return (int32_t)lround(value * (1 << 28));
+}
+
+/* Butterworth second order section, after the RBJ audio EQ cookbook */
+static void design(struct ad7124_biquad *filter, bool high_pass, double corner_hz,
+		   double rate_hz)
+{
+	double w0 = 2 * M_PI * corner_hz / rate_hz;
+	double alpha = sin(w0) / (2 * M_SQRT1_2);
+	double a0 = 1 + alpha;
+	double b0 = (high_pass ? 1 + cos(w0) : 1 - cos(w0)) / 2;
+
+	memset(filter, 0, sizeof(*filter));
+	filter->b0 = q28(b0 / a0);
+	filter->b1 = q28((high_pass ? -2 : 2) * b0 / a0);
+	filter->b2 = filter->b0;
+	filter->a1 = q28(-2 * cos(w0) / a0);
+	filter->a2 = q28((1 - alpha) / a0);
+}
+
+static int32_t biquad(struct ad7124_biquad *filter, int32_t x)
+{
+	int64_t acc = (int64_t)filter->b0 * x + (int64_t)filter->b1 * filter->x1 +
+		      (int64_t)filter->b2 * filter->x2 - (int64_t)filter->a1 * filter->y1 -
+		      (int64_t)filter->a2 * filter->y2;
+	int32_t y = (acc + (1 << 27)) >> 28;
+
+	filter->x2 = filter->x1;
+	filter->x1 = x;
+	filter->y2 = filter->y1;
+	filter->y1 = y;
+	return y;
+}
+
+static uint8_t breath_found(struct ad7124_breath *breath, int32_t amplitude)
+{
+	uint32_t interval = breath->have_peak ? breath->peak_ms - breath->last_peak_ms : 0;
+
+	// a pause longer than an apnea is no breathing interval
+	if (interval && interval < AD7124_BREATH_APNEA_MS) {
+		breath->intervals[breath->next_interval] = interval;
+		breath->next_interval = (breath->next_interval + 1) % AD7124_BREATH_INTERVALS;
+		if (breath->interval_count < AD7124_BREATH_INTERVALS)
+			breath->interval_count++;
+	} else {
+		interval = 0;
+	}
+	breath->have_peak = true;
+	breath->last_peak_ms = breath->peak_ms;
+	breath->breaths++;
+	breath->breath_ms = breath->peak_ms;
+	breath->amplitude = amplitude >> 4;
+	breath->interval_ms = interval;
+	breath->envelope += (amplitude - breath->envelope) / 4;
+	return AD7124_BREATH_EVENT_BREATH;
+}
+
+static uint8_t rate_update(struct ad7124_breath *breath, uint32_t time_ms)
+{
+	uint32_t total = 0;
+
+	breath->next_rate_ms += AD7124_BREATH_RATE_MS;
+	breath->rate_ms = time_ms;
+	breath->apnea = time_ms - breath->last_peak_ms >= AD7124_BREATH_APNEA_MS;
+	if (breath->apnea)
+		breath->interval_count = 0;
+	for (uint8_t i = 0; i < breath->interval_count; i++)
+		total += breath->intervals[i];
+	breath->rate_x10 = total ? (600000 * breath->interval_count + total / 2) / total : 0;
+	breath->mean_amplitude = breath->envelope >> 4;
+	return AD7124_BREATH_EVENT_RATE;
+}
+
+/*!
+ * @brief      Designs the filters for a channel rate and clears the detector
+ *
+ * @details    rate_mhz is the output rate of the channel in mHz, zero_code
+ *             its code at 0 V. mode, channel and min_amplitude are left as
+ *             they are.
+ */
+void ad7124_breath_init(struct ad7124_breath *breath, uint32_t rate_mhz, int32_t zero_code)
+{
+	uint8_t mode = breath->mode;
+	uint8_t channel = breath->channel;
+	int32_t min_amplitude = breath->min_amplitude;
+	double rate_hz;
+
+	memset(breath, 0, sizeof(*breath));
+	breath->mode = mode;
+	breath->channel = channel;
+	breath->min_amplitude = min_amplitude;
+	breath->zero_code = zero_code;
+
+	breath->decimation = rate_mhz / (AD7124_BREATH_PIPELINE_HZ * 1000);
+	if (breath->decimation == 0)
+		breath->decimation = 1;
+	rate_hz = rate_mhz / 1000.0 / breath->decimation;
+	breath->decay_samples = AD7124_BREATH_DECAY_MS * rate_hz / 1000;
+	design(&breath->high_pass, true, AD7124_BREATH_LOW_MHZ / 1000.0, rate_hz);
+	design(&breath->low_pass, false, AD7124_BREATH_HIGH_MHZ / 1000.0, rate_hz);
+}
+
+/*!
+ * @brief      Takes one code of the channel, returns the events it completed
+ *
+ * @details    AD7124_BREATH_EVENT_BREATH with breath_ms, amplitude and
+ *             interval_ms set, AD7124_BREATH_EVENT_RATE with rate_ms,
+ *             rate_x10, mean_amplitude and apnea set.
+ */
+uint8_t ad7124_breath_sample(struct ad7124_breath *breath, uint32_t time_ms, int32_t code)
+{
+	uint8_t events = 0;
+	int32_t threshold;
+	int32_t x, y;
+
+	breath->pending_sum += code - breath->zero_code;
+	if (++breath->pending < breath->decimation)
+		return 0;
+	x = (breath->pending_sum * 16) / breath->pending;
+	breath->pending = 0;
+	breath->pending_sum = 0;
+
+	if (!breath->started) {
+		breath->started = true;
+		breath->start_ms = time_ms;
+		breath->high_pass.x1 = x;
+		breath->high_pass.x2 = x;
+	}
+	y = biquad(&breath->low_pass, biquad(&breath->high_pass, x));
+
+	if (!breath->settled) {
+		// the first amplitude is the largest swing while the filters settle
+		if (y > breath->peak)
+			breath->peak = y;
+		if (y < breath->trough)
+			breath->trough = y;
+		if (time_ms - breath->start_ms < AD7124_BREATH_SETTLE_MS)
+			return 0;
+		breath->settled = true;
+		breath->envelope = breath->peak - breath->trough;
+		breath->trough = y;
+		breath->trough_ms = time_ms;
+		breath->last_peak_ms = time_ms;
+		breath->next_rate_ms = time_ms + AD7124_BREATH_RATE_MS;
+	}
+
+	breath->envelope -= breath->envelope / (int32_t)(breath->decay_samples + 1);
+	threshold = breath->envelope > breath->min_amplitude * 16 ?
+		    breath->envelope : breath->min_amplitude * 16;
+	threshold = threshold * AD7124_BREATH_THRESHOLD_PCT / 100;
+
+	// peaks and troughs are turns by more than the threshold, wherever the baseline is
+	if (breath->rising) {
+		if (y > breath->peak) {
+			breath->peak = y;
+			breath->peak_ms = time_ms;
+		} else if (y < breath->peak - threshold) {
+			int32_t amplitude = breath->peak - breath->trough;
+
+			breath->rising = false;
+			breath->trough = y;
+			breath->trough_ms = time_ms;
+			if (breath->peak_ms - breath->rise_ms <= AD7124_BREATH_MAX_RISE_MS &&
+			    (!breath->have_peak ||
+			     breath->peak_ms - breath->last_peak_ms >= AD7124_BREATH_MIN_INTERVAL_MS))
+				events |= breath_found(breath, amplitude);
+		}
+	} else {
+		if (y < breath->trough) {
+			breath->trough = y;
+			breath->trough_ms = time_ms;
+		} else if (y > breath->trough + threshold) {
+			breath->rising = true;
+			breath->rise_ms = breath->trough_ms;
+			breath->peak = y;
+			breath->peak_ms = time_ms;
+		}
+	}
+
+	if ((int32_t)(time_ms - breath->next_rate_ms) >= 0)
+		events |= rate_update(breath, time_ms);
+	return events;
+}
@@ -0,0 +1,116 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_breath.h
+
+  @brief: Breath detection on one channel, for the respiratory boards
+
+  @details: The samples of the channel are averaged down to at most
+            AD7124_BREATH_PIPELINE_HZ, band-passed by a second order high
+            pass and low pass in fixed point and searched for turns larger
+            than a share of the breath amplitude, so a wandering baseline
+            does not hide breaths. Every breath gives
+            an event with its amplitude and the interval to the one before,
+            every AD7124_BREATH_RATE_MS a rate update gives the breath rate
+            over the last intervals, or an apnea. The same code runs in the
+            firmware and in the host tool tools/ad7124_breath_replay.c.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_BREATH_H_
+#define AD7124_BREATH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Pass band, 3 to 90 breaths per minute */
+#define AD7124_BREATH_LOW_MHZ		50
+#define AD7124_BREATH_HIGH_MHZ		1500
+/* Highest rate the filters run at, faster channels are averaged down */
+#define AD7124_BREATH_PIPELINE_HZ	25
+
+/* Filter start up, the first amplitude is taken over it */
+#define AD7124_BREATH_SETTLE_MS		5000
+/* Turn that makes a peak or trough, as a share of the breath amplitude */
+#define AD7124_BREATH_THRESHOLD_PCT	30
+/* Amplitude decays to nothing over about this long without breaths */
+#define AD7124_BREATH_DECAY_MS		8000
+/* Smallest breath counted, in codes peak to trough, when none is given */
+#define AD7124_BREATH_DEFAULT_MIN_AMPLITUDE	16
+#define AD7124_BREATH_MIN_INTERVAL_MS	1000
+/* Longest inhale, slower rises are baseline wander that got through the high pass */
+#define AD7124_BREATH_MAX_RISE_MS	6000
+#define AD7124_BREATH_APNEA_MS		10000
+#define AD7124_BREATH_RATE_MS		5000
+/* Intervals averaged into the rate */
+#define AD7124_BREATH_INTERVALS		4
+
+/* Returned by ad7124_breath_sample() */
+#define AD7124_BREATH_EVENT_BREATH	0x01
+#define AD7124_BREATH_EVENT_RATE	0x02
+
+enum ad7124_breath_mode {
+	AD7124_BREATH_OFF,
+	AD7124_BREATH_EVENTS,		/* events instead of the sample rows */
+	AD7124_BREATH_RAW		/* events and the sample rows */
+};
+
+/* Direct form I, Q28 coefficients, Q4 codes */
+struct ad7124_biquad {
+	int32_t b0, b1, b2, a1, a2;
+	int32_t x1, x2, y1, y2;
+};
+
+struct ad7124_breath {
+	uint8_t mode;			/* enum ad7124_breath_mode, kept by init */
+	uint8_t channel;		/* kept by init */
+	int32_t min_amplitude;		/* codes, kept by init */
+	int32_t zero_code;
+	uint16_t decimation;
+	uint16_t pending;
+	int64_t pending_sum;
+	uint32_t decay_samples;
+	struct ad7124_biquad high_pass;
+	struct ad7124_biquad low_pass;
+
+	bool started;
+	bool settled;
+	bool rising;
+	bool have_peak;
+	uint32_t start_ms;
+	int32_t envelope;		/* Q4 codes, peak to trough */
+	int32_t peak;
+	int32_t trough;
+	uint32_t peak_ms;
+	uint32_t trough_ms;
+	uint32_t rise_ms;		/* trough before the peak */
+	uint32_t last_peak_ms;
+	uint32_t next_rate_ms;
+	uint32_t intervals[AD7124_BREATH_INTERVALS];
+	uint8_t interval_count;
+	uint8_t next_interval;
+
+	// the last events
+	uint32_t breath_ms;
+	int32_t amplitude;		/* codes */
+	uint32_t interval_ms;		/* 0 for the first breath */
+	uint32_t rate_ms;
+	uint16_t rate_x10;		/* breaths per minute, 0 without intervals */
+	int32_t mean_amplitude;		/* codes */
+	bool apnea;
+	uint32_t breaths;
+};
+
+extern struct ad7124_breath ad7124_breath;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ad7124_breath_init(struct ad7124_breath *breath, uint32_t rate_mhz, int32_t zero_code);
+uint8_t ad7124_breath_sample(struct ad7124_breath *breath, uint32_t time_ms, int32_t code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AD7124_BREATH_H_ */
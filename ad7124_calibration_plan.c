@@ -0,0 +1,53 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_calibration_plan.c
+
+  @brief: Plans one calibration per setup instead of one per channel
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include "ad7124_calibration_plan.h"
+
+#define PLAN_CHANNELS	16
+
+/*!
+ * @brief      Fills in the calibration steps for the enabled channels
+ *
+ * @details    Steps come out in setup order, the channel of a step is the
+ *             highest enabled channel of the setup, the one the channel by
+ *             channel calibration used to leave its result. Returns the
+ *             number of steps.
+ */
+uint8_t ad7124_calibration_plan(const struct ad7124_st_reg *regs, uint8_t modes,
+				struct ad7124_calibration_step *steps)
+{
+	int8_t channel_of_setup[AD7124_CAL_STEPS];
+	uint8_t count = 0;
+	uint8_t setup;
+
+	for (setup = 0; setup < AD7124_CAL_STEPS; setup++)
+		channel_of_setup[setup] = -1;
+
+	for (uint8_t ch = 0; ch < PLAN_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value;
+
+		if (value & AD7124_CH_MAP_REG_CH_ENABLE)
+			channel_of_setup[(value >> 12) & 0x7] = ch;
+	}
+
+	for (setup = 0; setup < AD7124_CAL_STEPS; setup++) {
+		if (channel_of_setup[setup] < 0)
+			continue;
+		steps[count].channel = channel_of_setup[setup];
+		steps[count].setup = setup;
+		steps[count].modes = modes;
+		// gain 1 is calibrated in the factory, internal full-scale is refused
+		if ((regs[AD7124_Config_0 + setup].value & AD7124_CFG_REG_PGA(0x7)) == 0)
+			steps[count].modes &= ~AD7124_CAL_INTERNAL_FULL_SCALE;
+		count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,37 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_calibration_plan.h
+
+  @brief: Plans one calibration per setup instead of one per channel
+
+  @details: The offset and gain registers belong to the eight setups, so of
+            several channels sharing a setup only the calibration done last
+            survives. The plan keeps that channel and drops the others, and
+            drops the internal full-scale calibration at gain 1, where the
+            device does not support it.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_CALIBRATION_PLAN_H_
+#define AD7124_CALIBRATION_PLAN_H_
+
+#include <stdint.h>
+#include "ad7124.h"
+
+/* At most one step per setup */
+#define AD7124_CAL_STEPS		8
+
+/* Calibrations of a step, run in this order on the same channel */
+#define AD7124_CAL_INTERNAL_FULL_SCALE	(1 << 0)
+#define AD7124_CAL_SYSTEM_ZERO_SCALE	(1 << 1)
+
+struct ad7124_calibration_step {
+	uint8_t channel;	/* channel whose inputs are used */
+	uint8_t setup;
+	uint8_t modes;		/* AD7124_CAL_* */
+};
+
+uint8_t ad7124_calibration_plan(const struct ad7124_st_reg *regs, uint8_t modes,
+				struct ad7124_calibration_step *steps);
+
+#endif /* AD7124_CALIBRATION_PLAN_H_ */
@@ -0,0 +1,168 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_capture.c
+
+  @brief: Triggered capture with a pre-trigger ring buffer
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stddef.h>
+
+#include "ad7124_capture.h"
+
+enum capture_state {
+	CAPTURE_ARMED,
+	CAPTURE_TRIGGERED,
+	CAPTURE_COMPLETE
+};
+
+struct ad7124_capture_config ad7124_capture_config = {
+	500,				// pre_trigger_ms
+	500,				// post_trigger_ms
+	AD7124_TRIGGER_HOST,		// sources
+	0,				// gpio_pin
+	AD7124_TRIGGER_FALLING,		// gpio_edge
+	0,				// level_channel
+	AD7124_TRIGGER_RISING,		// level_edge
+	0x800000			// level_code, zero volt when bipolar
+};
+
+static struct ad7124_capture_sample samples[AD7124_CAPTURE_DEPTH];
+static uint32_t samples_head = 0;	// total samples pushed since arming
+
+static enum capture_state state = CAPTURE_ARMED;
+static uint32_t trigger_ms = 0;
+static uint32_t window_start = 0;	// index of the first pre-trigger sample
+
+// last code of the level channel, to detect crossings
+static int32_t level_previous = 0;
+static bool level_previous_valid = false;
+
+/*!
+ * @brief      Drops the current window and starts filling the ring again
+ *
+ * @details
+ */
+void ad7124_capture_arm(void)
+{
+	samples_head = 0;
+	window_start = 0;
+	level_previous_valid = false;
+	state = CAPTURE_ARMED;
+}
+
+bool ad7124_capture_triggered(void)
+{
+	return state != CAPTURE_ARMED;
+}
+
+uint32_t ad7124_capture_trigger_ms(void)
+{
+	return trigger_ms;
+}
+
+/*!
+ * @brief      Freezes the pre-trigger history in front of timestamp_ms
+ *
+ * @details    Ignored unless armed, a window holds one trigger.
+ */
+void ad7124_capture_trigger(uint32_t timestamp_ms)
+{
+	uint32_t oldest;
+
+	if (state != CAPTURE_ARMED)
+		return;
+
+	trigger_ms = timestamp_ms;
+	oldest = samples_head > AD7124_CAPTURE_DEPTH ? samples_head - AD7124_CAPTURE_DEPTH : 0;
+
+	// walk back to the first sample inside the pre-trigger time
+	window_start = samples_head;
+	while (window_start > oldest &&
+	       (int32_t)(trigger_ms - samples[(window_start - 1) & (AD7124_CAPTURE_DEPTH - 1)].timestamp_ms)
+	       <= ad7124_capture_config.pre_trigger_ms) {
+		window_start--;
+	}
+	state = CAPTURE_TRIGGERED;
+}
+
+/*!
+ * @brief      Triggers on a captured input edge if the gpio source is enabled
+ *
+ * @details
+ */
+void ad7124_capture_gpio_event(const struct ad7124_gpio_event *event)
+{
+	struct ad7124_capture_config *config = &ad7124_capture_config;
+
+	if (!(config->sources & AD7124_TRIGGER_GPIO) || event->pin != config->gpio_pin)
+		return;
+
+	if ((event->rising && (config->gpio_edge & AD7124_TRIGGER_RISING)) ||
+	    (!event->rising && (config->gpio_edge & AD7124_TRIGGER_FALLING))) {
+		ad7124_capture_trigger(event->timestamp_us / 1000);
+	}
+}
+
+/*!
+ * @brief      Stores a sample and evaluates the level trigger
+ *
+ * @details    Returns true once the window is complete, either because the
+ *             post-trigger time has passed or because the ring is full.
+ */
+bool ad7124_capture_push(const struct ad7124_capture_sample *sample)
+{
+	struct ad7124_capture_config *config = &ad7124_capture_config;
+
+	if (state == CAPTURE_COMPLETE)
+		return true;
+
+	if ((config->sources & AD7124_TRIGGER_LEVEL) &&
+	    sample->channel == config->level_channel &&
+	    !(sample->flags & AD7124_CAPTURE_OVERRUN)) {
+		if (level_previous_valid &&
+		    (((config->level_edge & AD7124_TRIGGER_RISING) &&
+		      level_previous < config->level_code && sample->code >= config->level_code) ||
+		     ((config->level_edge & AD7124_TRIGGER_FALLING) &&
+		      level_previous > config->level_code && sample->code <= config->level_code))) {
+			ad7124_capture_trigger(sample->timestamp_ms);
+		}
+		level_previous = sample->code;
+		level_previous_valid = true;
+	}
+
+	if (state == CAPTURE_TRIGGERED) {
+		if ((int32_t)(sample->timestamp_ms - trigger_ms) > config->post_trigger_ms ||
+		    samples_head - window_start >= AD7124_CAPTURE_DEPTH) {
+			state = CAPTURE_COMPLETE;
+			return true;
+		}
+	}
+
+	samples[samples_head & (AD7124_CAPTURE_DEPTH - 1)] = *sample;
+	samples_head++;
+
+	return false;
+}
+
+/*!
+ * @brief      Number of samples in the frozen window
+ *
+ * @details
+ */
+uint32_t ad7124_capture_window_length(void)
+{
+	return state == CAPTURE_ARMED ? 0 : samples_head - window_start;
+}
+
+/*!
+ * @brief      Sample of the frozen window, oldest first
+ *
+ * @details
+ */
+const struct ad7124_capture_sample *ad7124_capture_window_sample(uint32_t index)
+{
+	return &samples[(window_start + index) & (AD7124_CAPTURE_DEPTH - 1)];
+}
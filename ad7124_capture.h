@@ -0,0 +1,66 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_capture.h
+
+  @brief: Triggered capture with a pre-trigger ring buffer
+
+  @details: Samples are kept in a RAM ring while armed. A trigger freezes
+            the pre-trigger history, the post-trigger samples are appended
+            and the complete window can then be sent out in one burst.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_CAPTURE_H_
+#define AD7124_CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ad7124_gpio_events.h"
+
+/* Samples held in RAM, pre plus post trigger window must fit, power of 2 */
+#define AD7124_CAPTURE_DEPTH		4096
+
+/* Trigger sources, can be combined */
+#define AD7124_TRIGGER_GPIO		(1 << 0)
+#define AD7124_TRIGGER_LEVEL		(1 << 1)
+#define AD7124_TRIGGER_HOST		(1 << 2)
+
+/* Edge selection for gpio and level triggers */
+#define AD7124_TRIGGER_RISING		(1 << 0)
+#define AD7124_TRIGGER_FALLING		(1 << 1)
+
+/* Sample flags */
+#define AD7124_CAPTURE_OVERRUN		(1 << 0)
+
+struct ad7124_capture_config {
+	uint16_t pre_trigger_ms;
+	uint16_t post_trigger_ms;
+	uint8_t sources;
+	uint8_t gpio_pin;
+	uint8_t gpio_edge;
+	uint8_t level_channel;
+	uint8_t level_edge;
+	int32_t level_code;
+};
+
+struct ad7124_capture_sample {
+	uint32_t timestamp_ms;
+	int32_t code;
+	uint8_t channel;
+	uint8_t levels;
+	uint8_t flags;
+};
+
+extern struct ad7124_capture_config ad7124_capture_config;
+
+void ad7124_capture_arm(void);
+bool ad7124_capture_triggered(void);
+uint32_t ad7124_capture_trigger_ms(void);
+void ad7124_capture_trigger(uint32_t timestamp_ms);
+void ad7124_capture_gpio_event(const struct ad7124_gpio_event *event);
+bool ad7124_capture_push(const struct ad7124_capture_sample *sample);
+uint32_t ad7124_capture_window_length(void);
+const struct ad7124_capture_sample *ad7124_capture_window_sample(uint32_t index);
+
+#endif /* AD7124_CAPTURE_H_ */
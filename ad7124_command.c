@@ -0,0 +1,90 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_command.c
+
+  @brief: Console input mailbox filled from the stdio rx callback
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "ad7124_command.h"
+#include "ad7124_trace.h"
+
+static uint8_t command_ring[AD7124_COMMAND_DEPTH];
+// head is only written by the callback, tail only by the consumer
+volatile uint32_t ad7124_command_head = 0;
+volatile uint32_t ad7124_command_tail = 0;
+
+/*!
+ * @brief      Moves every pending character from stdio into the ring
+ *
+ * @details    Runs in interrupt context when stdio reports new input.
+ *             Characters that do not fit are left in stdio.
+ */
+static void chars_available_callback(void *param)
+{
+	uint32_t head = ad7124_command_head;
+	int c;
+
+	(void)param;
+	ad7124_trace(AD7124_TRACE_ISR_ENTER, AD7124_TRACE_ARG_STDIO_RX);
+
+	while (head - ad7124_command_tail < AD7124_COMMAND_DEPTH &&
+	       (c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+		command_ring[head & (AD7124_COMMAND_DEPTH - 1)] = (uint8_t)c;
+		head++;
+	}
+
+	// make the characters visible before the index that publishes them
+	__dmb();
+	ad7124_command_head = head;
+
+	ad7124_trace(AD7124_TRACE_ISR_EXIT, AD7124_TRACE_ARG_STDIO_RX);
+}
+
+/*!
+ * @brief      Installs the rx callback, call once after stdio_init_all()
+ *
+ * @details
+ */
+void ad7124_command_init(void)
+{
+	stdio_set_chars_available_callback(&chars_available_callback, NULL);
+}
+
+/*!
+ * @brief      Removes the oldest character, the ring must not be empty
+ *
+ * @details    Use ad7124_command_poll() to check first.
+ */
+int ad7124_command_take(void)
+{
+	uint32_t tail = ad7124_command_tail;
+	int c;
+
+	__dmb();
+	c = command_ring[tail & (AD7124_COMMAND_DEPTH - 1)];
+	ad7124_command_tail = tail + 1;
+
+	return c;
+}
+
+/*!
+ * @brief      Blocking read for the menus, drop-in for getchar()
+ *
+ * @details
+ */
+int ad7124_command_getchar(void)
+{
+	int c;
+
+	while ((c = ad7124_command_poll()) == AD7124_COMMAND_NONE) {
+		tight_loop_contents();
+	}
+	return c;
+}
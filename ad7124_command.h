@@ -0,0 +1,43 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_command.h
+
+  @brief: Console input mailbox filled from the stdio rx callback
+
+  @details: Characters are moved out of stdio by the chars available
+            callback as they arrive and queued in a single producer / single
+            consumer ring. The acquisition loop checks the ring instead of
+            calling into stdio on every iteration, the menus block on it
+            instead of getchar(). The effect on the loop rate has not been
+            measured on the target, the loop time histogram of the
+            acquisition statistics shows it.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_COMMAND_H_
+#define AD7124_COMMAND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Mailbox size, must be a power of two */
+#define AD7124_COMMAND_DEPTH	256
+
+#define AD7124_COMMAND_NONE		(-1)
+
+extern volatile uint32_t ad7124_command_head;
+extern volatile uint32_t ad7124_command_tail;
+
+void ad7124_command_init(void);
+int ad7124_command_take(void);
+int ad7124_command_getchar(void);
+
+/* Next queued character or AD7124_COMMAND_NONE, one compare when none is queued */
+static inline int ad7124_command_poll(void)
+{
+	if (ad7124_command_head == ad7124_command_tail)
+		return AD7124_COMMAND_NONE;
+	return ad7124_command_take();
+}
+
+#endif /* AD7124_COMMAND_H_ */
@@ -0,0 +1,407 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_config_builder.hpp
+
+  @brief: Compile-time register map builder and conversion timing model
+
+  @details: Everything here is constexpr (C++17). The decoders and the
+            timing model accept the C board tables as well as maps made by
+            config_builder, so both can be checked with static_assert.
+            Invalid field values make the builder call config_error(), which
+            is not constexpr and only declared, so a bad configuration does
+            not compile.
+
+            Timing follows the AD7124-8 datasheet: master clock 614.4 kHz in
+            full power, 153.6 kHz in mid and 76.8 kHz in low power mode, a
+            channel switch costs the full settling time of the filter, a
+            single enabled channel converts at the output data rate.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_CONFIG_BUILDER_HPP_
+#define AD7124_CONFIG_BUILDER_HPP_
+
+#include <array>
+#include <cstdint>
+
+#include "ad7124.h"
+#include "ad7124_timing.h"
+
+namespace ad7124 {
+
+using register_map = std::array<ad7124_st_reg, AD7124_REG_NO>;
+
+/* Filter register FILTER field */
+constexpr uint8_t filter_sinc4 = 0;
+constexpr uint8_t filter_sinc3 = 2;
+constexpr uint8_t filter_sinc4_fast = 4;
+constexpr uint8_t filter_sinc3_fast = 5;
+constexpr uint8_t filter_post = 7;
+
+/* Filter register POST_FILTER field, only used with filter_post */
+constexpr uint8_t post_27sps = 2;
+constexpr uint8_t post_25sps = 3;
+constexpr uint8_t post_20sps = 5;
+constexpr uint8_t post_16sps = 6;
+
+/* Highest valid AINP / AINM selection (V_20mV_M) */
+constexpr uint8_t ain_max = 29;
+
+/* Not constexpr and never defined: reaching it stops constant evaluation */
+void config_error(const char *reason);
+
+constexpr uint32_t field(int32_t value, unsigned shift, unsigned bits)
+{
+	return ((uint32_t)value >> shift) & ((1u << bits) - 1);
+}
+
+constexpr uint8_t register_size(unsigned reg)
+{
+	if (reg == AD7124_Status || reg == AD7124_ID || reg == AD7124_Mclk_Count)
+		return 1;
+	if (reg == AD7124_ADC_Control || reg == AD7124_IOCon2 ||
+	    (reg >= AD7124_Channel_0 && reg < AD7124_Filter_0))
+		return 2;
+	return 3;
+}
+
+/* ADC_Control decoding */
+
+constexpr uint32_t mclk_hz(int32_t adc_control)
+{
+	switch (field(adc_control, 6, 2)) {
+	case 0:
+		return 76800;
+	case 1:
+		return 153600;
+	default:
+		return 614400;
+	}
+}
+
+constexpr uint32_t dead_cycles(int32_t adc_control)
+{
+	switch (field(adc_control, 6, 2)) {
+	case 0:
+		return 19;
+	case 1:
+		return 31;
+	default:
+		return 95;
+	}
+}
+
+/* Conversions averaged by the sinc1 stage of the fast settling filters */
+constexpr uint32_t fast_average(int32_t adc_control)
+{
+	return field(adc_control, 6, 2) == 0 ? 8 : 16;
+}
+
+/* Filter register decoding */
+
+constexpr bool filter_valid(int32_t filter)
+{
+	uint32_t type = field(filter, 21, 3);
+	uint32_t post = field(filter, 17, 3);
+	uint32_t fs = field(filter, 0, 11);
+
+	if (type == filter_post)
+		return (post == post_27sps || post == post_25sps ||
+			post == post_20sps || post == post_16sps) &&
+		       !(filter & AD7124_FILT_REG_REJ60);
+	if (type != filter_sinc4 && type != filter_sinc3 &&
+	    type != filter_sinc4_fast && type != filter_sinc3_fast)
+		return false;
+	return fs != 0;
+}
+
+/* Post filter settling in full power master clock cycles */
+constexpr uint64_t post_filter_cycles(uint32_t post)
+{
+	switch (post) {
+	case post_27sps:
+		return 22528;
+	case post_25sps:
+		return 24576;
+	case post_20sps:
+		return 30720;
+	default:
+		return 36864;
+	}
+}
+
+/* Master clock cycles from a channel switch to the first valid result */
+constexpr uint64_t settling_cycles(int32_t filter, int32_t adc_control)
+{
+	uint64_t fs = field(filter, 0, 11);
+
+	switch (field(filter, 21, 3)) {
+	case filter_sinc4:
+		return 4 * 32 * fs + dead_cycles(adc_control);
+	case filter_sinc3:
+		return 3 * 32 * fs + dead_cycles(adc_control);
+	case filter_sinc4_fast:
+		return 32 * fs * (4 + fast_average(adc_control) - 1) +
+		       dead_cycles(adc_control);
+	case filter_sinc3_fast:
+		return 32 * fs * (3 + fast_average(adc_control) - 1) +
+		       dead_cycles(adc_control);
+	default:
+		return post_filter_cycles(field(filter, 17, 3)) *
+		       mclk_hz(adc_control) / 614400;
+	}
+}
+
+/* Master clock cycles between results of a single enabled channel */
+constexpr uint64_t period_cycles(int32_t filter, int32_t adc_control)
+{
+	uint64_t fs = field(filter, 0, 11);
+
+	if (filter & AD7124_FILT_REG_SINGLE_CYCLE)
+		return settling_cycles(filter, adc_control);
+
+	switch (field(filter, 21, 3)) {
+	case filter_sinc4:
+	case filter_sinc3:
+		return 32 * fs;
+	case filter_sinc4_fast:
+		return 32 * fs * (4 + fast_average(adc_control) - 1);
+	case filter_sinc3_fast:
+		return 32 * fs * (3 + fast_average(adc_control) - 1);
+	default:
+		return settling_cycles(filter, adc_control);
+	}
+}
+
+constexpr uint32_t cycles_to_us(uint64_t cycles, uint32_t mclk)
+{
+	return (uint32_t)((cycles * 1000000 + mclk - 1) / mclk);
+}
+
+/* Register map checks, Map is a C table or a register_map */
+
+template <typename Map>
+constexpr bool channel_enabled(const Map &regs, unsigned channel)
+{
+	return regs[AD7124_Channel_0 + channel].value & AD7124_CH_MAP_REG_CH_ENABLE;
+}
+
+template <typename Map>
+constexpr int32_t channel_filter(const Map &regs, unsigned channel)
+{
+	return regs[AD7124_Filter_0 +
+		    field(regs[AD7124_Channel_0 + channel].value, 12, 3)].value;
+}
+
+template <typename Map>
+constexpr bool layout_valid(const Map &regs)
+{
+	for (unsigned i = 0; i < AD7124_REG_NO; i++) {
+		if (regs[i].addr != (int32_t)i || regs[i].size != register_size(i))
+			return false;
+	}
+	return true;
+}
+
+template <typename Map>
+constexpr unsigned enabled_channels(const Map &regs)
+{
+	unsigned count = 0;
+
+	for (unsigned ch = 0; ch < AD7124_TIMING_CHANNELS; ch++)
+		count += channel_enabled(regs, ch);
+	return count;
+}
+
+/* Every enabled channel uses a setup with a valid filter and valid inputs */
+template <typename Map>
+constexpr bool channels_valid(const Map &regs)
+{
+	for (unsigned ch = 0; ch < AD7124_TIMING_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value;
+
+		if (!channel_enabled(regs, ch))
+			continue;
+		if (!filter_valid(channel_filter(regs, ch)) ||
+		    field(value, 5, 5) > ain_max || field(value, 0, 5) > ain_max)
+			return false;
+	}
+	return true;
+}
+
+/* Read/write registers hold the same values */
+template <typename MapA, typename MapB>
+constexpr bool same_configuration(const MapA &a, const MapB &b)
+{
+	for (unsigned i = 0; i < AD7124_REG_NO; i++) {
+		if (a[i].rw == AD7124_RW && a[i].value != b[i].value)
+			return false;
+	}
+	return true;
+}
+
+template <typename Map>
+constexpr ad7124_timing timing_of(const Map &regs)
+{
+	ad7124_timing timing{};
+	int32_t adc_control = regs[AD7124_ADC_Control].value;
+	uint32_t mclk = mclk_hz(adc_control);
+	uint64_t scan = 0;
+	uint64_t longest = 0;
+	uint64_t cycles = 0;
+
+	for (unsigned ch = 0; ch < AD7124_TIMING_CHANNELS; ch++) {
+		if (!channel_enabled(regs, ch))
+			continue;
+		cycles = settling_cycles(channel_filter(regs, ch), adc_control);
+		timing.settling_us[ch] = cycles_to_us(cycles, mclk);
+		timing.channels++;
+		scan += cycles;
+		longest = cycles > longest ? cycles : longest;
+	}
+
+	// without channel switches only the first result needs to settle
+	for (unsigned ch = 0; timing.channels == 1 && ch < AD7124_TIMING_CHANNELS; ch++) {
+		if (channel_enabled(regs, ch))
+			scan = period_cycles(channel_filter(regs, ch), adc_control);
+	}
+
+	timing.scan_period_us = cycles_to_us(scan, mclk);
+	timing.channel_odr_mhz = scan ? (uint32_t)(mclk * 1000ull / scan) : 0;
+	timing.conv_timeout_polls = 2 * cycles_to_us(longest, mclk) /
+				    AD7124_TIMING_POLL_MIN_US + 16;
+	return timing;
+}
+
+/*
+ * Builds a register map field by field. Unset registers keep the values
+ * the board tables use: channels disabled, setups and filters at their
+ * power-on defaults, offsets at mid scale and gains at 0x500000.
+ */
+class config_builder {
+public:
+	constexpr config_builder() : regs{}
+	{
+		for (unsigned i = 0; i < AD7124_REG_NO; i++) {
+			regs[i].addr = i;
+			regs[i].size = register_size(i);
+			regs[i].rw = AD7124_RW;
+		}
+		regs[AD7124_Status].rw = AD7124_R;
+		regs[AD7124_Data].rw = AD7124_R;
+		regs[AD7124_ID].rw = AD7124_R;
+		regs[AD7124_ID].value = 0x02;
+		regs[AD7124_Error].rw = AD7124_R;
+		regs[AD7124_Mclk_Count].rw = AD7124_R;
+		for (unsigned i = 0; i < 16; i++)
+			regs[AD7124_Channel_0 + i].value = AD7124_CH_MAP_REG_AINM(1);
+		for (unsigned i = 0; i < 8; i++) {
+			regs[AD7124_Config_0 + i].value = 0x0860;
+			regs[AD7124_Filter_0 + i].value = 0x060180;
+			regs[AD7124_Offset_0 + i].value = 0x800000;
+			regs[AD7124_Gain_0 + i].value = 0x500000;
+		}
+	}
+
+	constexpr config_builder &adc_control(uint8_t mode, uint8_t power_mode,
+					      uint8_t clk_sel, int32_t flags = 0)
+	{
+		if (mode > 8 || power_mode > 3 || clk_sel > 3)
+			config_error("ADC_Control field out of range");
+		regs[AD7124_ADC_Control].value = flags |
+			AD7124_ADC_CTRL_REG_MODE(mode) |
+			AD7124_ADC_CTRL_REG_POWER_MODE(power_mode) |
+			AD7124_ADC_CTRL_REG_CLK_SEL(clk_sel);
+		return *this;
+	}
+
+	constexpr config_builder &error_enable(int32_t mask)
+	{
+		regs[AD7124_Error_En].value = mask;
+		return *this;
+	}
+
+	constexpr config_builder &channel(uint8_t ch, uint8_t setup,
+					  uint8_t ainp, uint8_t ainm)
+	{
+		if (ch >= 16 || setup >= 8)
+			config_error("channel or setup number out of range");
+		if (ainp > ain_max || ainm > ain_max)
+			config_error("invalid analog input");
+		regs[AD7124_Channel_0 + ch].value = AD7124_CH_MAP_REG_CH_ENABLE |
+			AD7124_CH_MAP_REG_SETUP(setup) |
+			AD7124_CH_MAP_REG_AINP(ainp) | AD7124_CH_MAP_REG_AINM(ainm);
+		return *this;
+	}
+
+	constexpr config_builder &setup(uint8_t n, bool bipolar, uint8_t ref_sel,
+					uint8_t pga, uint8_t burnout = 0,
+					int32_t buffers = 0)
+	{
+		if (n >= 8 || ref_sel > 3 || pga > 7 || burnout > 3)
+			config_error("setup field out of range");
+		regs[AD7124_Config_0 + n].value = buffers |
+			(bipolar ? AD7124_CFG_REG_BIPOLAR : 0) |
+			AD7124_CFG_REG_BURNOUT(burnout) |
+			(AD7124_CFG_REG_REF_SEL(ref_sel)) | AD7124_CFG_REG_PGA(pga);
+		return *this;
+	}
+
+	constexpr config_builder &setups(bool bipolar, uint8_t ref_sel, uint8_t pga,
+					 uint8_t burnout = 0, int32_t buffers = 0)
+	{
+		for (uint8_t n = 0; n < 8; n++)
+			setup(n, bipolar, ref_sel, pga, burnout, buffers);
+		return *this;
+	}
+
+	constexpr config_builder &filter(uint8_t n, uint8_t type, uint16_t fs,
+					 uint8_t post = 0, bool rej60 = false,
+					 bool single_cycle = false)
+	{
+		int32_t value = AD7124_FILT_REG_FILTER(type) |
+			AD7124_FILT_REG_POST_FILTER(post) | AD7124_FILT_REG_FS(fs) |
+			(rej60 ? AD7124_FILT_REG_REJ60 : 0) |
+			(single_cycle ? AD7124_FILT_REG_SINGLE_CYCLE : 0);
+
+		if (n >= 8 || fs > 2047 || (type != filter_post && post != 0) ||
+		    !filter_valid(value))
+			config_error("invalid filter combination");
+		regs[AD7124_Filter_0 + n].value = value;
+		return *this;
+	}
+
+	constexpr config_builder &filters(uint8_t type, uint16_t fs, uint8_t post = 0,
+					  bool rej60 = false, bool single_cycle = false)
+	{
+		for (uint8_t n = 0; n < 8; n++)
+			filter(n, type, fs, post, rej60, single_cycle);
+		return *this;
+	}
+
+	/* Offsets and gains, e.g. from a calibration */
+	constexpr config_builder &calibration(uint8_t n, int32_t offset, int32_t gain)
+	{
+		if (n >= 8)
+			config_error("setup number out of range");
+		regs[AD7124_Offset_0 + n].value = offset;
+		regs[AD7124_Gain_0 + n].value = gain;
+		return *this;
+	}
+
+	constexpr register_map build() const
+	{
+		if (enabled_channels(regs) == 0)
+			config_error("no channel enabled");
+		if (!channels_valid(regs))
+			config_error("enabled channel with an invalid setup");
+		return regs;
+	}
+
+private:
+	register_map regs;
+};
+
+} // namespace ad7124
+
+#endif /* AD7124_CONFIG_BUILDER_HPP_ */
@@ -11,11 +11,14 @@ Copyright (c) 2019 Analog Devices, Inc.  All rights reserved.
 
 /* includes */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
 #include "hardware/spi.h"
 #include "pico/stdlib.h"
 #include "hardware/timer.h"
+#include "hardware/adc.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -25,6 +28,30 @@ Copyright (c) 2019 Analog Devices, Inc.  All rights reserved.
 #include "ad7124_regs.h"
 #include "ad7124_support.h"
 #include "ad7124_regs_configs.h"
+#include "ad7124_stats.h"
+#include "ad7124_trace.h"
+#include "ad7124_sequencer.h"
+#include "ad7124_gpio_events.h"
+#include "ad7124_capture.h"
+#include "ad7124_command.h"
+#include "ad7124_profile_store.h"
+#include "ad7124_timing.h"
+#include "ad7124_planner.h"
+#include "ad7124_calibration_plan.h"
+#include "ad7124_drift.h"
+#include "ad7124_tare.h"
+#include "ad7124_protocol.h"
+#include "ad7124_snapshot.h"
+#include "ad7124_oneshot.h"
+#include "ad7124_recovery.h"
+#include "ad7124_boot.h"
+#include "ad7124_block.h"
+#include "ad7124_usb_out.h"
+#include "ad7124_usb_vendor.h"
+#include "ad7124_format.h"
+#include "ad7124_noise.h"
+#include "ad7124_spectrum.h"
+#include "ad7124_breath.h"
 
 #include "ad7124_console_app.h"
 #include "adi_console_menu.h"
@@ -50,6 +77,37 @@ static struct ad7124_st_reg ad7124_register_map[AD7124_REG_NO];
 // Pointer to the struct representing the AD7124 device
 static struct ad7124_dev * pAd7124_dev = NULL;
 
+// Power mode of the configuration or profile, restored when a stream starts
+static uint32_t stream_power_mode = AD7124_ADC_CTRL_REG_POWER_MODE(2);
+
+static void restore_calibration(void);
+static int32_t do_continuous_conversion(bool doVoltageConvertion, bool triggered);
+
+/*!
+ * @brief      Reads the register image back in one burst after a setup
+ *
+ * @details    The setup skips registers at their power-on value and writes
+ *             without ready checks, one read checks that all of it landed.
+ *             Offsets and gains are not compared, the device holds its
+ *             factory calibration there until restore_calibration(); they
+ *             are taken into the shadow map instead, so that a restore from
+ *             it keeps the factory gain trim.
+ */
+static int32_t verify_register_image(void)
+{
+	struct ad7124_snapshot snapshot;
+	int32_t ret;
+
+	if ((ret = ad7124_snapshot_dump(pAd7124_dev, &snapshot)) < 0)
+		return ret;
+	for (uint8_t reg = AD7124_Status; reg < AD7124_Offset_0; reg++) {
+		if (snapshot.differs[reg / 8] & (1 << (reg % 8)))
+			return COMM_ERR;
+	}
+	ad7124_snapshot_adopt_calibration(pAd7124_dev, &snapshot);
+	return 0;
+}
+
 // Public Functions
 
 /*!
@@ -71,6 +129,8 @@ int32_t ad7124_app_initialize(uint8_t configID)
 			break;
 		}	
 	}
+	stream_power_mode = ad7124_register_map[AD7124_ADC_Control].value &
+			    AD7124_ADC_CTRL_REG_POWER_MODE(0x3);
 
 	// Used to create the ad7124 device
     struct	ad7124_init_param sAd7124_init =
@@ -78,8 +138,14 @@ int32_t ad7124_app_initialize(uint8_t configID)
   		ad7124_register_map,
   		10000				// Retry count for polling
   	};
-
-  return(ad7124_setup(&pAd7124_dev, sAd7124_init));
+	int32_t ret;
+
+	if ((ret = ad7124_setup(&pAd7124_dev, sAd7124_init)) < 0)
+		return ret;
+	ad7124_boot_mark(AD7124_BOOT_ADC_SETUP);
+	ret = verify_register_image();
+	ad7124_boot_mark(AD7124_BOOT_VERIFY);
+	return ret;
 }
 
 static void spiInit() {
@@ -107,11 +173,33 @@ void initgpios () {
 
 
 int main() {
+	int32_t error_code;
+
+	ad7124_boot_mark(AD7124_BOOT_MAIN);
+	ad7124_usb_vendor_init();
 	stdio_init_all();    	
+	ad7124_command_init();
+	adi_console_set_input(ad7124_command_getchar);
+	ad7124_boot_mark(AD7124_BOOT_STDIO);
 	spiInit();	
 	initgpios();
+	ad7124_boot_mark(AD7124_BOOT_IO);
 	
-	ad7124_app_initialize(AD7124_CONFIG_A);	
+	// without a device, or with one that lost writes, there is nothing to restore into
+	if ((error_code = ad7124_app_initialize(AD7124_CONFIG_A)) < 0)
+		printf("Error (%ld) initializing the AD7124\r\n", error_code);
+	else
+		restore_calibration();
+	ad7124_boot_mark(AD7124_BOOT_CALIBRATION);
+#ifdef breathEvents
+	// the respiratory boards send breaths, not samples, unless told otherwise
+	ad7124_breath.mode = AD7124_BREATH_EVENTS;
+#endif
+#if AD7124_AUTOSTART
+	// straight into the stream, ESC drops to the menu
+	if (error_code >= 0)
+		do_continuous_conversion(AD7124_AUTOSTART == AD7124_AUTOSTART_VOLTS, false);
+#endif
 	adi_do_console_menu(&ad7124_main_menu);		
 }
 
@@ -138,51 +226,356 @@ static int32_t set_idle_mode() {
 	pAd7124_dev->regs[AD7124_ADC_Control].value |= AD7124_ADC_CTRL_REG_MODE(4); //idle mode
 	if ( (error_code = ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[AD7124_ADC_Control]) ) < 0) {
 		printf("Error (%ld) setting AD7124 power mode to low.\r\n", error_code);
-		adi_press_any_key_to_continue();
 		return error_code;
+	}
+	printf("idle mode activated\n");
+	return 0;
+}
+
+
+// Timestamp origin of the stream, moved by pressing '0'
+static uint32_t toZeroValue = 0;
+
+// Marker printed in the column of a conversion that was overwritten
+#define OVERRUN_MARKER "ovr"
+
+/*!
+ * @brief      Prints the captured input edges up to a point in time
+ *
+ * @details    Each edge is a row of its own, tagged 'E', with a microsecond
+ *             timestamp, the input levels after the edge and the pin.
+ */
+static void print_gpio_events(uint64_t until_us)
+{
+	struct ad7124_gpio_event event;
+	int64_t relative_us;
+
+	while (ad7124_gpio_events_pop_until(until_us, &event)) {
+		relative_us = (int64_t)event.timestamp_us - (int64_t)toZeroValue * 1000;
+		if (relative_us < 0)
+			relative_us = 0;
+		ad7124_usb_out_printf("\nE, %09lu.%03u, %u, %u", (uint32_t)(relative_us / 1000),
+		       (uint16_t)(relative_us % 1000), event.levels, event.pin);
+	}
+}
+
+/*!
+ * @brief      Takes the input edges up to a point in time off the ring
+ *
+ * @details    Once per row in every output mode but the triggered capture:
+ *             text rows get 'E' rows, the bulk stream edge records, the
+ *             summary modes have no place for them and skip them.
+ */
+static void take_gpio_events(uint64_t until_us)
+{
+	struct ad7124_gpio_event event;
+
+	if (ad7124_usb_vendor_streaming()) {
+		while (ad7124_gpio_events_pop_until(until_us, &event))
+			ad7124_usb_vendor_put((uint32_t)event.timestamp_us, event.pin,
+					      event.levels, AD7124_USB_RECORD_EDGE);
+	} else if (!ad7124_noise_active() && !ad7124_spectrum_active() &&
+		   ad7124_breath.mode != AD7124_BREATH_EVENTS) {
+		print_gpio_events(until_us);
 	} else {
-		printf("idle mode activated\n");
+		ad7124_gpio_events_skip_until(until_us);
+	}
+}
+
+/*!
+ * @brief      Starts a row of the stream with the timestamp and GPIO inputs
+ *
+ * @details
+ */
+static void print_row_start(uint32_t time_ms, uint8_t levels)
+{
+	char line[2 + 2 * AD7124_FORMAT_FIELD_LEN + 4];
+	char *end = line;
+
+	*end++ = '\n';
+	end = ad7124_format_int(end, time_ms - toZeroValue, 9);
+	*end++ = ',';
+	*end++ = ' ';
+	end = ad7124_format_int(end, levels, 0);
+	*end++ = ',';
+	*end++ = ' ';
+	ad7124_usb_out_write(line, end - line);
+}
+
+/*!
+ * @brief      Prints a sample value, or the marker for a lost conversion
+ *
+ * @details
+ */
+static void print_sample_value(uint8_t channel, int32_t code, uint8_t flags,
+			       bool doVoltageConvertion)
+{
+	char field[AD7124_FORMAT_FIELD_LEN];
+	char *end;
+
+	if (flags & AD7124_CAPTURE_OVERRUN) {
+		ad7124_usb_out_write(OVERRUN_MARKER, sizeof(OVERRUN_MARKER) - 1);
+	} else if(doVoltageConvertion) {
+		end = ad7124_format_volts(field, code,
+					  ad7124_get_channel_bipolar(pAd7124_dev, channel),
+					  ad7124_get_channel_pga(pAd7124_dev, channel));
+		if (end)
+			ad7124_usb_out_write(field, end - field);
+		else
+			ad7124_usb_out_printf("%.8f", ad7124_convert_sample_to_voltage(pAd7124_dev, channel, code) );
+	} else {
+		end = ad7124_format_int(field, code, 0);
+		ad7124_usb_out_write(field, end - field);
+	}
+}
+
+/*!
+ * @brief      Returns the mask of channels enabled in the live register map
+ *
+ * @details
+ */
+static uint16_t enabled_channel_mask(void)
+{
+	uint16_t mask = 0;
+
+	for (uint8_t i = 0; i < AD7124_CHANNEL_COUNT; i++) {
+		if (pAd7124_dev->regs[AD7124_Channel_0 + i].value & AD7124_CH_MAP_REG_CH_ENABLE)
+			mask |= 1 << i;
+	}
+	return mask;
+}
+
+/*!
+ * @brief      Points the breath detection at the first enabled channel
+ *
+ * @details    The filters are designed for the rate of the live map.
+ */
+static void breath_start(const struct ad7124_timing *timing)
+{
+	uint16_t mask = enabled_channel_mask();
+	int32_t config;
+	uint8_t ch = 0;
+
+	while (ch < AD7124_CHANNEL_COUNT - 1 && !(mask & (1 << ch)))
+		ch++;
+	config = pAd7124_dev->regs[AD7124_Config_0 +
+			((pAd7124_dev->regs[AD7124_Channel_0 + ch].value >> 12) & 0x7)].value;
+	ad7124_breath.channel = ch;
+	ad7124_breath_init(&ad7124_breath, timing->channel_odr_mhz,
+			   (config & AD7124_CFG_REG_BIPOLAR) ? 0x800000 : 0);
+}
+
+/*!
+ * @brief      Prints the breath events a sample completed
+ *
+ * @details    A "B" line per breath with its amplitude in codes and the
+ *             interval to the breath before in ms, a "BR" line per rate
+ *             update with the rate in breaths per minute, the mean amplitude
+ *             and 1 during an apnea.
+ */
+static void print_breath_events(uint8_t events)
+{
+	const struct ad7124_breath *breath = &ad7124_breath;
+
+	if (events & AD7124_BREATH_EVENT_BREATH)
+		ad7124_usb_out_printf("\nB, %09lu, %ld, %lu", breath->breath_ms - toZeroValue,
+				      breath->amplitude, breath->interval_ms);
+	if (events & AD7124_BREATH_EVENT_RATE)
+		ad7124_usb_out_printf("\nBR, %09lu, %u.%u, %ld, %u", breath->rate_ms - toZeroValue,
+				      breath->rate_x10 / 10, breath->rate_x10 % 10,
+				      breath->mean_amplitude, breath->apnea);
+}
+
+/*!
+ * @brief      Sends the frozen capture window out in one burst
+ *
+ * @details    A 'T' row with the trigger time comes first, the window then
+ *             follows in the normal row format, starting at a full scan.
+ */
+static void burst_capture_window(uint8_t first_channel, bool doVoltageConvertion)
+{
+	uint32_t length = ad7124_capture_window_length();
+	const struct ad7124_capture_sample *sample;
+	bool in_row = false;
+
+	ad7124_usb_out_printf("\nT, %09d", ad7124_capture_trigger_ms() - toZeroValue);
+	for (uint32_t i = 0; i < length; i++) {
+		sample = ad7124_capture_window_sample(i);
+		if (sample->channel == first_channel) {
+			print_row_start(sample->timestamp_ms, sample->levels);
+			in_row = true;
+		} else if (in_row) {
+			ad7124_usb_out_write(", ", 2);
+		} else {
+			continue;
+		}
+		print_sample_value(sample->channel, sample->code, sample->flags,
+				   doVoltageConvertion);
+	}
+	ad7124_usb_out_write("\nT, end\n", 8);
+}
+
+/*!
+ * @brief      Disables the drift probe channel if a probe is in flight
+ *
+ * @details    The register map never has the spare channel enabled, writing
+ *             its map value switches the probe off.
+ */
+static void drift_probe_off(void)
+{
+	if (ad7124_drift.active_setup == AD7124_DRIFT_NONE)
+		return;
+	ad7124_drift.active_setup = AD7124_DRIFT_NONE;
+	ad7124_write_register(pAd7124_dev,
+			      pAd7124_dev->regs[AD7124_Channel_0 + ad7124_drift.probe_channel]);
+}
+
+/*!
+ * @brief      Writes the channel register of the drift probe in a stream
+ *
+ * @details    The write restarts the sequence at the first channel
+ *             (tools/ad7124_drift_sim.c). A conversion that finished but was
+ *             not read yet is lost with it and the restart converts its
+ *             channel again, so it leaves no gap in the rows: STATUS tells
+ *             the channel and the conversions up to it are counted in
+ *             missed[] only.
+ */
+static int32_t drift_probe_write(struct ad7124_stats_core *stats,
+				 struct ad7124_sequencer *sequencer, struct ad7124_st_reg reg)
+{
+	struct ad7124_st_reg status = pAd7124_dev->regs[AD7124_Status];
+	uint8_t channel;
+	int32_t error_code;
+
+	if ((error_code = ad7124_read_register(pAd7124_dev, &status)) < 0)
+		return error_code;
+	channel = status.value & 0x0F;
+	if (!(status.value & AD7124_STATUS_REG_RDY) && sequencer->expected >= 0 &&
+	    (sequencer->enabled_mask & (1 << channel))) {
+		for (uint8_t i = sequencer->expected; ; i = sequencer->following[i]) {
+			stats->missed[i]++;
+			if (i == channel)
+				break;
+		}
 	}
+	if ((error_code = ad7124_write_register(pAd7124_dev, reg)) < 0)
+		return error_code;
+	ad7124_sequencer_restart(sequencer);
+	return 0;
 }
 
+/*!
+ * @brief      Brings the device back after a failed read, the stream resumes
+ *
+ * @details    An 'R' row with the tier, the recovery time in us and the
+ *             estimated number of lost conversions goes out. Returns false
+ *             when the device could not be recovered.
+ */
+static bool recover_stream(struct ad7124_stats_core *stats, int32_t faults,
+			   struct ad7124_sequencer *sequencer,
+			   const struct ad7124_timing *timing, uint32_t last_sample_us)
+{
+	uint32_t start = time_us_32();
+	uint32_t lost;
+	int32_t tier;
+
+	ad7124_trace(AD7124_TRACE_RECOVERY, 0);
+	if ((tier = ad7124_recover(pAd7124_dev, faults)) < 0)
+		return false;
+	if (tier == AD7124_RECOVERY_RESYNC) {
+		stats->resyncs++;
+	} else {
+		stats->resets++;
+		// the probe channel is off again, as in the shadow map
+		ad7124_drift.active_setup = AD7124_DRIFT_NONE;
+	}
+
+	// nothing converted from the last sample until the restarted sequence
+	lost = timing->scan_period_us ? (uint32_t)((uint64_t)(time_us_32() - last_sample_us) *
+						   timing->channels / timing->scan_period_us) : 0;
+	stats->recovery_lost += lost;
+	ad7124_sequencer_init(sequencer, sequencer->enabled_mask);
+	ad7124_usb_out_printf("\nR, %ld, %lu, %lu", tier, time_us_32() - start, lost);
+	return true;
+}
 
 /*!
  * @brief      Continuously acquires samples in Continuous Conversion mode
  *
  * @details   The ADC is run in continuous mode, and all samples are acquired
  *            and assigned to the channel they come from. Escape key an be used
- *            to exit the loop
+ *            to exit the loop, 'z' tares the channels (ad7124_tare.h).
+ *            Failed reads and device faults are recovered (ad7124_recovery.h)
+ *            and the stream goes on after an 'R' row.
+ *            With triggered set, samples go to the capture ring instead and
+ *            only the window around each trigger is sent, 't' triggers from
+ *            the host.
  */
-static int32_t do_continuous_conversion(bool doVoltageConvertion)
+static int32_t do_continuous_conversion(bool doVoltageConvertion, bool triggered)
 {
-	static uint32_t toZeroValue = 0;
-
 	int32_t error_code;
 	int32_t sample_data;
-	uint32_t portvalues;
+	struct ad7124_sequencer sequencer;
+	struct ad7124_sequencer_gap gap;
+	struct ad7124_capture_sample sample;
+	struct ad7124_gpio_event event;
+	struct ad7124_timing timing;
+	bool drift_probe;
+	int8_t drift_setup;
+	int32_t faults;
+	uint32_t last_sample_us;
+	uint64_t sample_us;
 	
 	//select continuous convertion mode, all zero
 	pAd7124_dev->regs[AD7124_ADC_Control].value &= ~(AD7124_ADC_CTRL_REG_MODE(0xf));
 
 	
-	//select full power
+	//select the configured power mode, calibration leaves mid power behind
 	pAd7124_dev->regs[AD7124_ADC_Control].value &= ~(AD7124_ADC_CTRL_REG_POWER_MODE(0x3));
-	pAd7124_dev->regs[AD7124_ADC_Control].value |= AD7124_ADC_CTRL_REG_POWER_MODE(0x2);
+	pAd7124_dev->regs[AD7124_ADC_Control].value |= stream_power_mode;
 
 	if ((error_code = ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[AD7124_ADC_Control]) < 0)) {
 		printf("Error (%ld) setting AD7124 Continuous conversion mode.\r\n", error_code);		
 		return(MENU_CONTINUE);
 	}
+	// the live map may come from a profile, so derive the timeout from it
+	ad7124_timing_from_map(pAd7124_dev->regs, &timing);
+	if (ad7124_breath.mode != AD7124_BREATH_OFF)
+		breath_start(&timing);
 
 	uint8_t channel_read = 0;							
 	// Continuously read the channels, and store sample values
 	int pressedchar = 0;
 	bool set_next_to_zero = false;
+	struct ad7124_stats_core *stats = ad7124_stats_this_core();
+	ad7124_sequencer_init(&sequencer, enabled_channel_mask());
+	ad7124_drift_start(pAd7124_dev->regs);
+	ad7124_capture_arm();
+	ad7124_block_start(sequencer.enabled_mask);
+	uint32_t loop_start = time_us_32();
+	ad7124_stats_start();
+	ad7124_usb_out_reset_stats();
+	ad7124_gpio_events_start();
+	ad7124_trace(AD7124_TRACE_STREAM_START, 0);
+	last_sample_us = time_us_32();
     while (pressedchar !=27) {  		  			    	
-		pressedchar = getchar_timeout_us(0);
+		uint32_t loop_now = time_us_32();
+		ad7124_stats_loop_time(stats, loop_now - loop_start);
+		loop_start = loop_now;
+
+		ad7124_usb_out_poll();
+		ad7124_usb_vendor_poll();
+		pressedchar = ad7124_command_poll();
 		if(pressedchar == 48) {
 			set_next_to_zero = true;
 		}
+		if (pressedchar == 'z') {
+			ad7124_tare_begin(pAd7124_dev->regs, ad7124_tare.samples);
+		}
+		if (triggered && pressedchar == 't' &&
+		    (ad7124_capture_config.sources & AD7124_TRIGGER_HOST)) {
+			ad7124_capture_trigger(to_ms_since_boot(get_absolute_time()));
+		}
 
 		/*
 		*  this polls the status register READY/ bit to determine when conversion is done
@@ -192,46 +585,163 @@ static int32_t do_continuous_conversion(bool doVoltageConvertion)
 		*  enabling the DATA_STATUS bit means that status is appended to ADC data read
 		*  so the channel being sampled is read back (and updated) as part of the same frame
 		*/
-		if ( (error_code = ad7124_wait_for_conv_ready(pAd7124_dev, 10000)) < 0) {
+		if ( (error_code = ad7124_wait_for_conv_ready(pAd7124_dev, timing.conv_timeout_polls)) < 0) {
+				ad7124_stats_count_error(stats, error_code);
+				if (recover_stream(stats, 0, &sequencer, &timing, last_sample_us))
+					continue;
+				ad7124_stats_stop();
+				ad7124_gpio_events_stop();
+				ad7124_block_flush();
+				ad7124_usb_out_flush();
+				ad7124_usb_vendor_flush();
+				drift_probe_off();
 				printf("Error/Timeout waiting for conversion ready %ld\r\n", error_code);
 				return -1;
 			}
 		channel_read = pAd7124_dev->regs[AD7124_Status].value & 0x0000000F;
-		if(pAd7124_dev->regs[AD7124_Channel_0 + channel_read].value & AD7124_CH_MAP_REG_CH_ENABLE) {
+		ad7124_trace(AD7124_TRACE_CONV_READY, channel_read);
+		faults = 0;
+		if (pAd7124_dev->regs[AD7124_Status].value & AD7124_STATUS_REG_POR_FLAG) {
+			// brown-out, the device converts with its defaults now
+			faults = AD7124_RECOVERY_POWER_ON;
+		} else if (pAd7124_dev->regs[AD7124_Status].value & AD7124_STATUS_REG_ERROR_FLAG) {
+			stats->adc_errors++;
+			// out of range inputs flag errors too, only faults need a recovery
+			if ((faults = ad7124_recovery_faults(pAd7124_dev)) < 0)
+				faults = 0;
+		}
+		if (faults != 0) {
+			if (recover_stream(stats, faults, &sequencer, &timing, last_sample_us))
+				continue;
+			ad7124_stats_stop();
+			ad7124_gpio_events_stop();
+			ad7124_block_flush();
+			ad7124_usb_out_flush();
+			ad7124_usb_vendor_flush();
+			drift_probe_off();
+			printf("Error, device could not be recovered\r\n");
+			return -1;
+		}
+		drift_probe = channel_read == ad7124_drift.probe_channel &&
+			      ad7124_drift.active_setup != AD7124_DRIFT_NONE;
+		if(drift_probe || (pAd7124_dev->regs[AD7124_Channel_0 + channel_read].value & AD7124_CH_MAP_REG_CH_ENABLE)) {
 
 			if ( (error_code = ad7124_read_data(pAd7124_dev, &sample_data)) < 0) {
+				ad7124_stats_count_error(stats, error_code);
+				if (recover_stream(stats, 0, &sequencer, &timing, last_sample_us))
+					continue;
+				ad7124_stats_stop();
+				ad7124_gpio_events_stop();
+				ad7124_block_flush();
+				ad7124_usb_out_flush();
+				ad7124_usb_vendor_flush();
+				drift_probe_off();
 				printf("Error reading ADC Data (%ld).\r\n", error_code);
 				return -1;
 			}
-			
-			if (channel_read == 0) {	
-				
-				if(set_next_to_zero) {
-					set_next_to_zero = false;
-					toZeroValue = to_ms_since_boot(get_absolute_time());
-					printf("\n%09d, ", 0);
-				} else {
-					printf("\n%09d, ", to_ms_since_boot(get_absolute_time()) - toZeroValue);
-				}			
-				
-				portvalues = gpio_get_all();
-        		
-				printf("%i, ", portvalues & 0XFF);
-				
-				
-			} else {				
-				printf(", ");												
+			if (drift_probe) {
+				// shorted-input conversion, not part of the stream
+				ad7124_drift_probe_result(sample_data);
+				if ((error_code = drift_probe_write(stats, &sequencer,
+						pAd7124_dev->regs[AD7124_Channel_0 + channel_read])) < 0)
+					ad7124_stats_count_error(stats, error_code);
+				continue;
+			}
+			last_sample_us = time_us_32();
+			ad7124_boot_mark(AD7124_BOOT_FIRST_SAMPLE);
+			sample_data = ad7124_drift_correct(channel_read, sample_data);
+			sample_data = ad7124_tare_apply(channel_read, sample_data);
+			stats->samples[channel_read]++;
+			ad7124_trace(AD7124_TRACE_SAMPLE_READ, channel_read);
+
+			/*
+			 * A channel index ahead of the predicted one means the ADC
+			 * overwrote conversions before they were read, keep the
+			 * columns aligned by marking each lost one
+			 */
+			gap = ad7124_sequencer_next(&sequencer, channel_read);
+
+			// edges up to this instant go in front of the row, later ones after it
+			sample_us = time_us_64();
+			sample.timestamp_ms = sample_us / 1000;
+			sample.levels = gpio_get_all() & 0xFF;
+
+			for (uint8_t i = gap.skipped ? gap.first : channel_read; ; i = sequencer.following[i]) {
+				sample.channel = i;
+				sample.code = sample_data;
+				sample.flags = (i != channel_read) ? AD7124_CAPTURE_OVERRUN : 0;
+				if (sample.flags)
+					stats->missed[i]++;
+
+				if (i == sequencer.first) {
+					ad7124_block_row(time_us_32());
+					// edges seen since the last row go in front of the new one
+					if (!triggered)
+						take_gpio_events(sample_us);
+				}
+				ad7124_block_put(i, sample.code, !sample.flags);
+
+				if (triggered) {
+					if (i == sequencer.first) {
+						while (ad7124_gpio_events_pop_until(sample_us, &event))
+							ad7124_capture_gpio_event(&event);
+					}
+					if (ad7124_capture_push(&sample)) {
+						burst_capture_window(sequencer.first, doVoltageConvertion);
+						ad7124_capture_arm();
+						// conversions were overwritten during the burst
+						ad7124_sequencer_init(&sequencer, sequencer.enabled_mask);
+						break;
+					}
+				} else if (ad7124_usb_vendor_streaming()) {
+					// the host reader takes binary frames, no text rows
+					ad7124_usb_vendor_put(time_us_32(), i, sample.code,
+							      sample.flags ? AD7124_USB_RECORD_LOST : 0);
+				} else if (!ad7124_noise_active() && !ad7124_spectrum_active() &&
+					   ad7124_breath.mode != AD7124_BREATH_EVENTS) {
+					if (i == sequencer.first) {
+						if (set_next_to_zero) {
+							set_next_to_zero = false;
+							toZeroValue = sample.timestamp_ms;
+						}
+						print_row_start(sample.timestamp_ms, sample.levels);
+					} else {
+						ad7124_usb_out_write(", ", 2);
+					}
+					print_sample_value(i, sample.code, sample.flags, doVoltageConvertion);
+				}
+
+				if (i == channel_read)
+					break;
 			}
-			
-			if(doVoltageConvertion) {
-				printf("%.8f", ad7124_convert_sample_to_voltage(pAd7124_dev, channel_read, sample_data) );				
-			} else { 
-				printf("%i", sample_data); 
+			if (ad7124_noise_active())
+				ad7124_noise_poll(sample.timestamp_ms);
+			if (ad7124_spectrum_active())
+				ad7124_spectrum_poll();
+			if (ad7124_breath.mode != AD7124_BREATH_OFF && channel_read == ad7124_breath.channel)
+				print_breath_events(ad7124_breath_sample(&ad7124_breath,
+									 sample.timestamp_ms, sample_data));
+
+			// the spare channel joins the sequence after the last channel
+			if (sequencer.following[channel_read] == sequencer.first &&
+			    (drift_setup = ad7124_drift_scan_done()) != AD7124_DRIFT_NONE) {
+				if ((error_code = drift_probe_write(stats, &sequencer,
+						ad7124_drift_probe_register(pAd7124_dev->regs, drift_setup))) < 0)
+					ad7124_stats_count_error(stats, error_code);
 			}
 		}		
 	}		
 
-    
+	ad7124_stats_stop();
+	ad7124_gpio_events_stop();
+	// edges after the last row, ahead of the closing summaries
+	if (!triggered)
+		take_gpio_events(time_us_64());
+	ad7124_block_flush();
+	drift_probe_off();
+	ad7124_usb_out_flush();
+	ad7124_usb_vendor_flush();
+	ad7124_trace(AD7124_TRACE_STREAM_STOP, 0);
 
 	error_code = set_idle_mode();
 	if (error_code < 0) printf("error occured continuous conversion");
@@ -247,24 +757,23 @@ static int32_t set_zero_scale_calibration() {
 	pAd7124_dev->regs[AD7124_ADC_Control].value |= AD7124_ADC_CTRL_REG_MODE(0b0111) | AD7124_ADC_CTRL_REG_POWER_MODE(0x01);
 	if ( (error_code = ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[AD7124_ADC_Control]) ) < 0) {
 		printf("Error (%ld) setting AD7124 ADC into zero scale calibration.\r\n", error_code);
-		adi_press_any_key_to_continue();
 		return error_code;
-	} else {
-		printf("zero scale calibration completed\n");
 	}
+	printf("zero scale calibration started\n");
+	return 0;
 }
 
 static int32_t set_full_scale_calibration() {
-	// 6 = system full scale calibration
+	// 6 = internal full scale calibration, not supported in full power
 	int32_t error_code = 0;
 	pAd7124_dev->regs[AD7124_ADC_Control].value &= ~(AD7124_ADC_CTRL_REG_MODE(0xf) | AD7124_ADC_CTRL_REG_POWER_MODE(0x3) );
-	pAd7124_dev->regs[AD7124_ADC_Control].value |= AD7124_ADC_CTRL_REG_MODE(0b1000) | AD7124_ADC_CTRL_REG_POWER_MODE(0x01);
+	pAd7124_dev->regs[AD7124_ADC_Control].value |= AD7124_ADC_CTRL_REG_MODE(0b0110) | AD7124_ADC_CTRL_REG_POWER_MODE(0x01);
 	if ( (error_code = ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[AD7124_ADC_Control]) ) < 0) {
 		printf("Error (%ld) setting AD7124 ADC into internal full scale calibration.\r\n", error_code);		
 		return error_code;
-	} else {
-		printf("full scale calibration completed\n");
 	}
+	printf("full scale calibration started\n");
+	return 0;
 }
 
 static int32_t read_error() {
@@ -280,12 +789,15 @@ static int32_t read_error() {
 
 
 
-static int32_t set_slow_filters(bool enable) {
+static int32_t set_slow_filters(bool enable, uint8_t setups) {
 	//set high filter for calibration
 	int32_t error_code = 0;
 	enum ad7124_registers reg_nr;	
 	
 	for(reg_nr = AD7124_Filter_0; (reg_nr < AD7124_Offset_0) && !(error_code < 0); reg_nr++) {
+		if (!(setups & (1 << (reg_nr - AD7124_Filter_0)))) {
+			continue;
+		}
 		if(enable) {									
 			struct ad7124_st_reg reg;
 			reg=pAd7124_dev->regs[reg_nr];
@@ -302,9 +814,10 @@ static int32_t set_slow_filters(bool enable) {
 		}						
 		if (error_code < 0) break;		
 	}			
+	return error_code;
 }
 
-static uint32_t switch_channel(bool enable, enum ad7124_registers channel) {
+static int32_t switch_channel(bool enable, enum ad7124_registers channel) {
 	
 	if(enable) {
 	 	pAd7124_dev->regs[channel].value |= AD7124_CH_MAP_REG_CH_ENABLE;
@@ -314,79 +827,218 @@ static uint32_t switch_channel(bool enable, enum ad7124_registers channel) {
 	
 	int32_t error_code = 0;
 	error_code |= ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[channel]);										
-	printf("%s channel %i\n", enable ? "enabled" : "disabled", channel);			
 	
 	return error_code;
 }
 
-static int32_t do_fullscale_calibration() {	
+/*
+ * Calibrations run once per setup (ad7124_calibration_plan.h), back to back
+ * on the same channel: internal full-scale first, then system zero-scale.
+ * The full-scale one is opt-in, it doubles the time of a run; see
+ * tools/ad7124_calibration_time.c
+ */
+#define CALIBRATION_ZERO	AD7124_CAL_SYSTEM_ZERO_SCALE
+#define CALIBRATION_GAIN	(AD7124_CAL_INTERNAL_FULL_SCALE | AD7124_CAL_SYSTEM_ZERO_SCALE)
+
+/* Keeps the first error of a sequence that has to run to its end */
+static int32_t first_error(int32_t error_code, int32_t ret)
+{
+	return error_code < 0 ? error_code : ret;
+}
+
+static int32_t do_fullscale_calibration(uint8_t modes) {	
 	int32_t error_code = 0;	
-	int32_t enabled_channels = 0;
+	struct ad7124_calibration_step steps[AD7124_CAL_STEPS];
+	uint16_t enabled_channels = enabled_channel_mask();
+	uint8_t setups = 0;
+	uint8_t step_count;
+	uint64_t start = time_us_64();
+
+	step_count = ad7124_calibration_plan(pAd7124_dev->regs, modes, steps);
 
-	for (enum ad7124_registers i = AD7124_Offset_0; i < AD7124_Gain_0; i++)
+	for (uint8_t s = 0; s < step_count; s++)
 	{
-		//write zero in offset register of each configuration 
-		pAd7124_dev->regs[i].value = 0x800000;
-		if ( (error_code = ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[i]) ) < 0) {
-			printf("Error (%ld) writing offset for setup 0.\r\n", error_code);
+		//write zero in offset register of each calibrated setup
+		setups |= 1 << steps[s].setup;
+		pAd7124_dev->regs[AD7124_Offset_0 + steps[s].setup].value = 0x800000;
+		if ( (error_code = ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[AD7124_Offset_0 + steps[s].setup]) ) < 0) {
+			printf("Error (%ld) writing offset for setup %u.\r\n", error_code, steps[s].setup);
 			return error_code;			
 		}
 	}
 
 	for (uint8_t i = 0; i < AD7124_CHANNEL_COUNT; i++) {		
-		if (pAd7124_dev->regs[AD7124_Channel_0 + i].value & AD7124_CH_MAP_REG_CH_ENABLE) {
-			enabled_channels += (1 << i);	
-			error_code |= switch_channel(false, AD7124_Channel_0 + i);
+		if (enabled_channels & (1 << i)) {
+			error_code = first_error(error_code, switch_channel(false, AD7124_Channel_0 + i));
 		}	
 	}	
 	
-	error_code |= set_slow_filters(true);
-
-	//loop channels for calibration
-	for (uint8_t i = 0; i < AD7124_CHANNEL_COUNT; i++) { 
-		if(enabled_channels & (1<<i)) {
-			//enable for calibration
-			switch_channel(true, AD7124_Channel_0 +i);
-						
-			//full scale must be done before zero scale calibration
-			// set_full_scale_calibration();
-			// ad7124_wait_for_conv_ready(pAd7124_dev, 10000);
-			
-			set_zero_scale_calibration();											
-			ad7124_wait_for_conv_ready(pAd7124_dev, 10000);
-						
-			switch_channel(false, AD7124_Channel_0 +i);
+	error_code = first_error(error_code, set_slow_filters(true, setups));
+
+	//loop setups for calibration
+	for (uint8_t s = 0; s < step_count; s++) { 
+		//enable for calibration
+		error_code = first_error(error_code, switch_channel(true, AD7124_Channel_0 + steps[s].channel));
+
+		//full scale must be done before zero scale calibration, a calibration
+		//that does not finish leaves its register unknown
+		if (steps[s].modes & AD7124_CAL_INTERNAL_FULL_SCALE) {
+			error_code = first_error(error_code, set_full_scale_calibration());
+			error_code = first_error(error_code, ad7124_wait_for_conv_ready(pAd7124_dev, 10000));
 		}
+		if (steps[s].modes & AD7124_CAL_SYSTEM_ZERO_SCALE) {
+			error_code = first_error(error_code, set_zero_scale_calibration());
+			error_code = first_error(error_code, ad7124_wait_for_conv_ready(pAd7124_dev, 10000));
+		}
+
+		error_code = first_error(error_code, switch_channel(false, AD7124_Channel_0 + steps[s].channel));
 	}
 
-	error_code |= set_slow_filters(false);
+	error_code = first_error(error_code, set_slow_filters(false, setups));
 
 	for (uint8_t i = 0; i < AD7124_CHANNEL_COUNT; i++) {  
 		if(enabled_channels & (1<<i)) {
-			error_code |= switch_channel(true, AD7124_Channel_0 + i);
+			error_code = first_error(error_code, switch_channel(true, AD7124_Channel_0 + i));
 		}
 	}
 	
-	error_code = set_idle_mode();
-	if(error_code < 0) {
-		adi_press_any_key_to_continue();
-		printf("error fullscale calibraion");
+	error_code = first_error(error_code, set_idle_mode());
+	if (error_code < 0) {
+		printf("Error (%ld) in the calibration\r\n", error_code);
+		return error_code;
+	}
+	printf("%u setups calibrated in %lu ms\r\n", step_count,
+	       (uint32_t)((time_us_64() - start) / 1000));
+	return 0;
+}
+
+
+/*!
+ * @brief      Reads the RP2040 die temperature in 0.1 degC
+ *
+ * @details    Close enough to the board temperature to tell calibrations
+ *             taken cold and warm apart.
+ */
+static int16_t read_board_temperature(void)
+{
+	float volts;
+
+	adc_init();
+	adc_set_temp_sensor_enabled(true);
+	adc_select_input(4);
+	volts = adc_read() * 3.3f / (1 << 12);
+	return (int16_t)((27.0f - (volts - 0.706f) / 0.001721f) * 10);
+}
+
+/*!
+ * @brief      Reads the calibrated offsets and gains back and stores them
+ *
+ * @details    The record is keyed by the live configuration and restored
+ *             by restore_calibration() at boot or profile switch.
+ */
+static int32_t store_calibration(void)
+{
+	int32_t error_code;
+	int16_t temperature = read_board_temperature();
+
+	for (enum ad7124_registers i = AD7124_Offset_0; i <= AD7124_Gain_7; i++) {
+		if ((error_code = ad7124_read_register(pAd7124_dev, &pAd7124_dev->regs[i])) < 0) {
+			printf("Error (%ld) reading calibration registers\r\n", error_code);
+			return error_code;
+		}
+	}
+	if ((error_code = ad7124_calibration_save(pAd7124_dev->regs, temperature)) < 0) {
+		printf("Error storing calibration\r\n");
+		return error_code;
+	}
+	printf("calibration stored at %d.%d degC\r\n", temperature / 10,
+	       abs(temperature % 10));
+	return 0;
+}
+
+/*!
+ * @brief      Restores the stored calibration of the live configuration
+ *
+ * @details
+ */
+static void restore_calibration(void)
+{
+	const struct ad7124_calibration *calibration;
+	uint64_t start = time_us_64();
+	int32_t written;
+
+	calibration = ad7124_calibration_find(ad7124_calibration_key(pAd7124_dev->regs));
+	if (calibration == NULL) {
+		printf("no stored calibration for this configuration\r\n");
+		return;
+	}
+	written = ad7124_calibration_restore(pAd7124_dev, calibration);
+	if (written < 0) {
+		printf("Error (%ld) restoring calibration\r\n", written);
+	} else {
+		printf("calibration #%lu (%d.%d degC) restored, %ld registers in %lu us\r\n",
+		       calibration->sequence, calibration->temperature_dc / 10,
+		       abs(calibration->temperature_dc % 10), written,
+		       (uint32_t)(time_us_64() - start));
 	}
 }
 
+/*!
+ * @brief      Calibrates, stores the result and drops what it invalidates
+ *
+ * @details    Shared by the menu and the CAL command, returns the first
+ *             error of the calibration or the store.
+ */
+static int32_t run_calibration(uint8_t modes)
+{
+	int32_t error_code;
+
+	// a failed calibration must not be restored at the next boot
+	if ((error_code = do_fullscale_calibration(modes)) < 0)
+		printf("calibration not stored\r\n");
+	else
+		error_code = store_calibration();
+	ad7124_drift_reset();
+	ad7124_tare_clear();
+	return error_code;
+}
 
 /*!
- * @brief      Internal full-scale (gain) calibration.
+ * @brief      Runs a calibration from the menu and waits for a key
  *
  * @details
  */
-static int32_t menu_fullscale_calibration(void){
-	do_fullscale_calibration();
-	printf("calibration completed...\r\n\r\n");
+static int32_t menu_calibration(uint8_t modes)
+{
+	if (run_calibration(modes) < 0)
+		printf("calibration failed...\r\n\r\n");
+	else
+		printf("calibration completed...\r\n\r\n");
 	adi_press_any_key_to_continue();
 	return 0;
 }
 
+/*!
+ * @brief      System zero-scale (offset) calibration.
+ *
+ * @details
+ */
+static int32_t menu_zero_scale_calibration(void)
+{
+	return menu_calibration(CALIBRATION_ZERO);
+}
+
+/*!
+ * @brief      Internal full-scale (gain) and zero-scale calibration.
+ *
+ * @details    Two calibrations per setup, twice the time of the zero-scale
+ *             one; gain 1 setups get the zero-scale one only.
+ */
+static int32_t menu_fullscale_calibration(void)
+{
+	return menu_calibration(CALIBRATION_GAIN);
+}
+
 
 /*!
  * @brief      Samples all enabled channels and displays on the console
@@ -395,100 +1047,1065 @@ static int32_t menu_fullscale_calibration(void){
  */
 static int32_t menu_continuous_conversion_stream()
 {
-	do_continuous_conversion(true);
+	do_continuous_conversion(true, false);
 	printf("Continuous Conversion completed...\n");
 	adi_press_any_key_to_continue();
 	return(MENU_CONTINUE);
 }
 
 static int32_t menu_raw_conversion_stream() {
-	do_continuous_conversion(false);
+	do_continuous_conversion(false, false);
 	printf("Continuous Conversion completed...\n");
 	adi_press_any_key_to_continue();
 	return(MENU_CONTINUE);
 }
 
 /*!
- * @brief      menu item that reads the status register the AD7124
+ * @brief      Prints the current triggered capture settings
  *
  * @details
  */
-static int32_t menu_read_status(void)
+static int32_t menu_show_trigger_settings(void)
 {
-	read_status_register();
+	struct ad7124_capture_config *config = &ad7124_capture_config;
+	static const char *edges[] = {"off", "rising", "falling", "both"};
+	struct ad7124_timing timing;
+
+	ad7124_timing_from_map(pAd7124_dev->regs, &timing);
+	printf("\r\npre-trigger %u ms, post-trigger %u ms\r\n",
+	       config->pre_trigger_ms, config->post_trigger_ms);
+	printf("ring holds %lu ms at %lu.%03lu Hz per channel\r\n",
+	       (uint32_t)((uint64_t)AD7124_CAPTURE_DEPTH * timing.scan_period_us /
+			  (timing.channels ? timing.channels : 1) / 1000),
+	       timing.channel_odr_mhz / 1000, timing.channel_odr_mhz % 1000);
+	printf("gpio trigger: %s, pin %u\r\n",
+	       edges[(config->sources & AD7124_TRIGGER_GPIO) ? config->gpio_edge : 0],
+	       config->gpio_pin);
+	printf("level trigger: %s, channel %u, code %ld\r\n",
+	       edges[(config->sources & AD7124_TRIGGER_LEVEL) ? config->level_edge : 0],
+	       config->level_channel, config->level_code);
+	printf("host trigger ('t'): %s\r\n",
+	       (config->sources & AD7124_TRIGGER_HOST) ? "on" : "off");
 	adi_press_any_key_to_continue();
 	return(MENU_CONTINUE);
 }
 
-
-/*!
- * @brief      reads the ID register on the AD7124
- *
- * @details
- */
-static int32_t menu_read_id(void)
+static int32_t menu_set_trigger_window(void)
 {
-	if (ad7124_read_register(pAd7124_dev, &pAd7124_dev->regs[AD7124_ID]) < 0) {
-	   printf("\r\nError Encountered reading ID register\r\n");
-	} else {
-	   printf("\r\nRead ID Register = 0x%02lx\r\n",
-			   (uint32_t)pAd7124_dev->regs[AD7124_ID].value );
-	}
-	adi_press_any_key_to_continue();
+	printf("\r\npre-trigger ms: ");
+	ad7124_capture_config.pre_trigger_ms = adi_get_decimal_int(5);
+	printf("post-trigger ms: ");
+	ad7124_capture_config.post_trigger_ms = adi_get_decimal_int(5);
 	return(MENU_CONTINUE);
 }
 
+static int32_t menu_set_gpio_trigger(void)
+{
+	int32_t edge;
+
+	printf("\r\ninput pin (0-7): ");
+	ad7124_capture_config.gpio_pin = adi_get_decimal_int(1) & 0x7;
+	printf("edge (0 off, 1 rising, 2 falling, 3 both): ");
+	edge = adi_get_decimal_int(1) & 0x3;
+	ad7124_capture_config.gpio_edge = edge;
+	if (edge)
+		ad7124_capture_config.sources |= AD7124_TRIGGER_GPIO;
+	else
+		ad7124_capture_config.sources &= ~AD7124_TRIGGER_GPIO;
+	return(MENU_CONTINUE);
+}
 
-/*!
- * @brief      Initialize the part with a specific configuration
- *
- * @details
- */
-static void init_with_configuration(uint8_t configID)
+static int32_t menu_set_level_trigger(void)
 {
-	int32_t status = 0;
+	int32_t edge;
+
+	printf("\r\nchannel (0-15): ");
+	ad7124_capture_config.level_channel = adi_get_decimal_int(2) & 0xF;
+	printf("threshold (raw code): ");
+	ad7124_capture_config.level_code = adi_get_decimal_int(9);
+	printf("edge (0 off, 1 rising, 2 falling, 3 both): ");
+	edge = adi_get_decimal_int(1) & 0x3;
+	ad7124_capture_config.level_edge = edge;
+	if (edge)
+		ad7124_capture_config.sources |= AD7124_TRIGGER_LEVEL;
+	else
+		ad7124_capture_config.sources &= ~AD7124_TRIGGER_LEVEL;
+	return(MENU_CONTINUE);
+}
 
-	do {
-		if ((status = ad7124_remove(pAd7124_dev)) < 0) {
-			break;
-		}
+static int32_t menu_toggle_host_trigger(void)
+{
+	ad7124_capture_config.sources ^= AD7124_TRIGGER_HOST;
+	return(MENU_CONTINUE);
+}
 
-		if ((status = ad7124_app_initialize(configID)) < 0) {
-			break;
-		}
-	} while(0);
+static int32_t menu_triggered_capture_stream(void)
+{
+	do_continuous_conversion(true, true);
+	printf("Triggered capture completed...\n");
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
 
-	if (status < 0) {
-		printf("\r\n\r\n Error setting Configuration %c \r\n\r\n", (char)(configID + 'A'));
-	} else {
-		printf("\r\n\r\n Configuration %c Set\r\n\r\n", (char)(configID + 'A'));
-	}
+static int32_t menu_triggered_capture_raw(void)
+{
+	do_continuous_conversion(false, true);
+	printf("Triggered capture completed...\n");
 	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
 }
 
+console_menu_item trigger_menu_items[] = {
+	{"Start triggered capture",			'S', menu_triggered_capture_stream},
+	{"Triggered capture raw",			'R', menu_triggered_capture_raw},
+	{"", 								'\00', NULL},
+	{"Show trigger settings",			'V', menu_show_trigger_settings},
+	{"Pre/post trigger time",			'W', menu_set_trigger_window},
+	{"GPIO edge trigger",				'G', menu_set_gpio_trigger},
+	{"Channel level trigger",			'L', menu_set_level_trigger},
+	{"Toggle host trigger",				'H', menu_toggle_host_trigger}
+};
+
+console_menu trigger_menu = {
+	"Triggered capture",
+	trigger_menu_items,
+	ARRAY_SIZE(trigger_menu_items),
+	true
+};
+
 /*!
- * @brief      Reset and set the ad7124 with configuration A
+ * @brief      Opens the triggered capture menu
  *
  * @details
  */
-static int32_t menu_reset_to_configuration_a(void)
+static int32_t menu_triggered_capture(void)
 {
-	init_with_configuration(AD7124_CONFIG_A);
+	adi_do_console_menu(&trigger_menu);
 	return(MENU_CONTINUE);
 }
 
-
 /*!
- * @brief      Reset and the ad7124 with configuration B
+ * @brief      Lists the register profiles stored in flash
  *
  * @details
  */
-static int32_t menu_reset_to_configuration_b(void)
+static int32_t menu_list_profiles(void)
 {
-	init_with_configuration(AD7124_CONFIG_B);
+	const struct ad7124_profile *profile;
+
+	printf("\r\n");
+	for (uint8_t slot = 0; slot < AD7124_PROFILE_SLOTS; slot++) {
+		if ((profile = ad7124_profile_get(slot)) != NULL) {
+			printf("%2u: %.*s\r\n", slot, AD7124_PROFILE_NAME_LEN, profile->name);
+		}
+	}
+	adi_press_any_key_to_continue();
 	return(MENU_CONTINUE);
 }
 
+/*!
+ * @brief      Switches the device to a stored profile and reports the time
+ *
+ * @details    Only registers that differ from the live map are written.
+ *             Shared by the menu and the PROFILE APPLY command.
+ */
+static int32_t apply_profile(uint8_t slot)
+{
+	const struct ad7124_profile *profile;
+	uint64_t start;
+	int32_t written;
+
+	if ((profile = ad7124_profile_get(slot)) == NULL) {
+		printf("empty slot\r\n");
+		return INVALID_VAL;
+	}
+	start = time_us_64();
+	written = ad7124_profile_apply(pAd7124_dev, profile);
+	if (written < 0) {
+		printf("Error (%ld) applying profile\r\n", written);
+		return written;
+	}
+	printf("%.*s applied, %ld registers written in %lu us\r\n",
+	       AD7124_PROFILE_NAME_LEN, profile->name, written,
+	       (uint32_t)(time_us_64() - start));
+	stream_power_mode = pAd7124_dev->regs[AD7124_ADC_Control].value &
+			    AD7124_ADC_CTRL_REG_POWER_MODE(0x3);
+	restore_calibration();
+	ad7124_drift_reset();
+	ad7124_tare_clear();
+	return 0;
+}
+
+static int32_t menu_apply_profile(void)
+{
+	printf("\r\nprofile slot: ");
+	apply_profile(adi_get_decimal_int(2));
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Stores the live register map as a profile
+ *
+ * @details
+ */
+static int32_t menu_save_profile(void)
+{
+	struct ad7124_profile profile;
+	char name[AD7124_PROFILE_NAME_LEN];
+	uint8_t slot;
+
+	printf("\r\nprofile slot: ");
+	slot = adi_get_decimal_int(2);
+	printf("name: ");
+	adi_get_line(name, sizeof(name));
+
+	ad7124_profile_from_map(&profile, name, pAd7124_dev->regs);
+	if (ad7124_profile_save(slot, &profile) < 0) {
+		printf("Error saving profile\r\n");
+	} else {
+		printf("saved in slot %u\r\n", slot);
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Plans the filters for a per-channel rate and stores the result
+ *
+ * @details    Channels and setups are those of the live map, see
+ *             ad7124_planner.h. tools/ad7124_plan.cpp does the same on the
+ *             host.
+ */
+static int32_t menu_plan_profile(void)
+{
+	struct ad7124_st_reg regs[AD7124_REG_NO];
+	struct ad7124_profile profile;
+	struct ad7124_plan plan;
+	uint32_t rate_hz;
+	uint32_t noise_nv;
+	uint8_t slot;
+
+	printf("\r\nrate per channel (Hz): ");
+	rate_hz = adi_get_decimal_int(5);
+	printf("noise budget (nV rms, 0 = any): ");
+	noise_nv = adi_get_decimal_int(6);
+
+	memcpy(regs, pAd7124_dev->regs, sizeof(regs));
+	if (ad7124_plan_filters(regs, rate_hz * 1000, noise_nv, &plan) < 0) {
+		printf("no filter setting meets the rate and noise budget\r\n");
+	} else {
+		ad7124_plan_apply(&plan, regs);
+		printf("power mode %u, %s, FS %u, post filter %u\r\n", plan.power_mode,
+		       ad7124_plan_filter_name(&plan), plan.fs, plan.post_filter);
+		printf("%lu.%03lu Hz per channel, about %lu nV rms\r\n",
+		       plan.channel_odr_mhz / 1000, plan.channel_odr_mhz % 1000,
+		       plan.noise_nv);
+		printf("save in profile slot: ");
+		slot = adi_get_decimal_int(2);
+		ad7124_profile_from_map(&profile, "planned", regs);
+		if (ad7124_profile_save(slot, &profile) < 0) {
+			printf("Error saving profile\r\n");
+		} else {
+			printf("saved in slot %u\r\n", slot);
+		}
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Stores a profile typed (pasted) by the host as hex
+ *
+ * @details    The hex string is the binary struct ad7124_profile, as
+ *             printed by the dump item.
+ */
+static int32_t menu_upload_profile(void)
+{
+	static char hex[sizeof(struct ad7124_profile) * 2 + 1];
+	struct ad7124_profile profile;
+	uint8_t *bytes = (uint8_t *)&profile;
+	uint8_t slot;
+	unsigned int byte;
+
+	printf("\r\nprofile slot: ");
+	slot = adi_get_decimal_int(2);
+	printf("profile hex: ");
+	if (adi_get_line(hex, sizeof(hex)) != sizeof(hex) - 1) {
+		printf("Error, expected %u hex digits\r\n", sizeof(hex) - 1);
+	} else {
+		for (uint16_t i = 0; i < sizeof(profile); i++) {
+			sscanf(&hex[i * 2], "%2x", &byte);
+			bytes[i] = byte;
+		}
+		if (ad7124_profile_save(slot, &profile) < 0) {
+			printf("Error, profile rejected\r\n");
+		} else {
+			printf("saved in slot %u\r\n", slot);
+		}
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Prints a stored profile as hex, the upload format
+ *
+ * @details
+ */
+static int32_t menu_dump_profile(void)
+{
+	const struct ad7124_profile *profile;
+
+	printf("\r\nprofile slot: ");
+	if ((profile = ad7124_profile_get(adi_get_decimal_int(2))) == NULL) {
+		printf("empty slot\r\n");
+	} else {
+		for (uint16_t i = 0; i < sizeof(*profile); i++) {
+			printf("%02x", ((const uint8_t *)profile)[i]);
+		}
+		printf("\r\n");
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+static int32_t menu_erase_profile(void)
+{
+	printf("\r\nprofile slot: ");
+	if (ad7124_profile_erase(adi_get_decimal_int(2)) < 0) {
+		printf("Error erasing slot\r\n");
+		adi_press_any_key_to_continue();
+	}
+	return(MENU_CONTINUE);
+}
+
+console_menu_item profile_menu_items[] = {
+	{"List profiles",					'L', menu_list_profiles},
+	{"Apply profile",					'A', menu_apply_profile},
+	{"", 								'\00', NULL},
+	{"Save live registers as profile",	'S', menu_save_profile},
+	{"Plan filters for a rate",			'P', menu_plan_profile},
+	{"Upload profile (hex)",			'U', menu_upload_profile},
+	{"Dump profile (hex)",				'D', menu_dump_profile},
+	{"Erase profile",					'X', menu_erase_profile}
+};
+
+console_menu profile_menu = {
+	"Register profiles",
+	profile_menu_items,
+	ARRAY_SIZE(profile_menu_items),
+	true
+};
+
+static int32_t menu_profiles(void)
+{
+	adi_do_console_menu(&profile_menu);
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Displays the counters collected during the last acquisition
+ *
+ * @details
+ */
+static void print_acquisition_stats(void)
+{
+	struct ad7124_timing timing;
+
+	ad7124_timing_from_map(pAd7124_dev->regs, &timing);
+	ad7124_stats_print();
+	printf("expected %lu.%03lu Hz per channel, scan %lu us\r\n",
+	       timing.channel_odr_mhz / 1000, timing.channel_odr_mhz % 1000,
+	       timing.scan_period_us);
+	printf("gpio edges dropped %lu, skipped by the output mode %lu\r\n",
+	       ad7124_gpio_events_dropped(), ad7124_gpio_events_skipped());
+	ad7124_drift_print();
+	ad7124_tare_print();
+	ad7124_block_print();
+	ad7124_spectrum_print();
+	ad7124_usb_out_print();
+	ad7124_usb_vendor_print();
+	ad7124_boot_print();
+}
+
+static int32_t menu_acquisition_stats(void)
+{
+	print_acquisition_stats();
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Sets how often the stream probes the offset drift
+ *
+ * @details    See ad7124_drift.h, 0 switches tracking and correction off.
+ */
+static int32_t menu_drift_tracking(void)
+{
+	printf("\r\nscans between drift probes (0 = off, now %u): ", ad7124_drift.interval);
+	ad7124_drift.interval = adi_get_decimal_int(5);
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Tares the enabled channels on the next samples
+ *
+ * @details    The average is taken at the start of the next stream, 'z'
+ *             repeats it while streaming. 0 samples removes the tare.
+ */
+static int32_t menu_tare(void)
+{
+	uint16_t samples;
+
+	printf("\r\nsamples per channel (0 = clear tare): ");
+	if ((samples = adi_get_decimal_int(5)) == 0) {
+		ad7124_tare_clear();
+		printf("tare cleared\r\n");
+	} else {
+		ad7124_tare_begin(pAd7124_dev->regs, samples);
+		printf("tare runs over the next %u samples per channel\r\n", samples);
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Streams noise summaries of the enabled channels instead of rows
+ *
+ * @details    One "N" line per channel and period, see ad7124_noise.h.
+ */
+static int32_t menu_noise_statistics(void)
+{
+	int32_t period_ms;
+
+	printf("\r\nsummary period in ms (0 = %u): ", AD7124_NOISE_DEFAULT_PERIOD_MS);
+	period_ms = adi_get_decimal_int(7);
+	printf("\r\nN, time ms, channel, samples, mean, rms, peak-to-peak, rms nV, "
+	       "effective bits, noise-free bits\r\n");
+	ad7124_noise_begin(pAd7124_dev->regs, period_ms > 0 ? period_ms : 0);
+	do_continuous_conversion(false, false);
+	ad7124_noise_end();
+	printf("Noise statistics completed...\n");
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Streams the mains spectrum of the enabled channels, from core1
+ *
+ * @details    One "F" line per channel and frame, see ad7124_spectrum.h.
+ */
+static int32_t menu_mains_spectrum(void)
+{
+	int32_t frame_ms;
+
+	printf("\r\nframe length in ms (0 = %u): ", AD7124_SPECTRUM_DEFAULT_FRAME_MS);
+	frame_ms = adi_get_decimal_int(5);
+	if (ad7124_spectrum_begin(pAd7124_dev->regs, frame_ms > 0 ? frame_ms : 0) < 0) {
+		printf("\r\nchannels too slow for 50 Hz or frame too long\r\n");
+	} else {
+		do_continuous_conversion(false, false);
+		ad7124_spectrum_end();
+		printf("Mains spectrum completed...\n");
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Sets up breath detection for the streams that follow
+ *
+ * @details    Events only leave out the sample rows, see ad7124_breath.h.
+ */
+static int32_t menu_breath_detection(void)
+{
+	int32_t mode, min_amplitude;
+
+	printf("\r\n0 off, 1 events, 2 events and sample rows: ");
+	mode = adi_get_decimal_int(2);
+	if (mode < AD7124_BREATH_OFF || mode > AD7124_BREATH_RAW) {
+		printf("\r\ninvalid mode\r\n");
+		adi_press_any_key_to_continue();
+		return(MENU_CONTINUE);
+	}
+	ad7124_breath.mode = mode;
+	if (mode != AD7124_BREATH_OFF) {
+		printf("\r\nsmallest breath in codes (0 = %u): ",
+		       AD7124_BREATH_DEFAULT_MIN_AMPLITUDE);
+		min_amplitude = adi_get_decimal_int(8);
+		ad7124_breath.min_amplitude = min_amplitude > 0 ? min_amplitude :
+					      AD7124_BREATH_DEFAULT_MIN_AMPLITUDE;
+		printf("\r\nB, time ms, amplitude, interval ms\r\n"
+		       "BR, time ms, breaths/min, mean amplitude, apnea\r\n");
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Dumps the trace ring for tools/ad7124_trace.py and clears it
+ *
+ * @details
+ */
+static int32_t menu_export_trace(void)
+{
+	ad7124_trace_export();
+	ad7124_trace_clear();
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      Dumps the device registers and compares them with the shadow map
+ *
+ * @details    The hex line is the binary struct ad7124_snapshot.
+ */
+static int32_t print_register_snapshot(void)
+{
+	struct ad7124_snapshot snapshot;
+	uint64_t start = time_us_64();
+	int32_t differing;
+
+	if ((differing = ad7124_snapshot_dump(pAd7124_dev, &snapshot)) < 0) {
+		printf("Error (%ld) reading registers\r\n", differing);
+		return differing;
+	}
+	printf("registers read in %lu us, %ld differ from the shadow map\r\n",
+	       (uint32_t)(time_us_64() - start), differing);
+	ad7124_snapshot_print(&snapshot, pAd7124_dev->regs);
+	return 0;
+}
+
+/*!
+ * @brief      Writes the shadow map back, e.g. after a brown-out, and checks it
+ *
+ * @details
+ */
+static int32_t restore_registers(void)
+{
+	uint64_t start = time_us_64();
+	int32_t written;
+
+	if ((written = ad7124_snapshot_restore(pAd7124_dev)) < 0) {
+		printf("Error (%ld) writing registers\r\n", written);
+		return written;
+	}
+	printf("%ld registers written in %lu us\r\n", written,
+	       (uint32_t)(time_us_64() - start));
+	return print_register_snapshot();
+}
+
+/*!
+ * @brief      Times the "%.8f" volts of the stream with snprintf() and with
+ *             the integer formatter, and checks that both agree
+ *
+ * @details    Bipolar gain 2 codes around mid scale, no output involved.
+ */
+static void format_benchmark(void)
+{
+	const uint32_t count = 2000;
+	char expected[AD7124_FORMAT_FIELD_LEN + 4];
+	char field[AD7124_FORMAT_FIELD_LEN];
+	uint32_t elapsed_us[2];
+	uint32_t mismatches = 0;
+	uint32_t start;
+	float volts;
+	char *end;
+
+	start = time_us_32();
+	for (uint32_t i = 0; i < count; i++) {
+		volts = ((float)(0x7C0000 + i * 67) / (1 << 23) - 1) * (AD7124_REF_VOLTAGE / AD7124_PGA_GAIN(1));
+		snprintf(expected, sizeof(expected), "%.8f", volts);
+	}
+	elapsed_us[0] = time_us_32() - start;
+
+	start = time_us_32();
+	for (uint32_t i = 0; i < count; i++)
+		ad7124_format_volts(field, 0x7C0000 + i * 67, true, 1);
+	elapsed_us[1] = time_us_32() - start;
+
+	for (uint32_t i = 0; i < count; i++) {
+		volts = ((float)(0x7C0000 + i * 67) / (1 << 23) - 1) * (AD7124_REF_VOLTAGE / AD7124_PGA_GAIN(1));
+		snprintf(expected, sizeof(expected), "%.8f", volts);
+		end = ad7124_format_volts(field, 0x7C0000 + i * 67, true, 1);
+		mismatches += (size_t)(end - field) != strlen(expected) ||
+			      memcmp(field, expected, end - field) != 0;
+	}
+
+	printf("volts formatting, ns per value: snprintf %lu, integer %lu, %lu mismatches\r\n",
+	       elapsed_us[0] * 1000 / count, elapsed_us[1] * 1000 / count, mismatches);
+}
+
+/*!
+ * @brief      Sends stream-like rows through stdio and through the direct CDC
+ *             path for a second each and compares the rates
+ *
+ * @details    Rows are a timestamp, the inputs and four raw codes. The rate
+ *             is whatever the host takes, run it with the host reading as
+ *             it would read a stream.
+ */
+static void usb_output_benchmark(void)
+{
+	const uint32_t duration_us = 1000000;
+	uint32_t rows[2] = {0, 0};
+	uint32_t bytes[2] = {0, 0};
+	uint32_t elapsed_us[2];
+	uint32_t rate[2];
+	uint32_t start;
+
+	start = time_us_32();
+	while (time_us_32() - start < duration_us) {
+		// the '\r' stdio puts in front of the '\n'
+		bytes[0] += 1 + printf("\n%09lu, %i, ", rows[0], 0);
+		for (uint8_t ch = 0; ch < 4; ch++)
+			bytes[0] += printf(ch ? ", %lu" : "%lu", 8388608 + rows[0] + ch);
+		rows[0]++;
+	}
+	stdio_flush();
+	elapsed_us[0] = time_us_32() - start;
+
+	ad7124_usb_out_reset_stats();
+	start = time_us_32();
+	while (time_us_32() - start < duration_us) {
+		ad7124_usb_out_printf("\n%09lu, %i, ", rows[1], 0);
+		for (uint8_t ch = 0; ch < 4; ch++)
+			ad7124_usb_out_printf(ch ? ", %lu" : "%lu", 8388608 + rows[1] + ch);
+		ad7124_usb_out_poll();
+		rows[1]++;
+	}
+	ad7124_usb_out_flush();
+	elapsed_us[1] = time_us_32() - start;
+	bytes[1] = ad7124_usb_out_stats.bytes;
+
+	printf("\r\n");
+	for (uint8_t path = 0; path < 2; path++) {
+		rate[path] = bytes[path] * 1000000ull / elapsed_us[path];
+		printf("%s %lu rows, %lu bytes/s\r\n", path ? "direct cdc" : "stdio     ",
+		       rows[path], rate[path]);
+	}
+	// the line to quote, both paths against the same host
+	if (rate[0] > 0)
+		printf("direct cdc/stdio %lu.%02lu\r\n", rate[1] / rate[0],
+		       (uint32_t)(rate[1] % rate[0] * 100ull / rate[0]));
+	ad7124_usb_out_print();
+	format_benchmark();
+}
+
+static int32_t menu_usb_output_benchmark(void)
+{
+	usb_output_benchmark();
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+#if AD7124_USB_VENDOR
+static int32_t menu_usb_vendor_test_pattern(void)
+{
+	ad7124_usb_vendor_test_pattern();
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+#endif
+
+static int32_t menu_register_snapshot(void)
+{
+	print_register_snapshot();
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+static int32_t menu_restore_registers(void)
+{
+	restore_registers();
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+/*!
+ * @brief      menu item that reads the status register the AD7124
+ *
+ * @details
+ */
+static int32_t menu_read_status(void)
+{
+	read_status_register();
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+
+/*!
+ * @brief      reads the ID register on the AD7124
+ *
+ * @details
+ */
+static int32_t menu_read_id(void)
+{
+	if (ad7124_read_register(pAd7124_dev, &pAd7124_dev->regs[AD7124_ID]) < 0) {
+	   printf("\r\nError Encountered reading ID register\r\n");
+	} else {
+	   printf("\r\nRead ID Register = 0x%02lx\r\n",
+			   (uint32_t)pAd7124_dev->regs[AD7124_ID].value );
+	}
+	adi_press_any_key_to_continue();
+	return(MENU_CONTINUE);
+}
+
+
+/*!
+ * @brief      Initialize the part with a specific configuration
+ *
+ * @details
+ */
+static void init_with_configuration(uint8_t configID)
+{
+	int32_t status = 0;
+
+	do {
+		if ((status = ad7124_remove(pAd7124_dev)) < 0) {
+			break;
+		}
+
+		if ((status = ad7124_app_initialize(configID)) < 0) {
+			break;
+		}
+	} while(0);
+
+	if (status < 0) {
+		printf("\r\n\r\n Error setting Configuration %c \r\n\r\n", (char)(configID + 'A'));
+	} else {
+		printf("\r\n\r\n Configuration %c Set\r\n\r\n", (char)(configID + 'A'));
+	}
+	adi_press_any_key_to_continue();
+}
+
+/*!
+ * @brief      Reset and set the ad7124 with configuration A
+ *
+ * @details
+ */
+static int32_t menu_reset_to_configuration_a(void)
+{
+	init_with_configuration(AD7124_CONFIG_A);
+	return(MENU_CONTINUE);
+}
+
+
+/*!
+ * @brief      Reset and the ad7124 with configuration B
+ *
+ * @details
+ */
+static int32_t menu_reset_to_configuration_b(void)
+{
+	init_with_configuration(AD7124_CONFIG_B);
+	return(MENU_CONTINUE);
+}
+
+
+/*!
+ * @brief      RREG reg [count], reads registers from the device
+ *
+ * @details    One "reg value" line per register, both in hex.
+ */
+static int32_t command_read_registers(uint8_t argc, char **argv)
+{
+	uint32_t reg, count = 1;
+	int32_t error_code;
+
+	if (argc < 2 || ad7124_protocol_number(argv[1], AD7124_REG_NO - 1, &reg) < 0 ||
+	    (argc > 2 && ad7124_protocol_number(argv[2], AD7124_REG_NO - reg, &count) < 0))
+		return INVALID_VAL;
+
+	for (uint32_t i = reg; i < reg + count; i++) {
+		if (pAd7124_dev->regs[i].rw == AD7124_W)
+			continue;
+		if ((error_code = ad7124_read_register(pAd7124_dev, &pAd7124_dev->regs[i])) < 0)
+			return error_code;
+		printf("%02lx %06lx\n", i, (uint32_t)pAd7124_dev->regs[i].value);
+	}
+	return 0;
+}
+
+/*!
+ * @brief      WREG reg value..., writes consecutive registers
+ *
+ * @details    The live map is updated as well, the stream and the
+ *             calibration work from it. A write to Error_En updates the
+ *             CRC and ready check of the driver, as ad7124_setup() does.
+ */
+static int32_t command_write_registers(uint8_t argc, char **argv)
+{
+	uint32_t reg, value;
+	int32_t error_code;
+
+	if (argc < 3 || ad7124_protocol_number(argv[1], AD7124_REG_NO - 1, &reg) < 0 ||
+	    reg + argc - 2 > AD7124_REG_NO)
+		return INVALID_VAL;
+
+	for (uint8_t i = 2; i < argc; i++, reg++) {
+		if (pAd7124_dev->regs[reg].rw == AD7124_R ||
+		    ad7124_protocol_number(argv[i], 0xFFFFFF, &value) < 0)
+			return INVALID_VAL;
+		pAd7124_dev->regs[reg].value = value;
+		if ((error_code = ad7124_write_register(pAd7124_dev, pAd7124_dev->regs[reg])) < 0)
+			return error_code;
+
+		/* Get CRC State and device SPI interface settings */
+		if (reg == AD7124_Error_En) {
+			ad7124_update_crcsetting(pAd7124_dev);
+			ad7124_update_dev_spi_settings(pAd7124_dev);
+		}
+	}
+	return 0;
+}
+
+/*!
+ * @brief      START RAW|VOLT [TRIG], streams until ESC
+ *
+ * @details    OK goes out before the first row, END after the last.
+ */
+static int32_t command_start(uint8_t argc, char **argv)
+{
+	bool voltage;
+
+	if (argc < 2)
+		return INVALID_VAL;
+	if (strcasecmp(argv[1], "VOLT") == 0)
+		voltage = true;
+	else if (strcasecmp(argv[1], "RAW") == 0)
+		voltage = false;
+	else
+		return INVALID_VAL;
+
+	ad7124_protocol_ack();
+	if (do_continuous_conversion(voltage, argc > 2 && strcasecmp(argv[2], "TRIG") == 0) < 0)
+		return TIMEOUT;
+	printf("\n");
+	return 0;
+}
+
+static int32_t command_calibrate(uint8_t argc, char **argv)
+{
+	if (argc == 1)
+		return run_calibration(CALIBRATION_ZERO);
+	if (argc == 2 && strcasecmp(argv[1], "GAIN") == 0)
+		return run_calibration(CALIBRATION_GAIN);
+	return INVALID_VAL;
+}
+
+static int32_t command_stats(uint8_t argc, char **argv)
+{
+	print_acquisition_stats();
+	return 0;
+}
+
+/*!
+ * @brief      PROFILE LIST | APPLY slot | SAVE slot name
+ *
+ * @details
+ */
+static int32_t command_profile(uint8_t argc, char **argv)
+{
+	const struct ad7124_profile *stored;
+	struct ad7124_profile profile;
+	uint32_t slot;
+
+	if (argc == 2 && strcasecmp(argv[1], "LIST") == 0) {
+		for (slot = 0; slot < AD7124_PROFILE_SLOTS; slot++) {
+			if ((stored = ad7124_profile_get(slot)) != NULL)
+				printf("%lu %.*s\n", slot, AD7124_PROFILE_NAME_LEN, stored->name);
+		}
+		return 0;
+	}
+	if (argc < 3 || ad7124_protocol_number(argv[2], AD7124_PROFILE_SLOTS - 1, &slot) < 0)
+		return INVALID_VAL;
+	if (argc == 3 && strcasecmp(argv[1], "APPLY") == 0)
+		return apply_profile(slot);
+	if (argc == 4 && strcasecmp(argv[1], "SAVE") == 0) {
+		ad7124_profile_from_map(&profile, argv[3], pAd7124_dev->regs);
+		return ad7124_profile_save(slot, &profile);
+	}
+	return INVALID_VAL;
+}
+
+/*!
+ * @brief      TARE samples, 0 clears the tare
+ *
+ * @details
+ */
+static int32_t command_tare(uint8_t argc, char **argv)
+{
+	uint32_t samples;
+
+	if (argc != 2 || ad7124_protocol_number(argv[1], UINT16_MAX, &samples) < 0)
+		return INVALID_VAL;
+	if (samples == 0)
+		ad7124_tare_clear();
+	else
+		ad7124_tare_begin(pAd7124_dev->regs, samples);
+	return 0;
+}
+
+static int32_t command_snapshot(uint8_t argc, char **argv)
+{
+	return print_register_snapshot();
+}
+
+static int32_t command_restore(uint8_t argc, char **argv)
+{
+	return restore_registers();
+}
+
+/*!
+ * @brief      READ channel..., one settled reading per channel
+ *
+ * @details    "channel timestamp code" lines, the OK carries the read time
+ *             and the worst case in us. The map is put back afterwards, a
+ *             control loop in the firmware keeps it prepared instead.
+ */
+static int32_t command_oneshot(uint8_t argc, char **argv)
+{
+	struct ad7124_oneshot_reading readings[AD7124_ONESHOT_CHANNELS];
+	uint16_t channels = 0;
+	uint32_t channel, start, elapsed;
+	int32_t count, ret;
+
+	for (uint8_t i = 1; i < argc; i++) {
+		if (ad7124_protocol_number(argv[i], AD7124_ONESHOT_CHANNELS - 1, &channel) < 0)
+			return INVALID_VAL;
+		channels |= 1 << channel;
+	}
+	if ((ret = ad7124_oneshot_prepare(pAd7124_dev, channels)) < 0)
+		return ret;
+
+	start = time_us_32();
+	count = ad7124_oneshot_read(pAd7124_dev, readings);
+	elapsed = time_us_32() - start;
+	if ((ret = ad7124_oneshot_release(pAd7124_dev)) < 0 || count < 0)
+		return count < 0 ? count : ret;
+
+	for (uint8_t i = 0; i < count; i++) {
+		printf("%u %lu %ld\n", readings[i].channel, readings[i].timestamp_us,
+		       readings[i].code);
+	}
+	ad7124_protocol_ok("%lu %lu", elapsed, ad7124_oneshot.worst_case_us);
+	return 0;
+}
+
+static int32_t command_drift(uint8_t argc, char **argv)
+{
+	uint32_t interval;
+
+	if (argc != 2 || ad7124_protocol_number(argv[1], UINT16_MAX, &interval) < 0)
+		return INVALID_VAL;
+	ad7124_drift.interval = interval;
+	return 0;
+}
+
+/*!
+ * @brief      NOISE [period_ms], summary lines until the stream is stopped
+ *
+ * @details
+ */
+static int32_t command_noise(uint8_t argc, char **argv)
+{
+	uint32_t period_ms = 0;
+	int32_t ret;
+
+	if (argc > 2 || (argc == 2 && ad7124_protocol_number(argv[1], 3600000, &period_ms) < 0))
+		return INVALID_VAL;
+
+	ad7124_protocol_ack();
+	ad7124_noise_begin(pAd7124_dev->regs, period_ms);
+	ret = do_continuous_conversion(false, false);
+	ad7124_noise_end();
+	return ret < 0 ? TIMEOUT : 0;
+}
+
+/*!
+ * @brief      SPECTRUM [frame_ms], spectrum lines until the stream is stopped
+ *
+ * @details
+ */
+static int32_t command_spectrum(uint8_t argc, char **argv)
+{
+	uint32_t frame_ms = 0;
+	int32_t ret;
+
+	if (argc > 2 || (argc == 2 && ad7124_protocol_number(argv[1], 60000, &frame_ms) < 0))
+		return INVALID_VAL;
+	if ((ret = ad7124_spectrum_begin(pAd7124_dev->regs, frame_ms)) < 0)
+		return ret;
+
+	ad7124_protocol_ack();
+	ret = do_continuous_conversion(false, false);
+	ad7124_spectrum_end();
+	return ret < 0 ? TIMEOUT : 0;
+}
+
+/*!
+ * @brief      BREATH OFF|ON|RAW [min_amplitude], for the streams that follow
+ *
+ * @details    ON sends the events instead of the sample rows, RAW both.
+ */
+static int32_t command_breath(uint8_t argc, char **argv)
+{
+	uint32_t min_amplitude = AD7124_BREATH_DEFAULT_MIN_AMPLITUDE;
+	uint8_t mode;
+
+	if (argc < 2 || argc > 3)
+		return INVALID_VAL;
+	if (strcasecmp(argv[1], "OFF") == 0)
+		mode = AD7124_BREATH_OFF;
+	else if (strcasecmp(argv[1], "ON") == 0)
+		mode = AD7124_BREATH_EVENTS;
+	else if (strcasecmp(argv[1], "RAW") == 0)
+		mode = AD7124_BREATH_RAW;
+	else
+		return INVALID_VAL;
+	if (argc == 3 && ad7124_protocol_number(argv[2], 0xFFFFFF, &min_amplitude) < 0)
+		return INVALID_VAL;
+
+	ad7124_breath.mode = mode;
+	ad7124_breath.min_amplitude = min_amplitude;
+	return 0;
+}
+
+static const struct ad7124_protocol_command protocol_commands[] = {
+	{"RREG",	"reg [count]",			command_read_registers},
+	{"WREG",	"reg value...",			command_write_registers},
+	{"START",	"RAW|VOLT [TRIG]",		command_start},
+	{"CAL",		"[GAIN]",				command_calibrate},
+	{"STATS",	"",						command_stats},
+	{"READ",	"channel...",			command_oneshot},
+	{"PROFILE",	"LIST|APPLY slot|SAVE slot name",	command_profile},
+	{"TARE",	"samples",				command_tare},
+	{"DRIFT",	"scans",				command_drift},
+	{"NOISE",	"[period_ms]",			command_noise},
+	{"SPECTRUM",	"[frame_ms]",			command_spectrum},
+	{"BREATH",		"OFF|ON|RAW [min_amplitude]",	command_breath},
+	{"SNAPSHOT",	"",						command_snapshot},
+	{"RESTORE",	"",						command_restore}
+};
+
+static const struct ad7124_protocol protocol = {
+	protocol_commands,
+	ARRAY_SIZE(protocol_commands)
+};
+
+/*!
+ * @brief      Hands the console to the line protocol until EXIT
+ *
+ * @details    See ad7124_protocol.h.
+ */
+static int32_t menu_command_protocol(void)
+{
+	ad7124_protocol_run(&protocol);
+	return(MENU_CONTINUE);
+}
 
 /*
  * Definition of the Main Menu Items and menu itself
@@ -496,10 +2113,27 @@ static int32_t menu_reset_to_configuration_b(void)
 console_menu_item main_menu_items[] = {			
     {"Start continuous conversion",		'S', menu_continuous_conversion_stream},
 	{"Continous conversion raw",		'R', menu_raw_conversion_stream},
+	{"Triggered capture",				'G', menu_triggered_capture},
 	{"", 								'\00', NULL},
-	{"Zero and full scale calibration", 'Z', menu_fullscale_calibration},
+	{"Zero scale calibration",			'Z', menu_zero_scale_calibration},
+	{"Zero and gain calibration, twice as long",	'C', menu_fullscale_calibration},
+	{"Register profiles",				'F', menu_profiles},
+	{"Drift tracking",					'D', menu_drift_tracking},
+	{"Tare channels",					'N', menu_tare},
+	{"Noise statistics",				'Q', menu_noise_statistics},
+	{"Mains spectrum",					'P', menu_mains_spectrum},
+	{"Breath detection",				'B', menu_breath_detection},
 	{"Read Status Register",			'T', menu_read_status},	
-	{"Read ID Register ", 				'I', menu_read_id}
+	{"Read ID Register ", 				'I', menu_read_id},
+	{"Register snapshot",				'M', menu_register_snapshot},
+	{"Rewrite registers from shadow map",	'W', menu_restore_registers},
+	{"Acquisition statistics",			'A', menu_acquisition_stats},
+	{"Export trace",					'E', menu_export_trace},
+	{"Output benchmark",				'U', menu_usb_output_benchmark},
+#if AD7124_USB_VENDOR
+	{"USB bulk test pattern",			'V', menu_usb_vendor_test_pattern},
+#endif
+	{"Command protocol",				'$', menu_command_protocol}
 };
 
 console_menu ad7124_main_menu = {
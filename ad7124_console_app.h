@@ -19,6 +19,13 @@ Copyright (c) 2019 Analog Devices, Inc.  All rights reserved.
 #define AD7124_CONFIG_A       0
 #define AD7124_CONFIG_B       1
 
+/* Stream started at boot, before the menu: 0 none, or one of the modes below */
+#ifndef AD7124_AUTOSTART
+#define AD7124_AUTOSTART      0
+#endif
+#define AD7124_AUTOSTART_VOLTS  1
+#define AD7124_AUTOSTART_RAW    2
+
 /* Public Declarations */
 static void spiInit();
 int32_t ad7124_app_initialize(uint8_t configID);
@@ -0,0 +1,180 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_drift.c
+
+  @brief: Background offset-drift tracking with shorted-input probes
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ad7124_drift.h"
+
+// Weight of a new probe in the correction, 1 / 2^DRIFT_FILTER_SHIFT
+#define DRIFT_FILTER_SHIFT	3
+
+struct ad7124_drift ad7124_drift = {
+	.interval = 0,
+	.probe_channel = AD7124_DRIFT_NONE,
+	.active_setup = AD7124_DRIFT_NONE,
+};
+
+/*!
+ * @brief      Forgets baselines and corrections, after a calibration or a
+ *             configuration change
+ *
+ * @details
+ */
+void ad7124_drift_reset(void)
+{
+	memset(ad7124_drift.has_baseline, 0, sizeof(ad7124_drift.has_baseline));
+	memset(ad7124_drift.correction_x16, 0, sizeof(ad7124_drift.correction_x16));
+}
+
+/*!
+ * @brief      Prepares the probes for a stream over a register map
+ *
+ * @details    The highest channel becomes the spare if it and the ones below
+ *             it down to the last enabled channel are disabled; a spare in
+ *             the middle of the sequence would restart it in front of the
+ *             channels above it. Only bipolar setups are tracked, a shorted
+ *             unipolar input sits at the clipping point. Baselines carry
+ *             over from earlier streams.
+ */
+void ad7124_drift_start(const struct ad7124_st_reg *regs)
+{
+	struct ad7124_drift *drift = &ad7124_drift;
+
+	drift->probe_channel = AD7124_DRIFT_NONE;
+	drift->active_setup = AD7124_DRIFT_NONE;
+	drift->tracked = 0;
+	drift->next_setup = 0;
+	drift->scans_to_probe = drift->interval;
+	drift->probes = 0;
+	drift->scans = 0;
+	drift->channels = 0;
+
+	for (uint8_t ch = 0; ch < AD7124_DRIFT_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value;
+		uint8_t setup = (value >> 12) & 0x7;
+
+		drift->setup_of[ch] = setup;
+		if (!(value & AD7124_CH_MAP_REG_CH_ENABLE)) {
+			drift->probe_channel = ch;
+			continue;
+		}
+		drift->probe_channel = AD7124_DRIFT_NONE;
+		drift->channels++;
+		if (regs[AD7124_Config_0 + setup].value & AD7124_CFG_REG_BIPOLAR)
+			drift->tracked |= 1 << setup;
+	}
+}
+
+/*!
+ * @brief      Counts a completed scan, returns the setup to probe now
+ *
+ * @details    AD7124_DRIFT_NONE when no probe is due. The caller enables
+ *             the spare channel with ad7124_drift_probe_register().
+ */
+int8_t ad7124_drift_scan_done(void)
+{
+	struct ad7124_drift *drift = &ad7124_drift;
+
+	drift->scans++;
+	if (drift->interval == 0 || drift->tracked == 0 ||
+	    drift->probe_channel == AD7124_DRIFT_NONE ||
+	    drift->active_setup != AD7124_DRIFT_NONE)
+		return AD7124_DRIFT_NONE;
+	if (--drift->scans_to_probe > 0)
+		return AD7124_DRIFT_NONE;
+
+	drift->scans_to_probe = drift->interval;
+	while (!(drift->tracked & (1 << drift->next_setup)))
+		drift->next_setup = (drift->next_setup + 1) % AD7124_DRIFT_SETUPS;
+	drift->active_setup = drift->next_setup;
+	drift->next_setup = (drift->next_setup + 1) % AD7124_DRIFT_SETUPS;
+	drift->probes++;
+
+	return drift->active_setup;
+}
+
+/*!
+ * @brief      Spare channel register that shorts the inputs of a setup
+ *
+ * @details    Both inputs go to the negative input of the first enabled
+ *             channel of the setup, so the probe sees its common mode.
+ */
+struct ad7124_st_reg ad7124_drift_probe_register(const struct ad7124_st_reg *regs,
+						 uint8_t setup)
+{
+	struct ad7124_st_reg reg = regs[AD7124_Channel_0 + ad7124_drift.probe_channel];
+	uint8_t input = 0;
+
+	for (uint8_t ch = 0; ch < AD7124_DRIFT_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value;
+
+		if ((value & AD7124_CH_MAP_REG_CH_ENABLE) && ad7124_drift.setup_of[ch] == setup) {
+			input = value & 0x1F;
+			break;
+		}
+	}
+	reg.value = AD7124_CH_MAP_REG_CH_ENABLE | AD7124_CH_MAP_REG_SETUP(setup) |
+		    AD7124_CH_MAP_REG_AINP(input) | AD7124_CH_MAP_REG_AINM(input);
+	return reg;
+}
+
+/*!
+ * @brief      Takes the result of the probe in flight
+ *
+ * @details
+ */
+void ad7124_drift_probe_result(int32_t code)
+{
+	struct ad7124_drift *drift = &ad7124_drift;
+	int8_t setup = drift->active_setup;
+	int32_t error_x16;
+
+	if (setup == AD7124_DRIFT_NONE)
+		return;
+	drift->active_setup = AD7124_DRIFT_NONE;
+
+	if (!drift->has_baseline[setup]) {
+		drift->has_baseline[setup] = true;
+		drift->baseline[setup] = code;
+		return;
+	}
+	error_x16 = (code - drift->baseline[setup]) * 16;
+	drift->correction_x16[setup] += (error_x16 - drift->correction_x16[setup]) >> DRIFT_FILTER_SHIFT;
+}
+
+/*!
+ * @brief      Prints the drift per setup and the cost of the probes
+ *
+ * @details    The cost is the share of conversion slots taken by probes.
+ */
+void ad7124_drift_print(void)
+{
+	struct ad7124_drift *drift = &ad7124_drift;
+	uint32_t slots = drift->scans * drift->channels + drift->probes;
+	uint32_t cost = slots ? (uint32_t)(drift->probes * 10000ull / slots) : 0;
+
+	if (drift->interval == 0) {
+		printf("drift tracking off\r\n");
+		return;
+	}
+	if (drift->probe_channel == AD7124_DRIFT_NONE) {
+		printf("drift tracking needs a disabled channel above the enabled ones\r\n");
+		return;
+	}
+	printf("drift probe every %u scans on channel %d, %lu probes in %lu scans, cost %lu.%02lu %%\r\n",
+	       drift->interval, drift->probe_channel, drift->probes, drift->scans,
+	       cost / 100, cost % 100);
+	for (uint8_t setup = 0; setup < AD7124_DRIFT_SETUPS; setup++) {
+		if (drift->has_baseline[setup])
+			printf("setup %u: drift %ld codes\r\n", setup,
+			       (drift->correction_x16[setup] + 8) >> 4);
+	}
+}
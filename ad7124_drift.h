@@ -0,0 +1,68 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_drift.h
+
+  @brief: Background offset-drift tracking with shorted-input probes
+
+  @details: Every interval scans a spare channel above the enabled ones is
+            enabled for one scan, with both inputs on the negative input of
+            one of the setups in use. The ADC appends it to the sequence, its
+            result is the offset of that setup. Enabling and disabling it
+            restarts the sequence at the first channel; a conversion that
+            finished but was not read by then is lost and counted in the
+            missed column of the statistics (tools/ad7124_drift_sim.c). The first probe of each setup after a
+            reset is the baseline, the difference of later probes, low pass
+            filtered, is subtracted from the samples of the setup. The spare
+            channel is never enabled in the register map, so the stream
+            itself does not see it.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_DRIFT_H_
+#define AD7124_DRIFT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ad7124.h"
+
+#define AD7124_DRIFT_CHANNELS	16
+#define AD7124_DRIFT_SETUPS	8
+
+/* No spare channel or no probe in flight */
+#define AD7124_DRIFT_NONE	(-1)
+
+struct ad7124_drift {
+	uint16_t interval;		/* scans between probes, 0 = off */
+	int8_t probe_channel;		/* spare channel, AD7124_DRIFT_NONE if none above the enabled */
+	int8_t active_setup;		/* setup of the probe in flight */
+	uint8_t setup_of[AD7124_DRIFT_CHANNELS];
+	uint8_t tracked;		/* mask of bipolar setups in use */
+	uint8_t next_setup;
+	uint16_t scans_to_probe;
+	bool has_baseline[AD7124_DRIFT_SETUPS];
+	int32_t baseline[AD7124_DRIFT_SETUPS];
+	int32_t correction_x16[AD7124_DRIFT_SETUPS];	/* codes, 4 fractional bits */
+	uint32_t probes;
+	uint32_t scans;
+	uint8_t channels;
+};
+
+extern struct ad7124_drift ad7124_drift;
+
+void ad7124_drift_reset(void);
+void ad7124_drift_start(const struct ad7124_st_reg *regs);
+int8_t ad7124_drift_scan_done(void);
+struct ad7124_st_reg ad7124_drift_probe_register(const struct ad7124_st_reg *regs,
+						 uint8_t setup);
+void ad7124_drift_probe_result(int32_t code);
+void ad7124_drift_print(void);
+
+/* Sample with the drift of its setup removed, cheap enough for the hot loop */
+static inline int32_t ad7124_drift_correct(uint8_t channel, int32_t code)
+{
+	if (ad7124_drift.interval == 0)
+		return code;
+	return code - ((ad7124_drift.correction_x16[ad7124_drift.setup_of[channel]] + 8) >> 4);
+}
+
+#endif /* AD7124_DRIFT_H_ */
@@ -0,0 +1,114 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_format.c
+
+  @brief: Integer-only formatting of the stream fields
+
+  @details: ad7124_convert_sample_to_voltage() computes, exactly in double,
+            (code - 2^23) * 5 / 2^(24 + pga) for bipolar setups and
+            code * 5 / 2^(25 + pga) for unipolar ones, then rounds to float.
+            Codes below 2^24 keep every step exact, larger ones (a tare can
+            push a code out of range) are left to printf. At gain 128 the
+            unipolar divisor 128 * 2^24 overflows int to -2^31, those
+            volts come out negated and are reproduced so.
+ -----------------------------------------------------------------------------
+*/
+
+#include <stddef.h>
+
+#include "ad7124_format.h"
+
+#define FLOAT_MANTISSA_BITS	24
+#define DECIMALS_SCALE		100000000ull	/* %.8f */
+
+/*!
+ * @brief      Writes a decimal integer as "%0*d" does, width 0 for "%d"
+ *
+ * @details    The sign counts towards the width.
+ */
+char *ad7124_format_int(char *out, int32_t value, uint8_t width)
+{
+	char digits[10];
+	uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+	uint8_t count = 0;
+
+	do {
+		digits[count++] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude);
+
+	if (value < 0) {
+		*out++ = '-';
+		if (width)
+			width--;
+	}
+	while (width > count) {
+		*out++ = '0';
+		width--;
+	}
+	while (count)
+		*out++ = digits[--count];
+	return out;
+}
+
+/*!
+ * @brief      Writes "%.8f" of the voltage of a code
+ *
+ * @details    Returns NULL for codes of 2^24 and up, format those with
+ *             printf.
+ */
+char *ad7124_format_volts(char *out, uint32_t code, bool bipolar, uint8_t pga)
+{
+	uint32_t magnitude;
+	uint8_t exponent;
+	bool negative = false;
+	uint8_t bits;
+	uint64_t scaled;
+	uint64_t half;
+	uint64_t remainder;
+	uint32_t whole;
+	uint32_t fraction;
+
+	if (code >> FLOAT_MANTISSA_BITS)
+		return NULL;
+
+	if (bipolar) {
+		negative = code < (1u << 23);
+		magnitude = (negative ? (1u << 23) - code : code - (1u << 23)) * 5;
+		exponent = 24 + pga;
+	} else {
+		// includes -0.00000000 for code 0, as printf prints -0.0f
+		negative = pga == 7;
+		magnitude = code * 5;
+		exponent = 25 + pga;
+	}
+
+	// round to a float mantissa, half to even
+	bits = magnitude ? 32 - __builtin_clz(magnitude) : 0;
+	if (bits > FLOAT_MANTISSA_BITS) {
+		uint8_t shift = bits - FLOAT_MANTISSA_BITS;
+		uint32_t dropped = magnitude & ((1u << shift) - 1);
+
+		magnitude >>= shift;
+		half = 1u << (shift - 1);
+		if (dropped > half || (dropped == half && (magnitude & 1)))
+			magnitude++;
+		exponent -= shift;
+	}
+
+	// magnitude / 2^exponent to eight decimals, half to even
+	scaled = (uint64_t)magnitude * DECIMALS_SCALE;
+	remainder = scaled & ((1ull << exponent) - 1);
+	scaled >>= exponent;
+	half = 1ull << (exponent - 1);
+	if (remainder > half || (remainder == half && (scaled & 1)))
+		scaled++;
+
+	whole = (uint32_t)(scaled / DECIMALS_SCALE);
+	fraction = (uint32_t)(scaled % DECIMALS_SCALE);
+	if (negative)
+		*out++ = '-';
+	out = ad7124_format_int(out, whole, 0);
+	*out++ = '.';
+	return ad7124_format_int(out, fraction, 8);
+}
@@ -0,0 +1,29 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_format.h
+
+  @brief: Integer-only formatting of the stream fields
+
+  @details: Produces the same bytes as the printf() formats of the stream:
+            "%09d" timestamps, "%i" inputs and codes, and "%.8f" of
+            ad7124_convert_sample_to_voltage(). The volts go through the
+            same float rounding as the conversion, done on integers, then
+            exact decimal rounding half to even as printf does. Each
+            function writes at out and returns the end, nothing is
+            terminated.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_FORMAT_H_
+#define AD7124_FORMAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Longest field: "-2147483648", "-2.50000000" */
+#define AD7124_FORMAT_FIELD_LEN		12
+
+char *ad7124_format_int(char *out, int32_t value, uint8_t width);
+char *ad7124_format_volts(char *out, uint32_t code, bool bipolar, uint8_t pga);
+
+#endif /* AD7124_FORMAT_H_ */
@@ -0,0 +1,153 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_gpio_events.c
+
+  @brief: Interrupt driven, timestamped capture of the digital inputs
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#include "ad7124_gpio_events.h"
+#include "ad7124_trace.h"
+
+#define GPIO_EDGES (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL)
+
+static struct ad7124_gpio_event events[AD7124_GPIO_EVENT_DEPTH];
+// head is only written by the interrupt, tail only by the consumer
+static volatile uint32_t events_head = 0;
+static volatile uint32_t events_tail = 0;
+static volatile uint32_t events_dropped = 0;
+// taken off the ring by an output mode that has no place for them
+static uint32_t events_skipped = 0;
+
+static void push_event(uint64_t timestamp_us, uint8_t pin, uint8_t levels, bool rising)
+{
+	uint32_t head = events_head;
+	struct ad7124_gpio_event *event;
+
+	if (head - events_tail >= AD7124_GPIO_EVENT_DEPTH) {
+		events_dropped++;
+		return;
+	}
+
+	event = &events[head & (AD7124_GPIO_EVENT_DEPTH - 1)];
+	event->timestamp_us = timestamp_us;
+	event->pin = pin;
+	event->levels = levels;
+	event->rising = rising;
+
+	// make the record visible before the index that publishes it
+	__dmb();
+	events_head = head + 1;
+}
+
+static void __time_critical_func(gpio_edge_callback)(uint gpio, uint32_t edges)
+{
+	uint64_t now = time_us_64();
+	uint8_t levels = gpio_get_all() & 0xFF;
+	bool level = levels & (1 << gpio);
+
+	ad7124_trace(AD7124_TRACE_ISR_ENTER, gpio);
+
+	if (gpio < AD7124_GPIO_EVENT_PINS) {
+		/*
+		 * Both edges latched means a pulse shorter than the interrupt
+		 * latency, record the edge away from the current level first
+		 */
+		if ((edges & GPIO_EDGES) == GPIO_EDGES) {
+			push_event(now, gpio, levels ^ (1 << gpio), !level);
+		}
+		push_event(now, gpio, levels, level);
+	}
+
+	ad7124_trace(AD7124_TRACE_ISR_EXIT, gpio);
+}
+
+/*!
+ * @brief      Clears the ring and enables edge interrupts on the inputs
+ *
+ * @details
+ */
+void ad7124_gpio_events_start(void)
+{
+	events_tail = events_head;
+	events_dropped = 0;
+	events_skipped = 0;
+
+	gpio_set_irq_enabled_with_callback(0, GPIO_EDGES, true, &gpio_edge_callback);
+	for (uint8_t pin = 1; pin < AD7124_GPIO_EVENT_PINS; pin++) {
+		gpio_set_irq_enabled(pin, GPIO_EDGES, true);
+	}
+}
+
+/*!
+ * @brief      Disables the edge interrupts, queued events stay readable
+ *
+ * @details
+ */
+void ad7124_gpio_events_stop(void)
+{
+	for (uint8_t pin = 0; pin < AD7124_GPIO_EVENT_PINS; pin++) {
+		gpio_set_irq_enabled(pin, GPIO_EDGES, false);
+	}
+}
+
+/*!
+ * @brief      Takes the oldest event if it happened no later than until_us
+ *
+ * @details    Called repeatedly to merge events in time order with samples.
+ */
+bool ad7124_gpio_events_pop_until(uint64_t until_us, struct ad7124_gpio_event *event)
+{
+	uint32_t tail = events_tail;
+
+	if (tail == events_head)
+		return false;
+
+	__dmb();
+	*event = events[tail & (AD7124_GPIO_EVENT_DEPTH - 1)];
+	if (event->timestamp_us > until_us)
+		return false;
+
+	events_tail = tail + 1;
+	return true;
+}
+
+/*!
+ * @brief      Discards the events up to until_us and counts them
+ *
+ * @details    For output modes without edges, so the ring does not fill up
+ *             and later edges are not counted as dropped.
+ */
+void ad7124_gpio_events_skip_until(uint64_t until_us)
+{
+	struct ad7124_gpio_event event;
+
+	while (ad7124_gpio_events_pop_until(until_us, &event))
+		events_skipped++;
+}
+
+/*!
+ * @brief      Number of edges lost because the ring was full
+ *
+ * @details
+ */
+uint32_t ad7124_gpio_events_dropped(void)
+{
+	return events_dropped;
+}
+
+/*!
+ * @brief      Number of edges discarded with ad7124_gpio_events_skip_until()
+ *
+ * @details
+ */
+uint32_t ad7124_gpio_events_skipped(void)
+{
+	return events_skipped;
+}
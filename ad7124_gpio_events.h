@@ -0,0 +1,38 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_gpio_events.h
+
+  @brief: Interrupt driven, timestamped capture of the digital inputs
+
+  @details: Edges on the inputs set up by initgpios() are recorded from the
+            GPIO interrupt into a single producer / single consumer ring, so
+            pulses shorter than a scan are no longer missed and every edge
+            carries its own microsecond timestamp.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_GPIO_EVENTS_H_
+#define AD7124_GPIO_EVENTS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AD7124_GPIO_EVENT_PINS		8
+/* Ring size, must be a power of two */
+#define AD7124_GPIO_EVENT_DEPTH		256
+
+struct ad7124_gpio_event {
+	uint64_t timestamp_us;	// microseconds since boot
+	uint8_t pin;		// input that changed
+	uint8_t levels;		// all inputs right after the edge
+	bool rising;
+};
+
+void ad7124_gpio_events_start(void);
+void ad7124_gpio_events_stop(void);
+bool ad7124_gpio_events_pop_until(uint64_t until_us, struct ad7124_gpio_event *event);
+void ad7124_gpio_events_skip_until(uint64_t until_us);
+uint32_t ad7124_gpio_events_dropped(void);
+uint32_t ad7124_gpio_events_skipped(void);
+
+#endif /* AD7124_GPIO_EVENTS_H_ */
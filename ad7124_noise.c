@@ -0,0 +1,287 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_noise.c
+
+  @brief: Running noise statistics per channel, summarized periodically
+
+  @details: Integer arithmetic only. Welford's update
+            mean += (x - mean) / n, m2 += (x - mean_old) * (x - mean_new)
+            runs with the mean in Q8. The mean carries the remainder of its
+            division, so it is always the floor of the exact mean instead of
+            a sum of rounded steps that stops moving once n outgrows the
+            deltas. Square root and log2 are computed bit by bit.
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "ad7124_noise.h"
+#include "ad7124_block.h"
+#include "ad7124_support.h"
+#include "ad7124_usb_out.h"
+
+struct ad7124_noise ad7124_noise;
+
+/* Floor division with its non-negative remainder */
+static int64_t floor_div(int64_t value, uint32_t divisor, uint32_t *remainder)
+{
+	int64_t quotient;
+	int64_t rest;
+
+	// the hardware divider takes 32 bits, noise deltas nearly always fit
+	if (value >= INT32_MIN && value <= INT32_MAX && divisor <= INT32_MAX) {
+		quotient = (int32_t)value / (int32_t)divisor;
+		rest = (int32_t)value % (int32_t)divisor;
+	} else {
+		quotient = value / (int64_t)divisor;
+		rest = value % (int64_t)divisor;
+	}
+	if (rest < 0) {
+		quotient--;
+		rest += divisor;
+	}
+	*remainder = rest;
+	return quotient;
+}
+
+/* log2 of a non-zero value with 12 fraction bits, by squaring the mantissa */
+static uint32_t log2_q12(uint64_t value)
+{
+	uint32_t bits = 63 - __builtin_clzll(value);
+	uint64_t mantissa = bits >= 31 ? value >> (bits - 31) : value << (31 - bits);
+	uint32_t log = bits << 12;
+
+	// mantissa is 1.31 fixed point in [1, 2)
+	for (uint32_t bit = 1 << 11; bit; bit >>= 1) {
+		mantissa = (mantissa * mantissa) >> 31;
+		if (mantissa >= 1ull << 32) {
+			log |= bit;
+			mantissa >>= 1;
+		}
+	}
+	return log;
+}
+
+/* 24 - log2_q12 / divisor, in hundredths, clamped to the 24 bits of the ADC */
+static uint16_t bits_x100(uint32_t offset_x100, uint32_t log, uint32_t divisor)
+{
+	uint32_t minus = (log * 100 / divisor + 2048) >> 12;
+
+	if (minus <= offset_x100 - 2400)
+		return 2400;
+	if (minus >= offset_x100)
+		return 0;
+	return offset_x100 - minus;
+}
+
+static void start_window(uint32_t now_ms)
+{
+	ad7124_noise.window_start_ms = now_ms;
+	memset(ad7124_noise.stats, 0, sizeof(ad7124_noise.stats));
+}
+
+static void drain_blocks(void)
+{
+	struct ad7124_noise *noise = &ad7124_noise;
+	const struct ad7124_block *block;
+
+	while ((block = ad7124_block_acquire())) {
+		for (uint8_t ch = 0; ch < AD7124_NOISE_CHANNELS; ch++) {
+			uint32_t valid = block->valid[ch];
+
+			if (!(block->channels & (1 << ch)))
+				continue;
+			for (uint8_t scan = 0; scan < block->scans; scan++) {
+				if (valid & (1u << scan))
+					ad7124_noise_add(&noise->stats[ch], block->codes[ch][scan]);
+			}
+		}
+		ad7124_block_release();
+	}
+}
+
+static void print_window(uint32_t now_ms)
+{
+	struct ad7124_noise *noise = &ad7124_noise;
+	struct ad7124_noise_summary s;
+
+	for (uint8_t ch = 0; ch < AD7124_NOISE_CHANNELS; ch++) {
+		uint32_t mean;
+
+		if (!noise->stats[ch].count)
+			continue;
+		ad7124_noise_summarize(&noise->stats[ch], noise->pga[ch],
+				       noise->bipolar & (1 << ch), &s);
+		mean = s.mean_x100 < 0 ? -(uint32_t)s.mean_x100 : s.mean_x100;
+		ad7124_usb_out_printf("\nN, %lu, %u, %lu, %s%lu.%02lu, %lu.%02lu, %lu, %lu, %u.%02u, %u.%02u",
+				      now_ms, ch, s.count, s.mean_x100 < 0 ? "-" : "",
+				      mean / 100, mean % 100, s.rms_x100 / 100, s.rms_x100 % 100,
+				      s.peak_to_peak, s.rms_nv,
+				      s.effective_bits_x100 / 100, s.effective_bits_x100 % 100,
+				      s.noise_free_bits_x100 / 100, s.noise_free_bits_x100 % 100);
+		if (noise->stats[ch].overflow)
+			ad7124_usb_out_write(", overflow", 10);
+	}
+	noise->summaries++;
+}
+
+/*!
+ * @brief      Starts the statistics of the enabled channels of a register map
+ *
+ * @details    The noise mode collects stream blocks until ad7124_noise_end().
+ *             A period of 0 takes AD7124_NOISE_DEFAULT_PERIOD_MS.
+ */
+void ad7124_noise_begin(const struct ad7124_st_reg *regs, uint32_t period_ms)
+{
+	struct ad7124_noise *noise = &ad7124_noise;
+
+	noise->channels = 0;
+	noise->bipolar = 0;
+	for (uint8_t ch = 0; ch < AD7124_NOISE_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value;
+		int32_t config;
+
+		if (!(value & AD7124_CH_MAP_REG_CH_ENABLE))
+			continue;
+		config = regs[AD7124_Config_0 + ((value >> 12) & 0x7)].value;
+		noise->channels |= 1 << ch;
+		noise->pga[ch] = config & AD7124_CFG_REG_PGA(0x7);
+		if (config & AD7124_CFG_REG_BIPOLAR)
+			noise->bipolar |= 1 << ch;
+	}
+	noise->summaries = 0;
+	start_window(to_ms_since_boot(get_absolute_time()));
+	noise->period_ms = period_ms ? period_ms : AD7124_NOISE_DEFAULT_PERIOD_MS;
+	ad7124_block_enable(true);
+}
+
+/*!
+ * @brief      Summarizes the last partial window and turns the mode off
+ *
+ * @details    Called after the stream stopped and published its last rows.
+ */
+void ad7124_noise_end(void)
+{
+	if (!ad7124_noise_active())
+		return;
+	drain_blocks();
+	print_window(to_ms_since_boot(get_absolute_time()));
+	ad7124_usb_out_write("\n", 1);
+	ad7124_usb_out_flush();
+	ad7124_noise.period_ms = 0;
+	ad7124_block_enable(false);
+}
+
+/*!
+ * @brief      Welford update of a channel with one code
+ *
+ * @details    The sum of squares saturates rather than wraps and sets the
+ *             overflow flag, deltas of 2^24 codes and more do too.
+ */
+void ad7124_noise_add(struct ad7124_noise_channel *stats, int32_t code)
+{
+	int64_t x = (int64_t)code << AD7124_NOISE_MEAN_FRAC;
+	int64_t delta;
+	int64_t delta_new;
+	uint64_t before, after, product;
+
+	if (stats->count == 0) {
+		stats->count = 1;
+		stats->mean = x;
+		stats->remainder = 0;
+		stats->min = code;
+		stats->max = code;
+		return;
+	}
+
+	// sum << MEAN_FRAC == mean * count + remainder, before and after
+	stats->count++;
+	delta = x - stats->mean;
+	stats->mean += floor_div(stats->remainder + delta, stats->count, &stats->remainder);
+	delta_new = x - stats->mean;
+	if (code < stats->min)
+		stats->min = code;
+	if (code > stats->max)
+		stats->max = code;
+
+	if (stats->overflow)
+		return;
+	before = delta < 0 ? -delta : delta;
+	after = delta_new < 0 ? -delta_new : delta_new;
+	if ((before | after) >> 32) {
+		stats->overflow = true;
+		stats->m2 = UINT64_MAX;
+		return;
+	}
+	product = before * after;
+	// the floored means can put the two deltas on either side of 0
+	if ((delta < 0) != (delta_new < 0)) {
+		stats->m2 = stats->m2 > product ? stats->m2 - product : 0;
+	} else if (stats->m2 > UINT64_MAX - product) {
+		stats->overflow = true;
+		stats->m2 = UINT64_MAX;
+	} else {
+		stats->m2 += product;
+	}
+}
+
+/*!
+ * @brief      Mean, rms, peak-to-peak and bits of a channel's window
+ *
+ * @details    rms is the sample standard deviation, over count - 1.
+ *             Effective bits are 24 - log2(rms), noise-free bits
+ *             24 - log2(peak-to-peak), both in codes and at most 24. rms_nv
+ *             refers the rms to the input with the setup's PGA gain.
+ */
+void ad7124_noise_summarize(const struct ad7124_noise_channel *stats, uint8_t pga,
+			    bool bipolar, struct ad7124_noise_summary *summary)
+{
+	int64_t mean_x100;
+	uint64_t variance;
+	uint64_t rms;
+
+	memset(summary, 0, sizeof(*summary));
+	summary->count = stats->count;
+	if (!stats->count)
+		return;
+
+	mean_x100 = stats->mean * 100 + (uint64_t)stats->remainder * 100 / stats->count;
+	// rounded, halves up
+	summary->mean_x100 = (mean_x100 + (1 << (AD7124_NOISE_MEAN_FRAC - 1))) >>
+			     AD7124_NOISE_MEAN_FRAC;
+	summary->peak_to_peak = (uint32_t)(stats->max - stats->min);
+	variance = stats->count > 1 ? stats->m2 / (stats->count - 1) : 0;
+	// Q16 variance, Q16 rms; from 2^48 codes^2 on the rms has 8 bits only
+	rms = variance >> 48 ? ad7124_isqrt(variance) << 8 : ad7124_isqrt(variance << 16);
+	summary->rms_x100 = (rms * 100 + (1 << 15)) >> 16;
+	// 256 * 2^16 * 2^24 codes full scale, twice the reference when bipolar
+	summary->rms_nv = (rms * AD7124_REF_NV_DIV256 + (1ull << (31 - bipolar + pga))) >>
+			  (32 - bipolar + pga);
+
+	// log2(rms) = log2(variance) / 2 - MEAN_FRAC, 32 = 24 + MEAN_FRAC
+	summary->effective_bits_x100 = variance ? bits_x100(3200, log2_q12(variance), 2) : 2400;
+	summary->noise_free_bits_x100 = summary->peak_to_peak ?
+		bits_x100(2400, log2_q12(summary->peak_to_peak), 1) : 2400;
+}
+
+/*!
+ * @brief      Takes the published blocks and prints the window when due
+ *
+ * @details    Called from the stream loop, the producer side of the blocks,
+ *             which lets it publish the rows of the open block at the end
+ *             of a window.
+ */
+void ad7124_noise_poll(uint32_t now_ms)
+{
+	struct ad7124_noise *noise = &ad7124_noise;
+
+	drain_blocks();
+	if (now_ms - noise->window_start_ms < noise->period_ms)
+		return;
+	ad7124_block_flush();
+	drain_blocks();
+	print_window(now_ms);
+	start_window(now_ms);
+}
@@ -0,0 +1,77 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_noise.h
+
+  @brief: Running noise statistics per channel, summarized periodically
+
+  @details: The noise mode consumes the sample blocks of the stream and keeps
+            a Welford mean and variance, the minimum and the maximum of
+            every enabled channel in fixed point. Once a period it prints one
+            summary line per channel and starts a new window, so a rig is
+            qualified from a few lines a second instead of the full sample
+            stream. Effective and noise-free bits follow the datasheet:
+            24 - log2(rms codes) and 24 - log2(peak-to-peak codes).
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_NOISE_H_
+#define AD7124_NOISE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ad7124.h"
+
+#define AD7124_NOISE_CHANNELS	16
+
+/* Summary period when none is given */
+#define AD7124_NOISE_DEFAULT_PERIOD_MS	1000
+
+/* Fractional bits of the running mean, the sum of squares has twice as many */
+#define AD7124_NOISE_MEAN_FRAC	8
+
+struct ad7124_noise_channel {
+	uint32_t count;
+	int64_t mean;			/* codes, AD7124_NOISE_MEAN_FRAC fraction bits, floored */
+	uint32_t remainder;		/* of the mean's division by count */
+	uint64_t m2;			/* sum of squared deviations, 2 * MEAN_FRAC bits */
+	int32_t min;
+	int32_t max;
+	bool overflow;			/* m2 saturated, the variance is a lower bound */
+};
+
+struct ad7124_noise_summary {
+	uint32_t count;
+	int32_t mean_x100;		/* codes */
+	uint32_t rms_x100;		/* codes, sample standard deviation */
+	uint32_t peak_to_peak;		/* codes */
+	uint32_t rms_nv;		/* input referred */
+	uint16_t effective_bits_x100;
+	uint16_t noise_free_bits_x100;
+};
+
+struct ad7124_noise {
+	uint32_t period_ms;		/* between summaries, 0 when the mode is off */
+	uint32_t window_start_ms;
+	uint32_t summaries;
+	uint16_t channels;		/* enabled channel mask */
+	uint8_t pga[AD7124_NOISE_CHANNELS];
+	uint16_t bipolar;		/* channel mask */
+	struct ad7124_noise_channel stats[AD7124_NOISE_CHANNELS];
+};
+
+extern struct ad7124_noise ad7124_noise;
+
+void ad7124_noise_begin(const struct ad7124_st_reg *regs, uint32_t period_ms);
+void ad7124_noise_end(void);
+void ad7124_noise_add(struct ad7124_noise_channel *stats, int32_t code);
+void ad7124_noise_summarize(const struct ad7124_noise_channel *stats, uint8_t pga,
+			    bool bipolar, struct ad7124_noise_summary *summary);
+void ad7124_noise_poll(uint32_t now_ms);
+
+/* Rows go out only as summaries while the mode is on */
+static inline bool ad7124_noise_active(void)
+{
+	return ad7124_noise.period_ms != 0;
+}
+
+#endif /* AD7124_NOISE_H_ */
@@ -0,0 +1,185 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_oneshot.c
+
+  @brief: Single-conversion readings of a few channels, for control loops
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "ad7124_oneshot.h"
+#include "ad7124_timing.h"
+
+#define FILTER_TYPE_MASK	AD7124_FILT_REG_FILTER(0x7)
+#define FILTER_SINC4		AD7124_FILT_REG_FILTER(0)
+#define FILTER_SINC3		AD7124_FILT_REG_FILTER(2)
+
+#define MODE_SINGLE		AD7124_ADC_CTRL_REG_MODE(1)
+#define MODE_STANDBY		AD7124_ADC_CTRL_REG_MODE(2)
+#define MODE_IDLE		AD7124_ADC_CTRL_REG_MODE(4)
+
+struct ad7124_oneshot ad7124_oneshot;
+
+static int32_t write_if_changed(struct ad7124_dev *dev, enum ad7124_registers reg,
+				int32_t value)
+{
+	if (dev->regs[reg].value == value)
+		return 0;
+	dev->regs[reg].value = value;
+	return ad7124_write_register(dev, dev->regs[reg]);
+}
+
+/*!
+ * @brief      Worst-case time of one read with the map as prepared
+ *
+ * @details    See ad7124_oneshot.h.
+ */
+uint32_t ad7124_oneshot_worst_case_us(const struct ad7124_st_reg *regs)
+{
+	struct ad7124_timing timing;
+	uint32_t settling = 0;
+
+	ad7124_timing_from_map(regs, &timing);
+	for (uint8_t ch = 0; ch < AD7124_ONESHOT_CHANNELS; ch++)
+		settling += timing.settling_us[ch];
+
+	return AD7124_ONESHOT_MODE_WRITE_US +
+	       settling * 100 / (100 - AD7124_ONESHOT_CLOCK_TOLERANCE_PCT) +
+	       AD7124_ONESHOT_POLL_US + AD7124_ONESHOT_DATA_READ_US;
+}
+
+/*!
+ * @brief      Sets the device up for reads of a channel mask
+ *
+ * @details    The live map is saved first and comes back with
+ *             ad7124_oneshot_release().
+ */
+int32_t ad7124_oneshot_prepare(struct ad7124_dev *dev, uint16_t channels)
+{
+	struct ad7124_oneshot *oneshot = &ad7124_oneshot;
+	struct ad7124_st_reg *regs = dev->regs;
+	uint8_t setups = 0;
+	int32_t ret;
+
+	if (channels == 0)
+		return INVALID_VAL;
+	if (oneshot->channels && (ret = ad7124_oneshot_release(dev)) < 0)
+		return ret;
+
+	oneshot->saved_adc_control = regs[AD7124_ADC_Control].value;
+	for (uint8_t ch = 0; ch < AD7124_ONESHOT_CHANNELS; ch++)
+		oneshot->saved_channel[ch] = regs[AD7124_Channel_0 + ch].value;
+	for (uint8_t i = 0; i < 8; i++)
+		oneshot->saved_filter[i] = regs[AD7124_Filter_0 + i].value;
+
+	// park the ADC first, channel and filter writes do not restart anything then
+	if ((ret = write_if_changed(dev, AD7124_ADC_Control,
+				    (regs[AD7124_ADC_Control].value &
+				     ~AD7124_ADC_CTRL_REG_MODE(0xF)) | MODE_IDLE)) < 0)
+		return ret;
+
+	oneshot->count = 0;
+	for (uint8_t ch = 0; ch < AD7124_ONESHOT_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value & ~AD7124_CH_MAP_REG_CH_ENABLE;
+
+		if (channels & (1 << ch)) {
+			value |= AD7124_CH_MAP_REG_CH_ENABLE;
+			setups |= 1 << ((value >> 12) & 0x7);
+			oneshot->count++;
+		}
+		if ((ret = write_if_changed(dev, AD7124_Channel_0 + ch, value)) < 0)
+			return ret;
+	}
+
+	for (uint8_t i = 0; i < 8; i++) {
+		int32_t value = regs[AD7124_Filter_0 + i].value;
+
+		if (!(setups & (1 << i)) || (value & FILTER_TYPE_MASK) != FILTER_SINC4)
+			continue;
+		value = (value & ~FILTER_TYPE_MASK) | FILTER_SINC3;
+		if ((ret = write_if_changed(dev, AD7124_Filter_0 + i, value)) < 0)
+			return ret;
+	}
+
+	oneshot->channels = channels;
+	oneshot->worst_case_us = ad7124_oneshot_worst_case_us(regs);
+	return 0;
+}
+
+/*!
+ * @brief      One settled reading of every prepared channel
+ *
+ * @details    Readings come in channel order. The ready polls skip the
+ *             driver's SPI ready check, nothing blocks the bus during a
+ *             conversion. Returns the number of readings, TIMEOUT if the
+ *             sequence took twice the worst case.
+ */
+int32_t ad7124_oneshot_read(struct ad7124_dev *dev,
+			    struct ad7124_oneshot_reading *readings)
+{
+	struct ad7124_oneshot *oneshot = &ad7124_oneshot;
+	struct ad7124_st_reg *regs = dev->regs;
+	uint32_t start;
+	int32_t ret;
+
+	if (oneshot->channels == 0)
+		return INVALID_VAL;
+
+	start = time_us_32();
+	regs[AD7124_ADC_Control].value &= ~AD7124_ADC_CTRL_REG_MODE(0xF);
+	regs[AD7124_ADC_Control].value |= MODE_SINGLE;
+	if ((ret = ad7124_no_check_write_register(dev, regs[AD7124_ADC_Control])) < 0)
+		return ret;
+
+	for (uint8_t n = 0; n < oneshot->count; n++) {
+		do {
+			if (time_us_32() - start > 2 * oneshot->worst_case_us)
+				return TIMEOUT;
+			if ((ret = ad7124_no_check_read_register(dev, &regs[AD7124_Status])) < 0)
+				return ret;
+		} while (regs[AD7124_Status].value & AD7124_STATUS_REG_RDY);
+
+		readings[n].timestamp_us = time_us_32();
+		readings[n].channel = AD7124_STATUS_REG_CH_ACTIVE(regs[AD7124_Status].value);
+		if ((ret = ad7124_no_check_read_register(dev, &regs[AD7124_Data])) < 0)
+			return ret;
+		readings[n].code = regs[AD7124_Data].value;
+	}
+
+	// the ADC puts itself in standby after the sequence
+	regs[AD7124_ADC_Control].value &= ~AD7124_ADC_CTRL_REG_MODE(0xF);
+	regs[AD7124_ADC_Control].value |= MODE_STANDBY;
+	return oneshot->count;
+}
+
+/*!
+ * @brief      Puts back the channels, filters and mode saved by prepare
+ *
+ * @details
+ */
+int32_t ad7124_oneshot_release(struct ad7124_dev *dev)
+{
+	struct ad7124_oneshot *oneshot = &ad7124_oneshot;
+	int32_t ret;
+
+	if (oneshot->channels == 0)
+		return 0;
+	oneshot->channels = 0;
+
+	for (uint8_t ch = 0; ch < AD7124_ONESHOT_CHANNELS; ch++) {
+		if ((ret = write_if_changed(dev, AD7124_Channel_0 + ch,
+					    oneshot->saved_channel[ch])) < 0)
+			return ret;
+	}
+	for (uint8_t i = 0; i < 8; i++) {
+		if ((ret = write_if_changed(dev, AD7124_Filter_0 + i,
+					    oneshot->saved_filter[i])) < 0)
+			return ret;
+	}
+	dev->regs[AD7124_ADC_Control].value = oneshot->saved_adc_control;
+	return ad7124_write_register(dev, dev->regs[AD7124_ADC_Control]);
+}
@@ -0,0 +1,61 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_oneshot.h
+
+  @brief: Single-conversion readings of a few channels, for control loops
+
+  @details: ad7124_oneshot_prepare() enables only the requested channels,
+            swaps sinc4 filters of their setups for sinc3 with the same FS
+            (same notches, a quarter less settling) and parks the ADC in
+            idle mode. Each ad7124_oneshot_read() then starts one single
+            conversion sequence over those channels and returns a settled,
+            timestamped code per channel. ad7124_oneshot_release() puts the
+            register map back. Not to be used while streaming.
+
+            A read completes within ad7124_oneshot.worst_case_us, the
+            settling of each channel with the internal clock 5% slow, plus
+            the mode write, one ready poll and the last data read at
+            500 kHz SPI.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_ONESHOT_H_
+#define AD7124_ONESHOT_H_
+
+#include <stdint.h>
+#include "ad7124.h"
+
+#define AD7124_ONESHOT_CHANNELS		16
+
+/* Bus time at 500 kHz, with the CRC byte */
+#define AD7124_ONESHOT_MODE_WRITE_US	64
+#define AD7124_ONESHOT_POLL_US		48
+#define AD7124_ONESHOT_DATA_READ_US	96
+
+/* Internal clock accuracy */
+#define AD7124_ONESHOT_CLOCK_TOLERANCE_PCT	5
+
+struct ad7124_oneshot_reading {
+	uint32_t timestamp_us;		/* ready seen, time_us_32() */
+	int32_t code;
+	uint8_t channel;
+};
+
+struct ad7124_oneshot {
+	uint16_t channels;		/* prepared mask, 0 when released */
+	uint8_t count;
+	uint32_t worst_case_us;		/* bound of one ad7124_oneshot_read() */
+	int32_t saved_adc_control;
+	int32_t saved_channel[AD7124_ONESHOT_CHANNELS];
+	int32_t saved_filter[8];
+};
+
+extern struct ad7124_oneshot ad7124_oneshot;
+
+int32_t ad7124_oneshot_prepare(struct ad7124_dev *dev, uint16_t channels);
+int32_t ad7124_oneshot_read(struct ad7124_dev *dev,
+			    struct ad7124_oneshot_reading *readings);
+int32_t ad7124_oneshot_release(struct ad7124_dev *dev);
+uint32_t ad7124_oneshot_worst_case_us(const struct ad7124_st_reg *regs);
+
+#endif /* AD7124_ONESHOT_H_ */
@@ -0,0 +1,205 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_planner.cpp
+
+  @brief: Picks power mode and filter settings for a per-channel rate
+
+  @details: Rates come from the timing model in ad7124_config_builder.hpp.
+            Noise is estimated as an input referred noise density times the
+            square root of the noise bandwidth of the filter. The densities
+            are fitted by hand to the datasheet rms noise tables and are good
+            to roughly a factor 1.5, check the result on the rig.
+ -----------------------------------------------------------------------------
+*/
+
+#include <cmath>
+#include <cstring>
+
+#include "ad7124_config_builder.hpp"
+#include "ad7124_planner.h"
+
+namespace {
+
+/* Input referred noise density in full power mode in nV/sqrt(Hz), per PGA code */
+constexpr float noise_density_nv[8] = {380, 200, 105, 58, 35, 25, 21, 20};
+
+float power_mode_noise_factor(int32_t adc_control)
+{
+	switch (ad7124::field(adc_control, 6, 2)) {
+	case 0:
+		return 2.2f;
+	case 1:
+		return 1.6f;
+	default:
+		return 1.0f;
+	}
+}
+
+/* Equivalent noise bandwidth of a filter setting in Hz */
+float noise_bandwidth_hz(int32_t filter, int32_t adc_control)
+{
+	float mclk = ad7124::mclk_hz(adc_control);
+	uint32_t fs = ad7124::field(filter, 0, 11);
+
+	switch (ad7124::field(filter, 21, 3)) {
+	case ad7124::filter_sinc4:
+		return 0.23f * mclk / (32 * fs);
+	case ad7124::filter_sinc3:
+		return 0.27f * mclk / (32 * fs);
+	case ad7124::filter_sinc4_fast:
+	case ad7124::filter_sinc3_fast:
+		// dominated by the sinc1 average
+		return 0.5f * mclk / (32 * fs * ad7124::fast_average(adc_control));
+	default:
+		return 0.3f * mclk / ad7124::settling_cycles(filter, adc_control);
+	}
+}
+
+uint32_t estimate_noise_nv(const ad7124_st_reg *regs)
+{
+	int32_t adc_control = regs[AD7124_ADC_Control].value;
+	float worst = 0;
+
+	for (unsigned ch = 0; ch < AD7124_TIMING_CHANNELS; ch++) {
+		if (!ad7124::channel_enabled(regs, ch))
+			continue;
+		uint32_t setup = ad7124::field(regs[AD7124_Channel_0 + ch].value, 12, 3);
+		uint32_t pga = ad7124::field(regs[AD7124_Config_0 + setup].value, 0, 3);
+		float noise = noise_density_nv[pga] * power_mode_noise_factor(adc_control) *
+			      sqrtf(noise_bandwidth_hz(regs[AD7124_Filter_0 + setup].value,
+						       adc_control));
+		worst = noise > worst ? noise : worst;
+	}
+	return (uint32_t)(worst + 0.5f);
+}
+
+void set_filters(ad7124_st_reg *regs, uint8_t power_mode, uint8_t type,
+		 uint16_t fs, uint8_t post)
+{
+	regs[AD7124_ADC_Control].value &= ~AD7124_ADC_CTRL_REG_POWER_MODE(0x3);
+	regs[AD7124_ADC_Control].value |= AD7124_ADC_CTRL_REG_POWER_MODE(power_mode);
+	for (unsigned i = 0; i < 8; i++) {
+		regs[AD7124_Filter_0 + i].value = AD7124_FILT_REG_FILTER(type) |
+			AD7124_FILT_REG_POST_FILTER(post) | AD7124_FILT_REG_FS(fs);
+	}
+}
+
+/* Takes the candidate as the best plan if it is faster, or as fast and quieter */
+void consider(ad7124_st_reg *trial, uint32_t rate_mhz, uint32_t noise_nv,
+	      ad7124_plan *best, uint8_t power_mode, uint8_t type, uint16_t fs,
+	      uint8_t post)
+{
+	ad7124_timing timing = ad7124::timing_of(trial);
+	uint32_t noise = estimate_noise_nv(trial);
+
+	if (timing.channel_odr_mhz < rate_mhz || noise > noise_nv)
+		return;
+	if (timing.channel_odr_mhz < best->channel_odr_mhz ||
+	    (timing.channel_odr_mhz == best->channel_odr_mhz && noise >= best->noise_nv))
+		return;
+
+	best->power_mode = power_mode;
+	best->filter = type;
+	best->fs = fs;
+	best->post_filter = post;
+	best->channel_odr_mhz = timing.channel_odr_mhz;
+	best->noise_nv = noise;
+}
+
+} // namespace
+
+/*!
+ * @brief      Finds the fastest settings meeting a rate and a noise budget
+ *
+ * @details    rate_mhz is the required rate of every enabled channel in mHz,
+ *             noise_nv the rms noise budget of the worst channel, 0 for no
+ *             limit. All eight setups get the same filter. Returns
+ *             INVALID_VAL when nothing fits.
+ */
+extern "C" int32_t ad7124_plan_filters(const struct ad7124_st_reg *regs,
+				       uint32_t rate_mhz, uint32_t noise_nv,
+				       struct ad7124_plan *plan)
+{
+	static const uint8_t power_modes[] = {2, 1, 0};
+	static const uint8_t sinc_filters[] = {ad7124::filter_sinc4, ad7124::filter_sinc3,
+					       ad7124::filter_sinc4_fast,
+					       ad7124::filter_sinc3_fast};
+	static const uint8_t post_filters[] = {ad7124::post_27sps, ad7124::post_25sps,
+					       ad7124::post_20sps, ad7124::post_16sps};
+	struct ad7124_st_reg trial[AD7124_REG_NO];
+
+	memset(plan, 0, sizeof(*plan));
+	if (ad7124::enabled_channels(regs) == 0)
+		return INVALID_VAL;
+	if (noise_nv == 0)
+		noise_nv = UINT32_MAX;
+	memcpy(trial, regs, sizeof(trial));
+
+	for (uint8_t power_mode : power_modes) {
+		for (uint8_t type : sinc_filters) {
+			// noise falls with 1/sqrt(FS) and so does the rate, the
+			// smallest FS within the noise budget is the fastest
+			set_filters(trial, power_mode, type, 1, 0);
+			float ratio = (float)estimate_noise_nv(trial) / noise_nv;
+			uint32_t fs = ratio > 1 ? (uint32_t)ceilf(ratio * ratio) : 1;
+
+			for (; fs <= 2047; fs++) {
+				set_filters(trial, power_mode, type, fs, 0);
+				if (estimate_noise_nv(trial) <= noise_nv)
+					break;
+			}
+			if (fs <= 2047)
+				consider(trial, rate_mhz, noise_nv, plan, power_mode,
+					 type, fs, 0);
+		}
+		for (uint8_t post : post_filters) {
+			set_filters(trial, power_mode, ad7124::filter_post, 0, post);
+			consider(trial, rate_mhz, noise_nv, plan, power_mode,
+				 ad7124::filter_post, 0, post);
+		}
+	}
+
+	return plan->channel_odr_mhz ? 0 : INVALID_VAL;
+}
+
+/*!
+ * @brief      Writes the planned power mode and filters into a register map
+ *
+ * @details    Channels, setups and calibration are left as they are.
+ */
+extern "C" void ad7124_plan_apply(const struct ad7124_plan *plan,
+				  struct ad7124_st_reg *regs)
+{
+	set_filters(regs, plan->power_mode, plan->filter, plan->fs, plan->post_filter);
+}
+
+/*!
+ * @brief      Estimated rms noise of the worst enabled channel of a map
+ *
+ * @details
+ */
+extern "C" uint32_t ad7124_plan_noise_nv(const struct ad7124_st_reg *regs)
+{
+	return estimate_noise_nv(regs);
+}
+
+/*!
+ * @brief      Short name of the planned filter, for printing
+ *
+ * @details
+ */
+extern "C" const char *ad7124_plan_filter_name(const struct ad7124_plan *plan)
+{
+	switch (plan->filter) {
+	case ad7124::filter_sinc4:
+		return "sinc4";
+	case ad7124::filter_sinc3:
+		return "sinc3";
+	case ad7124::filter_sinc4_fast:
+		return "sinc4 fast";
+	case ad7124::filter_sinc3_fast:
+		return "sinc3 fast";
+	default:
+		return "post";
+	}
+}
@@ -0,0 +1,44 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_planner.h
+
+  @brief: Picks power mode and filter settings for a per-channel rate
+
+  @details: The planner keeps the channels and setups of a register map and
+            searches power mode, filter type, FS and post filter for the
+            highest per-channel rate that still meets the required rate and
+            the noise budget. The same code runs in the firmware and in the
+            host tool tools/ad7124_plan.cpp.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_PLANNER_H_
+#define AD7124_PLANNER_H_
+
+#include <stdint.h>
+#include "ad7124.h"
+
+struct ad7124_plan {
+	uint8_t power_mode;
+	uint8_t filter;
+	uint16_t fs;			/* 0 with a post filter */
+	uint8_t post_filter;
+	uint32_t channel_odr_mhz;
+	uint32_t noise_nv;		/* estimated rms, input referred, worst channel */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int32_t ad7124_plan_filters(const struct ad7124_st_reg *regs, uint32_t rate_mhz,
+			    uint32_t noise_nv, struct ad7124_plan *plan);
+void ad7124_plan_apply(const struct ad7124_plan *plan, struct ad7124_st_reg *regs);
+uint32_t ad7124_plan_noise_nv(const struct ad7124_st_reg *regs);
+const char *ad7124_plan_filter_name(const struct ad7124_plan *plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AD7124_PLANNER_H_ */
@@ -0,0 +1,327 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_profile_store.c
+
+  @brief: Register profiles kept in a reserved flash sector
+
+  @details: The last sector of the flash is reserved for the profiles, one
+            FLASH_PAGE_SIZE slot per profile, the sector before holds the
+            calibration records the same way. Rewriting a slot rewrites the
+            sector, interrupts are off while the flash is busy.
+ -----------------------------------------------------------------------------
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "ad7124.h"
+#include "ad7124_profile_store.h"
+
+#define PROFILE_STORE_OFFSET	(PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define CALIBRATION_STORE_OFFSET	(PROFILE_STORE_OFFSET - FLASH_SECTOR_SIZE)
+#define PROFILE_SLOT_SIZE		FLASH_PAGE_SIZE
+
+static uint8_t sector_copy[FLASH_SECTOR_SIZE];
+
+static const struct ad7124_profile *profile_slot(uint8_t slot)
+{
+	return (const struct ad7124_profile *)(XIP_BASE + PROFILE_STORE_OFFSET +
+					       slot * PROFILE_SLOT_SIZE);
+}
+
+static const struct ad7124_calibration *calibration_slot(uint8_t slot)
+{
+	return (const struct ad7124_calibration *)(XIP_BASE + CALIBRATION_STORE_OFFSET +
+						   slot * PROFILE_SLOT_SIZE);
+}
+
+static uint8_t profile_crc(const struct ad7124_profile *profile)
+{
+	return ad7124_compute_crc8((uint8_t *)profile,
+				   offsetof(struct ad7124_profile, crc));
+}
+
+static uint8_t calibration_crc(const struct ad7124_calibration *calibration)
+{
+	return ad7124_compute_crc8((uint8_t *)calibration,
+				   offsetof(struct ad7124_calibration, crc));
+}
+
+static bool calibration_valid(const struct ad7124_calibration *calibration)
+{
+	return calibration->magic == AD7124_CALIBRATION_MAGIC &&
+	       calibration_crc(calibration) == calibration->crc;
+}
+
+static int32_t write_sector(uint32_t offset)
+{
+	uint32_t irq_state = save_and_disable_interrupts();
+
+	flash_range_erase(offset, FLASH_SECTOR_SIZE);
+	flash_range_program(offset, sector_copy, FLASH_SECTOR_SIZE);
+	restore_interrupts(irq_state);
+
+	return 0;
+}
+
+static void pack_value(uint8_t *bytes, uint32_t value)
+{
+	bytes[0] = value >> 16;
+	bytes[1] = value >> 8;
+	bytes[2] = value;
+}
+
+static int32_t unpack_value(const uint8_t *bytes)
+{
+	return (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+}
+
+/*!
+ * @brief      Checks the magic number and CRC of a profile
+ *
+ * @details
+ */
+int32_t ad7124_profile_check(const struct ad7124_profile *profile)
+{
+	if (profile->magic != AD7124_PROFILE_MAGIC)
+		return INVALID_VAL;
+	if (profile_crc(profile) != profile->crc)
+		return COMM_ERR;
+	return 0;
+}
+
+/*!
+ * @brief      Returns the profile stored in a slot, or NULL if it is empty
+ *
+ * @details    The pointer is into the XIP flash window, no copy is made.
+ */
+const struct ad7124_profile *ad7124_profile_get(uint8_t slot)
+{
+	const struct ad7124_profile *profile;
+
+	if (slot >= AD7124_PROFILE_SLOTS)
+		return NULL;
+
+	profile = profile_slot(slot);
+	return ad7124_profile_check(profile) < 0 ? NULL : profile;
+}
+
+/*!
+ * @brief      Writes a profile to a slot, the other slots are preserved
+ *
+ * @details
+ */
+int32_t ad7124_profile_save(uint8_t slot, const struct ad7124_profile *profile)
+{
+	if (slot >= AD7124_PROFILE_SLOTS || ad7124_profile_check(profile) < 0)
+		return INVALID_VAL;
+
+	memcpy(sector_copy, profile_slot(0), FLASH_SECTOR_SIZE);
+	memset(&sector_copy[slot * PROFILE_SLOT_SIZE], 0xFF, PROFILE_SLOT_SIZE);
+	memcpy(&sector_copy[slot * PROFILE_SLOT_SIZE], profile, sizeof(*profile));
+
+	return write_sector(PROFILE_STORE_OFFSET);
+}
+
+/*!
+ * @brief      Clears a slot
+ *
+ * @details
+ */
+int32_t ad7124_profile_erase(uint8_t slot)
+{
+	if (slot >= AD7124_PROFILE_SLOTS)
+		return INVALID_VAL;
+
+	memcpy(sector_copy, profile_slot(0), FLASH_SECTOR_SIZE);
+	memset(&sector_copy[slot * PROFILE_SLOT_SIZE], 0xFF, PROFILE_SLOT_SIZE);
+
+	return write_sector(PROFILE_STORE_OFFSET);
+}
+
+/*!
+ * @brief      Packs the configuration registers of a register map
+ *
+ * @details
+ */
+void ad7124_profile_from_map(struct ad7124_profile *profile, const char *name,
+			     const struct ad7124_st_reg *regs)
+{
+	memset(profile, 0, sizeof(*profile));
+	profile->magic = AD7124_PROFILE_MAGIC;
+	strncpy(profile->name, name, AD7124_PROFILE_NAME_LEN - 1);
+
+	for (uint8_t i = 0; i < AD7124_PROFILE_REG_COUNT; i++) {
+		pack_value(profile->values[i], regs[AD7124_PROFILE_FIRST_REG + i].value);
+	}
+	profile->crc = profile_crc(profile);
+}
+
+/*!
+ * @brief      Brings the device to a profile writing only what differs
+ *
+ * @details    The live register map is the reference, so no reset or full
+ *             rewrite is needed. Returns the number of registers written
+ *             or a negative error code.
+ */
+int32_t ad7124_profile_apply(struct ad7124_dev *dev,
+			     const struct ad7124_profile *profile)
+{
+	int32_t ret;
+	int32_t written = 0;
+
+	if ((ret = ad7124_profile_check(profile)) < 0)
+		return ret;
+
+	for (uint8_t i = 0; i < AD7124_PROFILE_REG_COUNT; i++) {
+		struct ad7124_st_reg *reg = &dev->regs[AD7124_PROFILE_FIRST_REG + i];
+		int32_t value = unpack_value(profile->values[i]);
+
+		if (reg->rw != AD7124_RW || reg->value == value)
+			continue;
+
+		reg->value = value;
+		if ((ret = ad7124_write_register(dev, *reg)) < 0)
+			return ret;
+		written++;
+
+		/* Get CRC State and device SPI interface settings */
+		if (AD7124_PROFILE_FIRST_REG + i == AD7124_Error_En) {
+			ad7124_update_crcsetting(dev);
+			ad7124_update_dev_spi_settings(dev);
+		}
+	}
+
+	return written;
+}
+
+/*!
+ * @brief      Identifies the configuration a calibration belongs to
+ *
+ * @details    FNV-1a over the channel, setup and filter registers, the
+ *             ADC_Control mode and power bits change at runtime and are
+ *             left out.
+ */
+uint32_t ad7124_calibration_key(const struct ad7124_st_reg *regs)
+{
+	uint32_t key = 2166136261u;
+
+	for (uint8_t i = AD7124_Channel_0; i < AD7124_Offset_0; i++) {
+		for (uint8_t shift = 0; shift < 24; shift += 8) {
+			key ^= (regs[i].value >> shift) & 0xFF;
+			key *= 16777619u;
+		}
+	}
+	return key;
+}
+
+/*!
+ * @brief      Returns the stored calibration of a configuration, or NULL
+ *
+ * @details    The pointer is into the XIP flash window, no copy is made.
+ */
+const struct ad7124_calibration *ad7124_calibration_find(uint32_t key)
+{
+	const struct ad7124_calibration *calibration;
+
+	for (uint8_t slot = 0; slot < AD7124_CALIBRATION_SLOTS; slot++) {
+		calibration = calibration_slot(slot);
+		if (calibration->key == key && calibration_valid(calibration))
+			return calibration;
+	}
+	return NULL;
+}
+
+/*!
+ * @brief      Stores the offsets and gains of a register map
+ *
+ * @details    Replaces the record of the same configuration, else takes an
+ *             empty slot, else the oldest one. The map must hold the values
+ *             read back from the device after calibrating.
+ */
+int32_t ad7124_calibration_save(const struct ad7124_st_reg *regs,
+				int16_t temperature_dc)
+{
+	struct ad7124_calibration record;
+	const struct ad7124_calibration *calibration;
+	uint32_t key = ad7124_calibration_key(regs);
+	uint32_t sequence = 0;
+	uint32_t oldest = UINT32_MAX;
+	int16_t slot = -1;
+	int16_t empty = -1;
+	int16_t replace = 0;
+
+	for (uint8_t i = 0; i < AD7124_CALIBRATION_SLOTS; i++) {
+		calibration = calibration_slot(i);
+		if (!calibration_valid(calibration)) {
+			if (empty < 0)
+				empty = i;
+			continue;
+		}
+		if (calibration->key == key)
+			slot = i;
+		if (calibration->sequence >= sequence)
+			sequence = calibration->sequence + 1;
+		if (calibration->sequence < oldest) {
+			oldest = calibration->sequence;
+			replace = i;
+		}
+	}
+	if (slot < 0)
+		slot = empty >= 0 ? empty : replace;
+
+	memset(&record, 0, sizeof(record));
+	record.magic = AD7124_CALIBRATION_MAGIC;
+	record.key = key;
+	record.sequence = sequence;
+	record.uptime_s = to_ms_since_boot(get_absolute_time()) / 1000;
+	record.temperature_dc = temperature_dc;
+	for (uint8_t i = 0; i < AD7124_CALIBRATION_SETUPS; i++) {
+		pack_value(record.offsets[i], regs[AD7124_Offset_0 + i].value);
+		pack_value(record.gains[i], regs[AD7124_Gain_0 + i].value);
+	}
+	record.crc = calibration_crc(&record);
+
+	memcpy(sector_copy, calibration_slot(0), FLASH_SECTOR_SIZE);
+	memset(&sector_copy[slot * PROFILE_SLOT_SIZE], 0xFF, PROFILE_SLOT_SIZE);
+	memcpy(&sector_copy[slot * PROFILE_SLOT_SIZE], &record, sizeof(record));
+
+	return write_sector(CALIBRATION_STORE_OFFSET);
+}
+
+/*!
+ * @brief      Writes stored offsets and gains to the device
+ *
+ * @details    Only registers that differ from the live map are written, the
+ *             device must be in standby or idle mode. Returns the number of
+ *             registers written or a negative error code.
+ */
+int32_t ad7124_calibration_restore(struct ad7124_dev *dev,
+				   const struct ad7124_calibration *calibration)
+{
+	int32_t ret;
+	int32_t written = 0;
+
+	if (!calibration_valid(calibration))
+		return COMM_ERR;
+
+	for (uint8_t i = 0; i < 2 * AD7124_CALIBRATION_SETUPS; i++) {
+		struct ad7124_st_reg *reg = &dev->regs[AD7124_Offset_0 + i];
+		int32_t value = i < AD7124_CALIBRATION_SETUPS ?
+				unpack_value(calibration->offsets[i]) :
+				unpack_value(calibration->gains[i - AD7124_CALIBRATION_SETUPS]);
+
+		if (reg->value == value)
+			continue;
+
+		reg->value = value;
+		if ((ret = ad7124_write_register(dev, *reg)) < 0)
+			return ret;
+		written++;
+	}
+
+	return written;
+}
@@ -0,0 +1,74 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_profile_store.h
+
+  @brief: Register profiles kept in a reserved flash sector
+
+  @details: A profile holds the configuration registers (ADC_Control up to
+            Filter_7, the same range ad7124_setup() writes) in a compact
+            binary form, so a rig can be switched at runtime without a
+            rebuild. Each profile takes one flash page of the last sector.
+            Calibration results are kept in the sector before it, keyed by
+            the channel, setup and filter registers they were taken with.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_PROFILE_STORE_H_
+#define AD7124_PROFILE_STORE_H_
+
+#include <stdint.h>
+#include "ad7124.h"
+
+#define AD7124_PROFILE_MAGIC		0x31504441	/* "ADP1" */
+#define AD7124_PROFILE_NAME_LEN		16
+#define AD7124_PROFILE_FIRST_REG	AD7124_ADC_Control
+#define AD7124_PROFILE_REG_COUNT	(AD7124_Offset_0 - AD7124_ADC_Control)
+#define AD7124_PROFILE_SLOTS		16
+
+#define AD7124_CALIBRATION_MAGIC	0x31434441	/* "ADC1" */
+#define AD7124_CALIBRATION_SETUPS	8
+#define AD7124_CALIBRATION_SLOTS	16
+
+/*
+ * Binary profile as stored in flash and exchanged with the host (as hex).
+ * Register values are 24 bit big endian, in ad7124_registers order.
+ */
+struct ad7124_profile {
+	uint32_t magic;
+	char name[AD7124_PROFILE_NAME_LEN];
+	uint8_t values[AD7124_PROFILE_REG_COUNT][3];
+	uint8_t crc;	/* CRC8 of all bytes above */
+};
+
+/*
+ * Offset and gain registers after a calibration, 24 bit big endian.
+ * The RP2040 has no clock, the sequence number orders the records.
+ */
+struct ad7124_calibration {
+	uint32_t magic;
+	uint32_t key;			/* ad7124_calibration_key() of the map */
+	uint32_t sequence;		/* counts calibrations over all records */
+	uint32_t uptime_s;		/* time since boot when calibrated */
+	int16_t temperature_dc;		/* board temperature, 0.1 degC */
+	uint8_t offsets[AD7124_CALIBRATION_SETUPS][3];
+	uint8_t gains[AD7124_CALIBRATION_SETUPS][3];
+	uint8_t crc;	/* CRC8 of all bytes above */
+};
+
+const struct ad7124_profile *ad7124_profile_get(uint8_t slot);
+int32_t ad7124_profile_save(uint8_t slot, const struct ad7124_profile *profile);
+int32_t ad7124_profile_erase(uint8_t slot);
+void ad7124_profile_from_map(struct ad7124_profile *profile, const char *name,
+			     const struct ad7124_st_reg *regs);
+int32_t ad7124_profile_check(const struct ad7124_profile *profile);
+int32_t ad7124_profile_apply(struct ad7124_dev *dev,
+			     const struct ad7124_profile *profile);
+
+uint32_t ad7124_calibration_key(const struct ad7124_st_reg *regs);
+const struct ad7124_calibration *ad7124_calibration_find(uint32_t key);
+int32_t ad7124_calibration_save(const struct ad7124_st_reg *regs,
+				int16_t temperature_dc);
+int32_t ad7124_calibration_restore(struct ad7124_dev *dev,
+				   const struct ad7124_calibration *calibration);
+
+#endif /* AD7124_PROFILE_STORE_H_ */
@@ -0,0 +1,166 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_protocol.c
+
+  @brief: Line command protocol for test automation
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "pico/stdlib.h"
+
+#include "ad7124_protocol.h"
+#include "ad7124_command.h"
+#include "ad7124.h"
+
+// Set once the status line of the running command is out
+static bool replied;
+// Set when the running command keeps going after its OK, it ends with END
+static bool acked;
+
+/*!
+ * @brief      Reads one line from the console mailbox, without echo
+ *
+ * @details    CR, LF or both end a line, overlong lines are cut.
+ */
+static void read_line(char *line)
+{
+	uint16_t len = 0;
+	int c;
+
+	while ((c = ad7124_command_getchar()) != '\n' && c != '\r') {
+		if (len < AD7124_PROTOCOL_LINE_LEN - 1)
+			line[len++] = c;
+	}
+	line[len] = '\0';
+}
+
+static uint8_t split_words(char *line, char **argv)
+{
+	uint8_t argc = 0;
+	char *word = strtok(line, " \t");
+
+	while (word && argc < AD7124_PROTOCOL_MAX_ARGS) {
+		argv[argc++] = word;
+		word = strtok(NULL, " \t");
+	}
+	return argc;
+}
+
+static void print_help(const struct ad7124_protocol *protocol)
+{
+	printf("PING\nHELP\nEXIT\n");
+	for (uint8_t i = 0; i < protocol->count; i++)
+		printf("%s %s\n", protocol->commands[i].name, protocol->commands[i].usage);
+}
+
+/*!
+ * @brief      Parses a decimal or 0x hex argument
+ *
+ * @details    Returns INVALID_VAL for anything else or a value above max.
+ */
+int32_t ad7124_protocol_number(const char *word, uint32_t max, uint32_t *value)
+{
+	char *end;
+
+	*value = strtoul(word, &end, 0);
+	if (end == word || *end != '\0' || *value > max)
+		return INVALID_VAL;
+	return 0;
+}
+
+/*!
+ * @brief      Sends the OK of a command that keeps running, e.g. a stream
+ *
+ * @details    The protocol closes the command with END instead of OK.
+ */
+void ad7124_protocol_ack(void)
+{
+	ad7124_protocol_ok(NULL);
+	acked = true;
+}
+
+/*!
+ * @brief      Sends the OK line, with values when format is not NULL
+ *
+ * @details
+ */
+void ad7124_protocol_ok(const char *format, ...)
+{
+	va_list args;
+
+	printf("OK");
+	if (format) {
+		putchar(' ');
+		va_start(args, format);
+		vprintf(format, args);
+		va_end(args);
+	}
+	printf("\n");
+	stdio_flush();
+	replied = true;
+}
+
+/*!
+ * @brief      Serves commands until EXIT
+ *
+ * @details    The caller's console menu is back when this returns.
+ */
+void ad7124_protocol_run(const struct ad7124_protocol *protocol)
+{
+	static char line[AD7124_PROTOCOL_LINE_LEN];
+	char *argv[AD7124_PROTOCOL_MAX_ARGS];
+	const struct ad7124_protocol_command *command;
+	uint8_t argc;
+	int32_t ret;
+
+	ad7124_protocol_ok("AD7124 protocol %u", AD7124_PROTOCOL_VERSION);
+	do {
+		read_line(line);
+		if ((argc = split_words(line, argv)) == 0) {
+			ret = 0;
+			continue;
+		}
+
+		replied = false;
+		acked = false;
+		command = NULL;
+		ret = 0;
+		if (strcasecmp(argv[0], "PING") == 0) {
+			// answered by the OK below
+		} else if (strcasecmp(argv[0], "HELP") == 0) {
+			print_help(protocol);
+		} else if (strcasecmp(argv[0], "EXIT") == 0) {
+			ret = AD7124_PROTOCOL_EXIT;
+		} else {
+			for (uint8_t i = 0; i < protocol->count; i++) {
+				if (strcasecmp(argv[0], protocol->commands[i].name) == 0) {
+					command = &protocol->commands[i];
+					break;
+				}
+			}
+			if (command == NULL) {
+				printf("ERR %ld unknown command\n", (int32_t)INVALID_VAL);
+				stdio_flush();
+				continue;
+			}
+			ret = command->handler(argc, argv);
+		}
+
+		if (acked) {
+			printf(ret < 0 ? "END %ld\n" : "END\n", ret);
+		} else if (ret < 0) {
+			printf("ERR %ld %s %s\n", ret, command->name, command->usage);
+		} else if (!replied) {
+			ad7124_protocol_ok(NULL);
+		}
+		stdio_flush();
+	} while (ret != AD7124_PROTOCOL_EXIT);
+}
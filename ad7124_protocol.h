@@ -0,0 +1,50 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_protocol.h
+
+  @brief: Line command protocol for test automation
+
+  @details: One command per line, words separated by spaces, numbers in
+            decimal or 0x hex. Nothing is echoed and the screen is never
+            cleared. Every command ends with exactly one status line:
+              OK [values]
+              ERR <code> [usage]
+            Payload lines, if any, come before it. Long running commands
+            (streams) send their OK first and an END line when they stop.
+            PING, HELP and EXIT are built in, the application passes a table
+            with the rest, like the console menus.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_PROTOCOL_H_
+#define AD7124_PROTOCOL_H_
+
+#include <stdint.h>
+
+#define AD7124_PROTOCOL_LINE_LEN	256
+#define AD7124_PROTOCOL_MAX_ARGS	24
+
+/* Handler result that leaves the protocol after the reply */
+#define AD7124_PROTOCOL_EXIT		1
+
+/* Protocol version, sent with the OK when the protocol starts */
+#define AD7124_PROTOCOL_VERSION		1
+
+struct ad7124_protocol_command {
+	const char *name;
+	const char *usage;
+	/* argv[0] is the command, < 0 is an error code for the ERR line */
+	int32_t (*handler)(uint8_t argc, char **argv);
+};
+
+struct ad7124_protocol {
+	const struct ad7124_protocol_command *commands;
+	uint8_t count;
+};
+
+void ad7124_protocol_run(const struct ad7124_protocol *protocol);
+void ad7124_protocol_ack(void);
+void ad7124_protocol_ok(const char *format, ...);
+int32_t ad7124_protocol_number(const char *word, uint32_t max, uint32_t *value);
+
+#endif /* AD7124_PROTOCOL_H_ */
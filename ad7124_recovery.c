@@ -0,0 +1,110 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_recovery.c
+
+  @brief: Tiered recovery of the AD7124 after a failed read
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include "pico/stdlib.h"
+
+#include "ad7124_recovery.h"
+#include "ad7124_snapshot.h"
+
+/*!
+ * @brief      Reads the error register after a conversion flagged an error
+ *
+ * @details    Returns the fault bits, 0 when only the input is out of range
+ *             or saturated, or a negative error code.
+ */
+int32_t ad7124_recovery_faults(struct ad7124_dev *dev)
+{
+	int32_t ret;
+
+	if ((ret = ad7124_no_check_read_register(dev, &dev->regs[AD7124_Error])) < 0)
+		return ret;
+	return dev->regs[AD7124_Error].value & AD7124_RECOVERY_FAULTS;
+}
+
+/*
+ * The interface frames each access, a CRC or bit count error only loses
+ * that access. The device is fine if it answers with its ID, has not been
+ * through a power-on reset and still has the shadow ADC_Control.
+ */
+static int32_t resync(struct ad7124_dev *dev)
+{
+	struct ad7124_st_reg probe = dev->regs[AD7124_ADC_Control];
+	int32_t ret;
+
+	if ((ret = ad7124_no_check_read_register(dev, &dev->regs[AD7124_ID])) < 0)
+		return ret;
+	if ((dev->regs[AD7124_ID].value >> 4) != AD7124_RECOVERY_DEVICE_ID)
+		return COMM_ERR;
+	if ((ret = ad7124_no_check_read_register(dev, &dev->regs[AD7124_Status])) < 0)
+		return ret;
+	if (dev->regs[AD7124_Status].value & AD7124_STATUS_REG_POR_FLAG)
+		return INVALID_VAL;
+	// clears the latched SPI errors
+	if ((ret = ad7124_no_check_read_register(dev, &dev->regs[AD7124_Error])) < 0)
+		return ret;
+	if ((ret = ad7124_no_check_read_register(dev, &probe)) < 0)
+		return ret;
+	if (probe.value != dev->regs[AD7124_ADC_Control].value)
+		return INVALID_VAL;
+
+	// rewriting the mode restarts the sequence at the first channel
+	if ((ret = ad7124_write_register(dev, dev->regs[AD7124_ADC_Control])) < 0)
+		return ret;
+	return 0;
+}
+
+/*
+ * A frame lost in the burst shifts every frame after it, reading back the
+ * first and the last register written is enough to tell. The reset puts
+ * the factory gains back, the restore writes the shadow ones over them, so
+ * the shadow map must hold what the device read at boot.
+ */
+static int32_t reset_and_restore(struct ad7124_dev *dev)
+{
+	static const enum ad7124_registers check[] = {AD7124_IOCon1, AD7124_Gain_7,
+						       AD7124_ADC_Control};
+	struct ad7124_st_reg probe;
+	int32_t ret;
+
+	if ((ret = ad7124_reset(dev)) < 0)
+		return ret;
+	dev->check_ready = 1;
+	if ((ret = ad7124_snapshot_restore(dev)) < 0)
+		return ret;
+
+	for (uint8_t i = 0; i < sizeof(check) / sizeof(check[0]); i++) {
+		probe = dev->regs[check[i]];
+		if ((ret = ad7124_no_check_read_register(dev, &probe)) < 0)
+			return ret;
+		if (probe.value != dev->regs[check[i]].value)
+			return COMM_ERR;
+	}
+	return 0;
+}
+
+/*!
+ * @brief      Brings the device back with the cheapest tier that works
+ *
+ * @details    faults are the error register bits that led here, see
+ *             ad7124_recovery_faults(), AD7124_RECOVERY_POWER_ON after a
+ *             power-on reset, 0 after a timeout or CRC error.
+ *             Returns the tier or a negative error code when the reset
+ *             did not help either.
+ */
+int32_t ad7124_recover(struct ad7124_dev *dev, int32_t faults)
+{
+	int32_t ret;
+
+	if (!(faults & AD7124_RECOVERY_RESET_FAULTS) && resync(dev) == 0)
+		return AD7124_RECOVERY_RESYNC;
+	if ((ret = reset_and_restore(dev)) < 0)
+		return ret;
+	return AD7124_RECOVERY_RESET;
+}
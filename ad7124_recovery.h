@@ -0,0 +1,47 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_recovery.h
+
+  @brief: Tiered recovery of the AD7124 after a failed read
+
+  @details: Resync first: the ID, POR flag and ADC_Control are read back
+            and, when the device still holds the shadow map, ADC_Control is
+            rewritten to restart the conversion sequence. Only if that fails
+            the device is reset and the shadow map written back in one burst
+            (ad7124_snapshot.h), the driver instance is kept. Either way the
+            mode of the shadow ADC_Control is running again afterwards, a
+            stream resumes by itself.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_RECOVERY_H_
+#define AD7124_RECOVERY_H_
+
+#include <stdint.h>
+#include "ad7124.h"
+
+/* Tier that brought the device back */
+#define AD7124_RECOVERY_RESYNC		1
+#define AD7124_RECOVERY_RESET		2
+
+/* DEVICE_ID field of the ID register of the AD7124-8 */
+#define AD7124_RECOVERY_DEVICE_ID	0x1
+
+/* Error register bits that mean the interface or the chip is in trouble, not the input */
+#define AD7124_RECOVERY_FAULTS	(AD7124_ERR_REG_LDO_CAP_ERR | AD7124_ERR_REG_DLDO_PSM_ERR | \
+				 AD7124_ERR_REG_ALDO_PSM_ERR | AD7124_ERR_REG_SPI_SLCK_CNT_ERR | \
+				 AD7124_ERR_REG_SPI_READ_ERR | AD7124_ERR_REG_SPI_WRITE_ERR | \
+				 AD7124_ERR_REG_SPI_CRC_ERR | AD7124_ERR_REG_MM_CRC_ERR | \
+				 AD7124_ERR_REG_ROM_CRC_ERR)
+
+/* Not an error register bit, the status showed a power-on reset (brown-out) */
+#define AD7124_RECOVERY_POWER_ON	(1 << 24)
+
+/* Faults a resync cannot fix, the register contents are suspect */
+#define AD7124_RECOVERY_RESET_FAULTS	(AD7124_ERR_REG_MM_CRC_ERR | AD7124_ERR_REG_ROM_CRC_ERR | \
+					 AD7124_RECOVERY_POWER_ON)
+
+int32_t ad7124_recovery_faults(struct ad7124_dev *dev);
+int32_t ad7124_recover(struct ad7124_dev *dev, int32_t faults);
+
+#endif /* AD7124_RECOVERY_H_ */
@@ -17,4 +17,12 @@
     size and access type. */
 extern struct ad7124_st_reg ad7124_regs[AD7124_REG_NO];
 
+/* Board tables (config.*.h) are constexpr in C++ so they can be checked
+   at compile time, see ad7124_timing.cpp */
+#ifdef __cplusplus
+#define AD7124_CONFIG_CONST constexpr
+#else
+#define AD7124_CONFIG_CONST const
+#endif
+
 #endif /* __AD7124_REGS_H__ */
@@ -0,0 +1,83 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_sequencer.c
+
+  @brief: Predicts the channel sequence of the AD7124 and detects gaps
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <string.h>
+
+#include "ad7124_sequencer.h"
+
+/*!
+ * @brief      Builds the successor table for a set of enabled channels
+ *
+ * @details    The first conversion after init is always accepted.
+ */
+void ad7124_sequencer_init(struct ad7124_sequencer *seq, uint16_t enabled_mask)
+{
+	int8_t previous = -1;
+	int8_t lowest = -1;
+
+	memset(seq, 0, sizeof(*seq));
+	seq->enabled_mask = enabled_mask;
+	seq->expected = -1;
+	seq->last = -1;
+
+	for (uint8_t i = 0; i < AD7124_SEQUENCER_CHANNELS; i++) {
+		if (!(enabled_mask & (1 << i)))
+			continue;
+		if (lowest < 0)
+			lowest = i;
+		else
+			seq->following[previous] = i;
+		previous = i;
+	}
+	if (previous >= 0) {
+		seq->following[previous] = lowest;
+		seq->first = lowest;
+	}
+}
+
+/*!
+ * @brief      Checks a conversion against the prediction and advances it
+ *
+ * @details    Conversions of channels outside the enabled mask are ignored.
+ */
+struct ad7124_sequencer_gap ad7124_sequencer_next(struct ad7124_sequencer *seq,
+						     uint8_t channel)
+{
+	struct ad7124_sequencer_gap gap = {0, 0, false};
+
+	if (channel >= AD7124_SEQUENCER_CHANNELS ||
+	    !(seq->enabled_mask & (1 << channel)))
+		return gap;
+
+	if (seq->expected >= 0 && channel != seq->expected) {
+		gap.first = seq->expected;
+		for (uint8_t i = seq->expected; i != channel; i = seq->following[i])
+			gap.skipped |= 1 << i;
+		gap.repeated = (channel == seq->last);
+	}
+
+	seq->last = channel;
+	seq->expected = seq->following[channel];
+
+	return gap;
+}
+
+/*!
+ * @brief      Expects the lowest enabled channel next, after the device
+ *             restarted its sequence
+ *
+ * @details    A write to a channel register during continuous conversion
+ *             restarts the sequence.
+ */
+void ad7124_sequencer_restart(struct ad7124_sequencer *seq)
+{
+	if (seq->enabled_mask)
+		seq->expected = seq->first;
+}
@@ -0,0 +1,47 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_sequencer.h
+
+  @brief: Predicts the channel sequence of the AD7124 and detects gaps
+
+  @details: In continuous mode the AD7124 converts the enabled channels in
+            ascending order and wraps around. When the reader is too slow a
+            conversion is overwritten by the next one and the channel index
+            in STATUS jumps ahead; this module spots those jumps. Losses of
+            a whole number of scans leave the sequence unchanged and are not
+            seen, so with one enabled channel no overrun can be detected.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_SEQUENCER_H_
+#define AD7124_SEQUENCER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AD7124_SEQUENCER_CHANNELS	16
+
+struct ad7124_sequencer {
+	uint16_t enabled_mask;
+	// channel converted after each enabled channel
+	uint8_t following[AD7124_SEQUENCER_CHANNELS];
+	// channel that starts a scan (lowest enabled)
+	uint8_t first;
+	// channel predicted for the next conversion, -1 before the first one
+	int8_t expected;
+	int8_t last;
+};
+
+/* Channels lost in front of a conversion, walk them with following[] */
+struct ad7124_sequencer_gap {
+	uint16_t skipped;	// mask of channels whose conversion was lost
+	uint8_t first;		// first lost channel in sequence order
+	bool repeated;		// the same channel twice, at least N-1 conversions lost
+};
+
+void ad7124_sequencer_init(struct ad7124_sequencer *seq, uint16_t enabled_mask);
+struct ad7124_sequencer_gap ad7124_sequencer_next(struct ad7124_sequencer *seq,
+						     uint8_t channel);
+void ad7124_sequencer_restart(struct ad7124_sequencer *seq);
+
+#endif /* AD7124_SEQUENCER_H_ */
@@ -0,0 +1,211 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_snapshot.c
+
+  @brief: Whole register map dump and restore in single SPI bursts
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+
+#include "ad7124_snapshot.h"
+
+/* Command, up to 3 data bytes and CRC per register */
+#define BURST_LEN	(AD7124_REG_NO * 5)
+
+static uint8_t burst_tx[BURST_LEN];
+static uint8_t burst_rx[BURST_LEN];
+
+/*
+ * Data is left out of the dump, reading it takes a conversion from the
+ * stream and its length depends on a DATA_STATUS bit the device may not
+ * share with the shadow map, which would shift every frame after it
+ */
+static bool in_dump(const struct ad7124_st_reg *reg)
+{
+	return reg->rw != AD7124_W && reg->addr != AD7124_DATA_REG;
+}
+
+static int32_t ready_check(struct ad7124_dev *dev)
+{
+	if (!dev->check_ready)
+		return 0;
+	return ad7124_wait_for_spi_ready(dev, dev->spi_rdy_poll_cnt);
+}
+
+/*
+ * The hardware CSN goes high whenever the TX FIFO runs empty, e.g. while an
+ * interrupt holds the core in the middle of a burst, and the device would
+ * take the next byte for a command. Bursts hold CS low from SIO instead.
+ */
+static void burst_transfer(uint16_t len)
+{
+	gpio_put(PICO_DEFAULT_SPI_CSN_PIN, 0);
+	gpio_set_dir(PICO_DEFAULT_SPI_CSN_PIN, GPIO_OUT);
+	gpio_set_function(PICO_DEFAULT_SPI_CSN_PIN, GPIO_FUNC_SIO);
+	spi_write_read_blocking(spi_default, burst_tx, burst_rx, len);
+	gpio_put(PICO_DEFAULT_SPI_CSN_PIN, 1);
+	gpio_set_function(PICO_DEFAULT_SPI_CSN_PIN, GPIO_FUNC_SPI);
+}
+
+static bool differs_from_shadow(const struct ad7124_snapshot *snapshot, uint8_t reg)
+{
+	return snapshot->differs[reg / 8] & (1 << (reg % 8));
+}
+
+/*!
+ * @brief      Reads every readable register but Data in one burst
+ *
+ * @details    Only the read/write registers are compared with the shadow
+ *             map, status, data and error change on their own. The shadow
+ *             map is left as it is. Returns the number of registers that
+ *             differ, or a negative error code.
+ */
+int32_t ad7124_snapshot_dump(struct ad7124_dev *dev, struct ad7124_snapshot *snapshot)
+{
+	uint16_t len = 0;
+	uint16_t frame;
+	int32_t ret;
+	int32_t differing = 0;
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->magic = AD7124_SNAPSHOT_MAGIC;
+	snapshot->time_ms = to_ms_since_boot(get_absolute_time());
+
+	memset(burst_tx, 0, sizeof(burst_tx));
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++) {
+		if (!in_dump(&dev->regs[i]))
+			continue;
+		burst_tx[len] = AD7124_COMM_REG_WEN | AD7124_COMM_REG_RD |
+				AD7124_COMM_REG_RA(dev->regs[i].addr);
+		len += 1 + dev->regs[i].size + (dev->use_crc != AD7124_DISABLE_CRC);
+	}
+
+	if ((ret = ready_check(dev)) < 0)
+		return ret;
+	burst_transfer(len);
+
+	frame = 0;
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++) {
+		const struct ad7124_st_reg *reg = &dev->regs[i];
+		uint32_t value = 0;
+
+		if (!in_dump(reg))
+			continue;
+		if (dev->use_crc == AD7124_USE_CRC) {
+			// the CRC covers the command byte as sent
+			burst_rx[frame] = burst_tx[frame];
+			if (ad7124_compute_crc8(&burst_rx[frame], reg->size + 2) != 0)
+				return COMM_ERR;
+		}
+		for (uint8_t b = 0; b < reg->size; b++)
+			value = value << 8 | burst_rx[frame + 1 + b];
+		frame += 1 + reg->size + (dev->use_crc != AD7124_DISABLE_CRC);
+
+		snapshot->values[i][0] = value >> 16;
+		snapshot->values[i][1] = value >> 8;
+		snapshot->values[i][2] = value;
+		if (reg->rw == AD7124_RW && value != (uint32_t)reg->value) {
+			snapshot->differs[i / 8] |= 1 << (i % 8);
+			differing++;
+		}
+	}
+
+	snapshot->crc = ad7124_compute_crc8((uint8_t *)snapshot,
+					    offsetof(struct ad7124_snapshot, crc));
+	return differing;
+}
+
+/*!
+ * @brief      Takes the offsets and gains of a dump into the shadow map
+ *
+ * @details    The register table holds nominal calibration values, the
+ *             device the factory trim of its gains. Without this a restore
+ *             would write the nominal values over the trim.
+ */
+void ad7124_snapshot_adopt_calibration(struct ad7124_dev *dev,
+				       const struct ad7124_snapshot *snapshot)
+{
+	for (uint8_t i = AD7124_Offset_0; i <= AD7124_Gain_7; i++)
+		dev->regs[i].value = (uint32_t)snapshot->values[i][0] << 16 |
+				     snapshot->values[i][1] << 8 | snapshot->values[i][2];
+}
+
+/*!
+ * @brief      Writes the shadow map back to the device
+ *
+ * @details    For a device that lost its settings, e.g. after a brown-out.
+ *             Error_En goes first on its own, it may switch the CRC of the
+ *             frames after it. ADC_Control goes last on its own, its mode
+ *             may start a calibration that ignores the bus. Everything in
+ *             between is one burst, including the offsets and gains, so the
+ *             shadow map must hold the device's calibration, see
+ *             ad7124_snapshot_adopt_calibration(). Returns the number of
+ *             registers written.
+ */
+int32_t ad7124_snapshot_restore(struct ad7124_dev *dev)
+{
+	uint16_t len = 0;
+	int32_t ret;
+	int32_t written = 2;
+
+	if ((ret = ad7124_write_register(dev, dev->regs[AD7124_Error_En])) < 0)
+		return ret;
+	ad7124_update_crcsetting(dev);
+	ad7124_update_dev_spi_settings(dev);
+
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++) {
+		const struct ad7124_st_reg *reg = &dev->regs[i];
+		uint32_t value = reg->value;
+
+		if (reg->rw != AD7124_RW || i == AD7124_Error_En || i == AD7124_ADC_Control)
+			continue;
+		burst_tx[len] = AD7124_COMM_REG_WEN | AD7124_COMM_REG_WR |
+				AD7124_COMM_REG_RA(reg->addr);
+		for (uint8_t b = 0; b < reg->size; b++)
+			burst_tx[len + reg->size - b] = value >> (8 * b);
+		if (dev->use_crc != AD7124_DISABLE_CRC) {
+			burst_tx[len + reg->size + 1] = ad7124_compute_crc8(&burst_tx[len],
+									    reg->size + 1);
+			len++;
+		}
+		len += 1 + reg->size;
+		written++;
+	}
+
+	if ((ret = ready_check(dev)) < 0)
+		return ret;
+	burst_transfer(len);
+
+	if ((ret = ad7124_write_register(dev, dev->regs[AD7124_ADC_Control])) < 0)
+		return ret;
+	return written;
+}
+
+/*!
+ * @brief      Prints the differing registers and the snapshot as hex
+ *
+ * @details    One "reg shadow device" line per difference, then a line
+ *             with the whole struct ad7124_snapshot.
+ */
+void ad7124_snapshot_print(const struct ad7124_snapshot *snapshot,
+			   const struct ad7124_st_reg *regs)
+{
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++) {
+		if (differs_from_shadow(snapshot, i)) {
+			printf("%02x %06lx %02x%02x%02x\r\n", i, (uint32_t)regs[i].value,
+			       snapshot->values[i][0], snapshot->values[i][1],
+			       snapshot->values[i][2]);
+		}
+	}
+	for (uint16_t i = 0; i < sizeof(*snapshot); i++)
+		printf("%02x", ((const uint8_t *)snapshot)[i]);
+	printf("\r\n");
+}
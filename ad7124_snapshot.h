@@ -0,0 +1,39 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_snapshot.h
+
+  @brief: Whole register map dump and restore in single SPI bursts
+
+  @details: The AD7124 takes one register access after another without CS
+            going high, so all command frames of a dump or restore are put
+            into one buffer and clocked out in one transfer, after a single
+            ready check. The dump goes into a snapshot that also marks the
+            registers differing from the shadow map, printed as hex the host
+            can store and diff.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_SNAPSHOT_H_
+#define AD7124_SNAPSHOT_H_
+
+#include <stdint.h>
+#include "ad7124.h"
+
+#define AD7124_SNAPSHOT_MAGIC	0x31534441	/* "ADS1" */
+
+struct ad7124_snapshot {
+	uint32_t magic;
+	uint32_t time_ms;
+	uint8_t differs[8];		/* bit per register, device and shadow differ */
+	uint8_t values[AD7124_REG_NO][3];	/* big endian, as on the bus */
+	uint8_t crc;			/* CRC-8 of the bytes before */
+};
+
+int32_t ad7124_snapshot_dump(struct ad7124_dev *dev, struct ad7124_snapshot *snapshot);
+void ad7124_snapshot_adopt_calibration(struct ad7124_dev *dev,
+				       const struct ad7124_snapshot *snapshot);
+int32_t ad7124_snapshot_restore(struct ad7124_dev *dev);
+void ad7124_snapshot_print(const struct ad7124_snapshot *snapshot,
+			   const struct ad7124_st_reg *regs);
+
+#endif /* AD7124_SNAPSHOT_H_ */
@@ -0,0 +1,391 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_spectrum.c
+
+  @brief: Mains spectrum of every channel, computed on the second core
+
+  @details: Per scan of a frame the window and the cosine and sine of each
+            bin are interpolated in one 1024 entry Q15 table, then every valid code
+            minus the channel's mean of the previous frame is windowed and
+            accumulated into the bins as 32 x 16 bit products in 64 bits.
+            A gap in the block sequence restarts the frame. Amplitudes are
+            2 |X| / sum(w), computed once per frame.
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+
+#include "ad7124_spectrum.h"
+#include "ad7124_block.h"
+#include "ad7124_format.h"
+#include "ad7124_support.h"
+#include "ad7124_timing.h"
+#include "ad7124_usb_out.h"
+
+#define AD7124_SPECTRUM_TABLE_BITS	10
+/* Time core1 gets to finish the blocks published when the stream stopped */
+#define AD7124_SPECTRUM_STOP_US		200000
+
+struct ad7124_spectrum ad7124_spectrum;
+
+static int16_t cos_table[1 << AD7124_SPECTRUM_TABLE_BITS];
+
+/* Interpolated between the table entries, per scan and bin only */
+static inline int16_t cos_q15(uint32_t phase)
+{
+	uint32_t index = phase >> (32 - AD7124_SPECTRUM_TABLE_BITS);
+	int32_t fraction = (phase >> (16 - AD7124_SPECTRUM_TABLE_BITS)) & 0xFFFF;
+	int32_t first = cos_table[index];
+	int32_t next = cos_table[(index + 1) & ((1 << AD7124_SPECTRUM_TABLE_BITS) - 1)];
+
+	return first + (((next - first) * fraction) >> 16);
+}
+
+static inline int16_t sin_q15(uint32_t phase)
+{
+	return cos_q15(phase - 0x40000000u);
+}
+
+static void clear_frame(void)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+
+	spectrum->scan = 0;
+	spectrum->window_sum = 0;
+	memset(spectrum->sum, 0, sizeof(spectrum->sum));
+	memset(spectrum->valid, 0, sizeof(spectrum->valid));
+	memset(spectrum->re, 0, sizeof(spectrum->re));
+	memset(spectrum->im, 0, sizeof(spectrum->im));
+}
+
+static int32_t clamp_q8(int64_t value)
+{
+	if (value > INT32_MAX)
+		return INT32_MAX;
+	if (value < -INT32_MAX)
+		return -INT32_MAX;
+	return value;
+}
+
+/* Queues the amplitudes of every channel for core0 and starts the next frame */
+static void finish_frame(uint32_t completed_us)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+	// 2 |X| / sum(w) in Q8 is |X| / (sum(w) / 512)
+	uint32_t divisor = spectrum->window_sum >> 9;
+
+	for (uint8_t ch = 0; ch < AD7124_SPECTRUM_CHANNELS; ch++) {
+		struct ad7124_spectrum_result *result;
+		uint8_t shift = 24 - ((spectrum->bipolar >> ch) & 1) + spectrum->pga[ch];
+
+		if (!(spectrum->channels & (1 << ch)))
+			continue;
+		if (spectrum->valid[ch])
+			spectrum->dc[ch] = spectrum->sum[ch] / spectrum->valid[ch];
+		if (spectrum->head - spectrum->tail >= AD7124_SPECTRUM_RESULTS) {
+			spectrum->results_dropped++;
+			continue;
+		}
+
+		result = &spectrum->results[spectrum->head % AD7124_SPECTRUM_RESULTS];
+		result->completed_us = completed_us;
+		result->channel = ch;
+		result->samples = spectrum->valid[ch];
+		for (uint8_t b = 0; b < spectrum->bins; b++) {
+			int64_t re = clamp_q8(spectrum->re[ch][b] / divisor);
+			int64_t im = clamp_q8(spectrum->im[ch][b] / divisor);
+			uint64_t amplitude = ad7124_isqrt(re * re + im * im) *
+					     spectrum->gain_q14[b] >> 14;
+
+			result->amplitude_nv[b] = (amplitude * AD7124_REF_NV_DIV256 +
+						   (1ull << (shift - 1))) >> shift;
+		}
+		// make the result visible before the index that publishes it
+		__dmb();
+		spectrum->head++;
+	}
+	spectrum->frames++;
+	clear_frame();
+}
+
+static void process_block(const struct ad7124_block *block)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+	int16_t cosine[AD7124_SPECTRUM_BINS];
+	int16_t sine[AD7124_SPECTRUM_BINS];
+
+	if (block->sequence != spectrum->next_sequence) {
+		if (spectrum->scan)
+			spectrum->restarts++;
+		clear_frame();
+	}
+	spectrum->next_sequence = block->sequence + 1;
+
+	for (uint8_t s = 0; s < block->scans; s++) {
+		uint32_t scan = spectrum->scan;
+		int32_t window = (0x7FFF - cos_q15(scan * spectrum->window_step)) >> 1;
+
+		for (uint8_t b = 0; b < spectrum->bins; b++) {
+			uint32_t phase = scan * spectrum->phase_step[b];
+
+			cosine[b] = cos_q15(phase);
+			sine[b] = sin_q15(phase);
+		}
+		spectrum->window_sum += window;
+
+		for (uint8_t ch = 0; ch < AD7124_SPECTRUM_CHANNELS; ch++) {
+			int32_t code = block->codes[ch][s];
+			int32_t x;
+
+			if (!(block->valid[ch] & (1u << s)))
+				continue;
+			if (!(spectrum->dc_set & (1 << ch))) {
+				spectrum->dc[ch] = code;
+				spectrum->dc_set |= 1 << ch;
+			}
+			x = ((int64_t)(code - spectrum->dc[ch]) * window) >> 15;
+			spectrum->sum[ch] += code;
+			spectrum->valid[ch]++;
+			for (uint8_t b = 0; b < spectrum->bins; b++) {
+				spectrum->re[ch][b] += (int64_t)x * cosine[b];
+				spectrum->im[ch][b] -= (int64_t)x * sine[b];
+			}
+		}
+
+		if (++spectrum->scan == spectrum->frame_scans)
+			finish_frame(block->completed_us);
+	}
+}
+
+static void core1_main(void)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+	const struct ad7124_block *block;
+
+	while (true) {
+		uint32_t start, cycles;
+
+		if (!(block = ad7124_block_acquire())) {
+			tight_loop_contents();
+			continue;
+		}
+		start = time_us_32();
+		process_block(block);
+		ad7124_block_release();
+
+		cycles = (time_us_32() - start) * spectrum->cpu_mhz;
+		spectrum->busy_cycles += cycles;
+		if (cycles > spectrum->block_max_cycles)
+			spectrum->block_max_cycles = cycles;
+		__dmb();
+		spectrum->blocks++;
+	}
+}
+
+/*!
+ * @brief      Plans the bins of a register map and starts core1 on them
+ *
+ * @details    frame_ms is rounded up to 100 ms and to at least
+ *             AD7124_SPECTRUM_MIN_FRAME_MS, 0 takes
+ *             AD7124_SPECTRUM_DEFAULT_FRAME_MS. Returns INVALID_VAL when
+ *             the channels are too slow for 50 Hz or a frame has more than
+ *             65535 scans.
+ */
+int32_t ad7124_spectrum_begin(const struct ad7124_st_reg *regs, uint32_t frame_ms)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+	struct ad7124_timing timing;
+	uint32_t per_scan;
+	uint64_t turns;
+	float offset;
+
+	ad7124_timing_from_map(regs, &timing);
+	if (!timing.channels || !timing.scan_period_us)
+		return INVALID_VAL;
+	frame_ms = frame_ms ? (frame_ms + 99) / 100 * 100 : AD7124_SPECTRUM_DEFAULT_FRAME_MS;
+	if (frame_ms < AD7124_SPECTRUM_MIN_FRAME_MS)
+		frame_ms = AD7124_SPECTRUM_MIN_FRAME_MS;
+
+	spectrum->active = false;
+	multicore_reset_core1();
+	spectrum->frame_scans = (frame_ms * 1000 + timing.scan_period_us / 2) /
+				timing.scan_period_us;
+	if (spectrum->frame_scans > UINT16_MAX)
+		return INVALID_VAL;
+
+	// 50, 60, 100, 120 Hz and so on, as long as they are below Nyquist, each
+	// on the nearest whole number of turns in the frame
+	spectrum->bins = 0;
+	for (uint8_t h = 1; h <= AD7124_SPECTRUM_HARMONICS; h++) {
+		for (uint16_t mains = 50; mains <= 60; mains += 10) {
+			uint16_t hz = h * mains;
+
+			if ((uint64_t)hz * 2 * timing.scan_period_us >= 1000000)
+				continue;
+			turns = ((uint64_t)hz * spectrum->frame_scans * timing.scan_period_us +
+				 500000) / 1000000;
+			spectrum->frequency_hz[spectrum->bins] = hz;
+			spectrum->phase_step[spectrum->bins] =
+				((turns << 32) + spectrum->frame_scans / 2) / spectrum->frame_scans;
+			// the Hann response to hz, offset bins from the bin's frequency
+			offset = (float)((int64_t)hz * spectrum->frame_scans * timing.scan_period_us -
+					 (int64_t)turns * 1000000) / 1000000;
+			spectrum->gain_q14[spectrum->bins] = offset == 0 ? 1 << 14 :
+				lroundf((1 << 14) * (float)M_PI * offset * (1 - offset * offset) /
+					sinf((float)M_PI * offset));
+			spectrum->bins++;
+		}
+	}
+
+	// the highest bins go first when core1 would be too busy
+	spectrum->cpu_mhz = clock_get_hz(clk_sys) / 1000000;
+	spectrum->block_period_cycles = AD7124_BLOCK_SCANS * timing.scan_period_us *
+					spectrum->cpu_mhz;
+	spectrum->budget_cycles = (uint64_t)spectrum->block_period_cycles *
+				  AD7124_SPECTRUM_BUDGET_PCT / 100;
+	per_scan = timing.channels * AD7124_SPECTRUM_CYCLES_PER_BIN;
+	while (spectrum->bins && AD7124_BLOCK_SCANS * per_scan * spectrum->bins >
+				 spectrum->budget_cycles)
+		spectrum->bins--;
+	spectrum->estimated_cycles = AD7124_BLOCK_SCANS * per_scan * spectrum->bins;
+	if (!spectrum->bins || spectrum->frame_scans < 2)
+		return INVALID_VAL;
+
+	if (cos_table[0] == 0) {
+		for (uint32_t i = 0; i < 1 << AD7124_SPECTRUM_TABLE_BITS; i++)
+			cos_table[i] = lroundf(32767 * cosf(2 * (float)M_PI * i /
+							    (1 << AD7124_SPECTRUM_TABLE_BITS)));
+	}
+	spectrum->window_step = (uint32_t)((1ull << 32) / spectrum->frame_scans);
+
+	spectrum->channels = 0;
+	spectrum->bipolar = 0;
+	for (uint8_t ch = 0; ch < AD7124_SPECTRUM_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value;
+		int32_t config;
+
+		if (!(value & AD7124_CH_MAP_REG_CH_ENABLE))
+			continue;
+		config = regs[AD7124_Config_0 + ((value >> 12) & 0x7)].value;
+		spectrum->channels |= 1 << ch;
+		spectrum->pga[ch] = config & AD7124_CFG_REG_PGA(0x7);
+		if (config & AD7124_CFG_REG_BIPOLAR)
+			spectrum->bipolar |= 1 << ch;
+	}
+
+	clear_frame();
+	spectrum->first_block = ad7124_blocks.head;
+	spectrum->next_sequence = 0;
+	spectrum->dc_set = 0;
+	spectrum->head = 0;
+	spectrum->tail = 0;
+	spectrum->blocks = 0;
+	spectrum->frames = 0;
+	spectrum->restarts = 0;
+	spectrum->results_dropped = 0;
+	spectrum->block_max_cycles = 0;
+	spectrum->busy_cycles = 0;
+	spectrum->header_sent = false;
+	ad7124_block_enable(true);
+	spectrum->active = true;
+	multicore_launch_core1(core1_main);
+	return 0;
+}
+
+/*!
+ * @brief      Lets core1 finish the last blocks, prints its frames and stops it
+ *
+ * @details    Called after the stream stopped. The partial last frame is
+ *             dropped, its window is not complete.
+ */
+void ad7124_spectrum_end(void)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+	uint32_t start = time_us_32();
+
+	if (!ad7124_spectrum_active())
+		return;
+	// counted after the release, so the statistics are complete too
+	while (spectrum->blocks != ad7124_blocks.head - spectrum->first_block &&
+	       time_us_32() - start < AD7124_SPECTRUM_STOP_US)
+		tight_loop_contents();
+	multicore_reset_core1();
+	ad7124_spectrum_poll();
+	ad7124_usb_out_write("\n", 1);
+	ad7124_usb_out_flush();
+	spectrum->active = false;
+	ad7124_block_enable(false);
+}
+
+/*!
+ * @brief      Prints the frames core1 finished, from the stream loop
+ *
+ * @details    One "F, time ms, channel, samples, amplitude nV..." line per
+ *             channel and frame, the first call prints the bin frequencies.
+ */
+void ad7124_spectrum_poll(void)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+	char line[4 + (3 + AD7124_SPECTRUM_BINS) * (AD7124_FORMAT_FIELD_LEN + 2)];
+	char *end;
+
+	if (!spectrum->header_sent) {
+		spectrum->header_sent = true;
+		ad7124_usb_out_write("\nF, time ms, channel, samples", 28);
+		for (uint8_t b = 0; b < spectrum->bins; b++)
+			ad7124_usb_out_printf(", %u Hz", spectrum->frequency_hz[b]);
+	}
+
+	while (spectrum->tail != spectrum->head) {
+		const struct ad7124_spectrum_result *result;
+
+		__dmb();
+		result = &spectrum->results[spectrum->tail % AD7124_SPECTRUM_RESULTS];
+		end = line;
+		*end++ = '\n';
+		*end++ = 'F';
+		*end++ = ',';
+		*end++ = ' ';
+		end = ad7124_format_int(end, result->completed_us / 1000, 0);
+		*end++ = ',';
+		*end++ = ' ';
+		end = ad7124_format_int(end, result->channel, 0);
+		*end++ = ',';
+		*end++ = ' ';
+		end = ad7124_format_int(end, result->samples, 0);
+		for (uint8_t b = 0; b < spectrum->bins; b++) {
+			*end++ = ',';
+			*end++ = ' ';
+			end = ad7124_format_int(end, result->amplitude_nv[b], 0);
+		}
+		ad7124_usb_out_write(line, end - line);
+		// done reading the result before core1 may reuse it
+		__dmb();
+		spectrum->tail++;
+	}
+}
+
+/*!
+ * @brief      Prints the counters and the core1 cycles of the last spectrum
+ *
+ * @details
+ */
+void ad7124_spectrum_print(void)
+{
+	struct ad7124_spectrum *spectrum = &ad7124_spectrum;
+
+	if (!spectrum->blocks)
+		return;
+	printf("spectrum: %u bins, frames %lu, restarts %lu, results dropped %lu\r\n",
+	       spectrum->bins, spectrum->frames, spectrum->restarts, spectrum->results_dropped);
+	printf("spectrum cycles per block: max %lu, mean %lu, estimated %lu, budget %lu of %lu\r\n",
+	       spectrum->block_max_cycles, (uint32_t)(spectrum->busy_cycles / spectrum->blocks),
+	       spectrum->estimated_cycles, spectrum->budget_cycles,
+	       spectrum->block_period_cycles);
+}
@@ -0,0 +1,125 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_spectrum.h
+
+  @brief: Mains spectrum of every channel, computed on the second core
+
+  @details: The spectrum mode takes the sample blocks of the stream on
+            core1 and correlates frames of AD7124_SPECTRUM_FRAME_MS with a
+            Hann window against the 50 and 60 Hz bins and their harmonics.
+            Every finished frame goes back to core0 as one "F" line per
+            channel with the amplitude of each bin in nV, referred to the
+            input, instead of the sample rows. A frame is the whole number
+            of scans nearest its length, a multiple of 100 ms, and every bin
+            turns a whole number of times in it. The bins are DFT bins of
+            the frame, so the Hann window, which reaches one bin to either
+            side, leaks nothing from one into another while frames of 200 ms
+            or more keep 50 and 60 Hz two bins apart.
+
+            Unless the scan period divides the frame, the frame misses its
+            length by up to half a scan and a mains tone at f sits
+            d = f * miss off its bin: 0.15 bins for 150 Hz at a 2286 us
+            scan and 1 s frames. The window reads it low by about 0.65 d^2,
+            which gain_q14 undoes for the nominal frequency. What is left is
+            a leak of about d / 6 of the tone into the bins two away, at
+            that scan and 200 ms frames 0.9 % of 50 Hz in the 60 Hz bin,
+            and the same scalloping for mains off its nominal frequency.
+
+            The bins follow a phase accumulator instead of the Goertzel
+            recursion: 50 Hz at kHz rates needs 2cos(w) to more bits than a
+            32 bit coefficient has, and the recursion grows with 1/sin(w).
+            Harmonics are dropped when the estimated cycles per block exceed
+            AD7124_SPECTRUM_BUDGET_PCT of core1, the measured cycles are in
+            the acquisition statistics.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_SPECTRUM_H_
+#define AD7124_SPECTRUM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ad7124.h"
+
+#define AD7124_SPECTRUM_CHANNELS	16
+
+/* Harmonics of each mains frequency, below half the channel rate */
+#ifndef AD7124_SPECTRUM_HARMONICS
+#define AD7124_SPECTRUM_HARMONICS	5
+#endif
+#define AD7124_SPECTRUM_BINS		(2 * AD7124_SPECTRUM_HARMONICS)
+
+/* Frame length when none is given and the shortest, multiples of 100 ms */
+#define AD7124_SPECTRUM_DEFAULT_FRAME_MS	1000
+#define AD7124_SPECTRUM_MIN_FRAME_MS		200
+
+/* Share of core1 the bins may take, and the estimated cost per sample and bin */
+#define AD7124_SPECTRUM_BUDGET_PCT	50
+#define AD7124_SPECTRUM_CYCLES_PER_BIN	48
+
+/* Finished frames waiting for core0 */
+#define AD7124_SPECTRUM_RESULTS	32
+
+struct ad7124_spectrum_result {
+	uint32_t completed_us;
+	uint8_t channel;
+	uint16_t samples;		/* valid samples in the frame */
+	uint32_t amplitude_nv[AD7124_SPECTRUM_BINS];	/* peak */
+};
+
+struct ad7124_spectrum {
+	volatile bool active;
+	uint16_t channels;		/* enabled channel mask */
+	uint16_t bipolar;		/* channel mask */
+	uint8_t pga[AD7124_SPECTRUM_CHANNELS];
+	uint8_t bins;			/* in use, within the budget and below Nyquist */
+	uint16_t frequency_hz[AD7124_SPECTRUM_BINS];
+	uint32_t phase_step[AD7124_SPECTRUM_BINS];	/* per scan, 2^32 a full turn */
+	uint16_t gain_q14[AD7124_SPECTRUM_BINS];	/* window loss at the nominal frequency */
+	uint32_t frame_scans;
+	uint32_t window_step;
+	uint32_t cpu_mhz;
+	uint32_t block_period_cycles;	/* AD7124_BLOCK_SCANS scans */
+	uint32_t budget_cycles;		/* per block */
+	uint32_t estimated_cycles;	/* per block, for the bins in use */
+	bool header_sent;
+
+	// core1 only
+	uint32_t scan;			/* in the frame */
+	uint32_t next_sequence;
+	uint32_t window_sum;		/* Q15 */
+	uint16_t dc_set;		/* channel mask */
+	int32_t dc[AD7124_SPECTRUM_CHANNELS];
+	int64_t sum[AD7124_SPECTRUM_CHANNELS];
+	uint16_t valid[AD7124_SPECTRUM_CHANNELS];
+	int64_t re[AD7124_SPECTRUM_CHANNELS][AD7124_SPECTRUM_BINS];
+	int64_t im[AD7124_SPECTRUM_CHANNELS][AD7124_SPECTRUM_BINS];
+
+	// head is only written by core1, tail only by core0
+	struct ad7124_spectrum_result results[AD7124_SPECTRUM_RESULTS];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+
+	uint32_t first_block;		/* published blocks before this stream */
+	volatile uint32_t blocks;	/* processed */
+	uint32_t frames;
+	uint32_t restarts;		/* frames dropped for a missing block */
+	uint32_t results_dropped;
+	uint32_t block_max_cycles;
+	uint64_t busy_cycles;
+};
+
+extern struct ad7124_spectrum ad7124_spectrum;
+
+int32_t ad7124_spectrum_begin(const struct ad7124_st_reg *regs, uint32_t frame_ms);
+void ad7124_spectrum_end(void);
+void ad7124_spectrum_poll(void);
+void ad7124_spectrum_print(void);
+
+/* Rows go out only as spectra while the mode is on */
+static inline bool ad7124_spectrum_active(void)
+{
+	return ad7124_spectrum.active;
+}
+
+#endif /* AD7124_SPECTRUM_H_ */
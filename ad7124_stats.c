@@ -0,0 +1,124 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_stats.c
+
+  @brief: Runtime acquisition statistics (counters and histograms)
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "ad7124.h"
+#include "ad7124_stats.h"
+
+struct ad7124_stats_core ad7124_stats_cores[AD7124_STATS_CORES];
+
+// acquisition window the counters cover, used to turn counts into rates
+static uint64_t stats_start_us = 0;
+static uint64_t stats_stop_us = 0;
+
+/*!
+ * @brief      Classifies a negative driver return code into its counter
+ *
+ * @details
+ */
+void ad7124_stats_count_error(struct ad7124_stats_core *stats,
+			      int32_t error_code)
+{
+	switch (error_code) {
+		case COMM_ERR:
+			stats->crc_errors++;
+			break;
+		case TIMEOUT:
+			stats->timeouts++;
+			break;
+		default:
+			stats->spi_errors++;
+			break;
+	}
+}
+
+/*!
+ * @brief      Clears the counters of both cores and opens a new window
+ *
+ * @details    Only call this while no acquisition is running, the owning
+ *             cores are not synchronised with.
+ */
+void ad7124_stats_start(void)
+{
+	memset(ad7124_stats_cores, 0, sizeof(ad7124_stats_cores));
+	stats_start_us = time_us_64();
+	stats_stop_us = 0;
+}
+
+/*!
+ * @brief      Closes the window so rates are not diluted by idle time
+ *
+ * @details
+ */
+void ad7124_stats_stop(void)
+{
+	stats_stop_us = time_us_64();
+}
+
+/*!
+ * @brief      Sums the per-core counters and prints them to the console
+ *
+ * @details
+ */
+void ad7124_stats_print(void)
+{
+	struct ad7124_stats_core total = {0};
+	uint64_t elapsed_us = (stats_stop_us ? stats_stop_us : time_us_64()) - stats_start_us;
+
+	for (uint8_t core = 0; core < AD7124_STATS_CORES; core++) {
+		struct ad7124_stats_core *stats = &ad7124_stats_cores[core];
+
+		for (uint8_t i = 0; i < AD7124_STATS_CHANNELS; i++) {
+			total.samples[i] += stats->samples[i];
+			total.missed[i] += stats->missed[i];
+		}
+		total.crc_errors += stats->crc_errors;
+		total.spi_errors += stats->spi_errors;
+		total.adc_errors += stats->adc_errors;
+		total.timeouts += stats->timeouts;
+		total.resyncs += stats->resyncs;
+		total.resets += stats->resets;
+		total.recovery_lost += stats->recovery_lost;
+		if (stats->queue_high_water > total.queue_high_water)
+			total.queue_high_water = stats->queue_high_water;
+		for (uint8_t i = 0; i < AD7124_STATS_LOOP_BUCKETS; i++)
+			total.loop_hist[i] += stats->loop_hist[i];
+	}
+
+	printf("\r\nAcquisition statistics over %lu ms\r\n",
+	       (uint32_t)(elapsed_us / 1000));
+	printf("ch   samples    per s   missed\r\n");
+	for (uint8_t i = 0; i < AD7124_STATS_CHANNELS; i++) {
+		if (!total.samples[i] && !total.missed[i])
+			continue;
+		printf("%2i %9lu %8lu %8lu\r\n", i, total.samples[i],
+		       elapsed_us ? (uint32_t)(total.samples[i] * 1000000ull / elapsed_us) : 0,
+		       total.missed[i]);
+	}
+
+	printf("\r\ncrc errors %lu, spi errors %lu, adc errors %lu, timeouts %lu\r\n",
+	       total.crc_errors, total.spi_errors, total.adc_errors, total.timeouts);
+	printf("recovered by resync %lu, by reset %lu, about %lu conversions lost\r\n",
+	       total.resyncs, total.resets, total.recovery_lost);
+	printf("queue high-water %lu\r\n", total.queue_high_water);
+
+	printf("\r\nloop time histogram\r\n");
+	for (uint8_t i = 0; i < AD7124_STATS_LOOP_BUCKETS; i++) {
+		if (!total.loop_hist[i])
+			continue;
+		if (i == AD7124_STATS_LOOP_BUCKETS - 1)
+			printf(" >= %6lu us %9lu\r\n", 1ul << (i - 1), total.loop_hist[i]);
+		else
+			printf("  < %6lu us %9lu\r\n", 1ul << i, total.loop_hist[i]);
+	}
+}
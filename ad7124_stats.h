@@ -0,0 +1,69 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_stats.h
+
+  @brief: Runtime acquisition statistics (counters and histograms)
+
+  @details: Counters are kept per core and are only ever written by the core
+            that owns them, so the acquisition loop can update them with
+            plain increments and no locking. Readers sum the per-core copies.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_STATS_H_
+#define AD7124_STATS_H_
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+#define AD7124_STATS_CHANNELS       16
+#define AD7124_STATS_CORES          2
+/* Loop time histogram, bucket n holds iterations of [2^(n-1), 2^n) us */
+#define AD7124_STATS_LOOP_BUCKETS   16
+
+struct ad7124_stats_core {
+	uint32_t samples[AD7124_STATS_CHANNELS];
+	uint32_t missed[AD7124_STATS_CHANNELS];
+	uint32_t crc_errors;
+	uint32_t spi_errors;
+	uint32_t adc_errors;
+	uint32_t timeouts;
+	uint32_t resyncs;		/* recoveries by tier, ad7124_recovery.h */
+	uint32_t resets;
+	uint32_t recovery_lost;		/* conversions estimated lost to recoveries */
+	uint32_t queue_high_water;
+	uint32_t loop_hist[AD7124_STATS_LOOP_BUCKETS];
+};
+
+extern struct ad7124_stats_core ad7124_stats_cores[AD7124_STATS_CORES];
+
+/* Counters owned by the calling core, fetch once outside the hot loop */
+static inline struct ad7124_stats_core *ad7124_stats_this_core(void)
+{
+	return &ad7124_stats_cores[get_core_num()];
+}
+
+static inline void ad7124_stats_loop_time(struct ad7124_stats_core *stats,
+					  uint32_t loop_us)
+{
+	uint8_t bucket = loop_us ? 32 - __builtin_clz(loop_us) : 0;
+
+	if (bucket >= AD7124_STATS_LOOP_BUCKETS)
+		bucket = AD7124_STATS_LOOP_BUCKETS - 1;
+	stats->loop_hist[bucket]++;
+}
+
+static inline void ad7124_stats_queue_depth(struct ad7124_stats_core *stats,
+					    uint32_t depth)
+{
+	if (depth > stats->queue_high_water)
+		stats->queue_high_water = depth;
+}
+
+void ad7124_stats_count_error(struct ad7124_stats_core *stats,
+			      int32_t error_code);
+void ad7124_stats_start(void);
+void ad7124_stats_stop(void);
+void ad7124_stats_print(void);
+
+#endif /* AD7124_STATS_H_ */
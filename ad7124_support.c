@@ -95,3 +95,31 @@ float ad7124_convert_sample_to_voltage(struct ad7124_dev *dev, uint8_t channel,
 
     return (convertedValue);
 }
+
+
+/*
+ * @brief integer square root, for the noise and spectrum amplitudes
+ *
+ * @param value Radicand.
+ *
+ * @return Square root of value rounded to nearest.
+ */
+uint64_t ad7124_isqrt(uint64_t value)
+{
+	uint64_t root = 0;
+	uint64_t bit = 1ull << 62;
+
+	while (bit > value)
+		bit >>= 2;
+	while (bit) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	// value is now the remainder x - root^2
+	return value > root ? root + 1 : root;
+}
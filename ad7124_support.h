@@ -21,10 +21,14 @@ Copyright (c) 2019 Analog Devices, Inc.  All rights reserved.
 #define AD7124_REF_VOLTAGE 2.5
 #define AD7124_ADC_N_BITS 24
 
+/* Reference in nV / 256, scales a Q8 or Q16 value of 24 bit codes in 64 bits */
+#define AD7124_REF_NV_DIV256 ((uint64_t)(AD7124_REF_VOLTAGE * 1e9) / 256)
+
 uint8_t ad7124_get_channel_setup(struct ad7124_dev *dev, uint8_t channel);
 uint8_t ad7124_get_channel_pga(struct ad7124_dev *dev, uint8_t channel);
 bool ad7124_get_channel_bipolar(struct ad7124_dev *dev, uint8_t channel);
 float ad7124_convert_sample_to_voltage(struct ad7124_dev *dev, uint8_t channel,
                                        uint32_t sample);
+uint64_t ad7124_isqrt(uint64_t value);
 
 #endif /* AD7124_SUPPORT_H_ */
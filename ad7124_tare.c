@@ -0,0 +1,92 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_tare.c
+
+  @brief: Software tare per channel
+
+  @details:
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ad7124_tare.h"
+
+struct ad7124_tare ad7124_tare = {
+	.samples = AD7124_TARE_DEFAULT_SAMPLES,
+};
+
+/*!
+ * @brief      Starts averaging the next samples of the enabled channels
+ *
+ * @details    Earlier baselines stay in use until the new ones are ready.
+ */
+void ad7124_tare_begin(const struct ad7124_st_reg *regs, uint16_t samples)
+{
+	struct ad7124_tare *tare = &ad7124_tare;
+
+	tare->samples = samples ? samples : AD7124_TARE_DEFAULT_SAMPLES;
+	tare->pending = 0;
+	for (uint8_t ch = 0; ch < AD7124_TARE_CHANNELS; ch++) {
+		int32_t value = regs[AD7124_Channel_0 + ch].value;
+
+		if (!(value & AD7124_CH_MAP_REG_CH_ENABLE))
+			continue;
+		tare->zero_code[ch] = (regs[AD7124_Config_0 + ((value >> 12) & 0x7)].value &
+				       AD7124_CFG_REG_BIPOLAR) ? 0x800000 : 0;
+		tare->sum[ch] = 0;
+		tare->count[ch] = 0;
+		tare->pending |= 1 << ch;
+	}
+}
+
+/*!
+ * @brief      Drops all baselines and any tare in progress
+ *
+ * @details
+ */
+void ad7124_tare_clear(void)
+{
+	ad7124_tare.active = 0;
+	ad7124_tare.pending = 0;
+}
+
+/*!
+ * @brief      Adds a raw code to the average of a channel being tared
+ *
+ * @details    Called through ad7124_tare_apply(), the baseline takes effect
+ *             with the last sample of the average.
+ */
+void ad7124_tare_accumulate(uint8_t channel, int32_t code)
+{
+	struct ad7124_tare *tare = &ad7124_tare;
+	int32_t baseline;
+
+	tare->sum[channel] += code;
+	if (++tare->count[channel] < tare->samples)
+		return;
+
+	baseline = (int32_t)((tare->sum[channel] + tare->samples / 2) / tare->samples);
+	tare->offset[channel] = baseline - tare->zero_code[channel];
+	tare->active |= 1 << channel;
+	tare->pending &= ~(1 << channel);
+}
+
+/*!
+ * @brief      Prints the baselines in use
+ *
+ * @details
+ */
+void ad7124_tare_print(void)
+{
+	struct ad7124_tare *tare = &ad7124_tare;
+
+	printf("tare over %u samples%s\r\n", tare->samples,
+	       tare->pending ? ", in progress" : "");
+	for (uint8_t ch = 0; ch < AD7124_TARE_CHANNELS; ch++) {
+		if (tare->active & (1 << ch))
+			printf("channel %u: baseline %ld\r\n", ch,
+			       tare->offset[ch] + tare->zero_code[ch]);
+	}
+}
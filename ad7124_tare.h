@@ -0,0 +1,55 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_tare.h
+
+  @brief: Software tare per channel
+
+  @details: A tare averages the next samples of every enabled channel and
+            from then on outputs code - baseline + zero code, where the zero
+            code is mid scale for bipolar setups and 0 for unipolar ones.
+            Baselines are kept between streams until cleared, they are
+            applied to the codes before any output or capture path sees
+            them.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_TARE_H_
+#define AD7124_TARE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ad7124.h"
+
+#define AD7124_TARE_CHANNELS	16
+
+/* Samples averaged per channel when no count is given */
+#define AD7124_TARE_DEFAULT_SAMPLES	64
+
+struct ad7124_tare {
+	uint16_t samples;			/* averaged per channel */
+	uint16_t active;			/* channels with a baseline */
+	uint16_t pending;			/* channels still averaging */
+	uint16_t count[AD7124_TARE_CHANNELS];
+	int64_t sum[AD7124_TARE_CHANNELS];
+	int32_t offset[AD7124_TARE_CHANNELS];	/* baseline - zero code */
+	int32_t zero_code[AD7124_TARE_CHANNELS];
+};
+
+extern struct ad7124_tare ad7124_tare;
+
+void ad7124_tare_begin(const struct ad7124_st_reg *regs, uint16_t samples);
+void ad7124_tare_clear(void);
+void ad7124_tare_accumulate(uint8_t channel, int32_t code);
+void ad7124_tare_print(void);
+
+/* Tared code, also feeds a tare in progress; one mask test when idle */
+static inline int32_t ad7124_tare_apply(uint8_t channel, int32_t code)
+{
+	if (ad7124_tare.pending & (1 << channel))
+		ad7124_tare_accumulate(channel, code);
+	if (ad7124_tare.active & (1 << channel))
+		return code - ad7124_tare.offset[channel];
+	return code;
+}
+
+#endif /* AD7124_TARE_H_ */
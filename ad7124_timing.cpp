@@ -0,0 +1,79 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_timing.cpp
+
+  @brief: Compile-time checks and timing of the board configuration
+
+  @details: The table from configuration.h is constexpr here, an invalid
+            field combination or a rate other than the board expects stops
+            the build. The derived timing is exported to the C code.
+ -----------------------------------------------------------------------------
+*/
+
+#include "ad7124_config_builder.hpp"
+#include "ad7124_timing.h"
+#include "configuration.h"
+
+namespace {
+
+static_assert(ad7124::layout_valid(ad7124_regs_config_a),
+	      "register address or size out of place in the board table");
+static_assert(ad7124::enabled_channels(ad7124_regs_config_a) > 0,
+	      "the board table enables no channel");
+static_assert(ad7124::channels_valid(ad7124_regs_config_a),
+	      "an enabled channel uses an invalid filter or input");
+
+constexpr ad7124_timing board_timing = ad7124::timing_of(ad7124_regs_config_a);
+
+// Per-channel rate the board is meant to run at, in Hz, 5% tolerance
+#ifdef channelRate
+static_assert(board_timing.channel_odr_mhz >= channelRate * 950 &&
+	      board_timing.channel_odr_mhz <= channelRate * 1050,
+	      "filter settings do not give the board's channel rate");
+#endif
+
+// The balance board table written with the builder, both must agree
+constexpr ad7124::register_map balanceboard01 = ad7124::config_builder()
+	.adc_control(2, 3, 3)
+	.error_enable(AD7124_ERREN_REG_ADC_SAT_ERR_EN | AD7124_ERREN_REG_ADC_CONV_ERR_EN |
+		      AD7124_ERREN_REG_ADC_CAL_ERR_EN | AD7124_ERREN_REG_SPI_IGNORE_ERR_EN |
+		      AD7124_ERREN_REG_AINM_OV_ERR_EN | AD7124_ERREN_REG_AINM_UV_ERR_EN |
+		      AD7124_ERREN_REG_REF_DET_ERR_EN)
+	.channel(0, 0, 2, 3)
+	.channel(1, 1, 0, 1)
+	.channel(2, 2, 4, 5)
+	.channel(3, 3, 6, 7)
+	.setups(true, 0, 7)
+	.filters(ad7124::filter_sinc4, 60)
+	.build();
+
+#ifdef boardname
+constexpr bool same_name(const char *a, const char *b)
+{
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+static_assert(!same_name(boardname, "BALANCEBOARD01") ||
+	      ad7124::same_configuration(balanceboard01, ad7124_regs_config_a),
+	      "config.stella.h and the builder disagree");
+#endif
+
+} // namespace
+
+extern "C" const struct ad7124_timing ad7124_config_timing = board_timing;
+
+/*!
+ * @brief      Fills in the timing of a register map at runtime
+ *
+ * @details    For maps that are not known at compile time, e.g. after a
+ *             register profile was applied.
+ */
+extern "C" void ad7124_timing_from_map(const struct ad7124_st_reg *regs,
+				       struct ad7124_timing *timing)
+{
+	*timing = ad7124::timing_of(regs);
+}
@@ -0,0 +1,47 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_timing.h
+
+  @brief: Conversion timing derived from a register map
+
+  @details: The timing of the configuration built into the firmware is
+            computed and checked at compile time (ad7124_timing.cpp), the
+            same model is available at runtime for maps loaded later, e.g.
+            from a register profile.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_TIMING_H_
+#define AD7124_TIMING_H_
+
+#include <stdint.h>
+#include "ad7124.h"
+
+#define AD7124_TIMING_CHANNELS		16
+
+/* Shortest possible ready poll, a bare STATUS read at 500 kHz SPI */
+#define AD7124_TIMING_POLL_MIN_US	32
+
+struct ad7124_timing {
+	uint32_t settling_us[AD7124_TIMING_CHANNELS];	/* 0 when disabled */
+	uint32_t scan_period_us;	/* one pass over the enabled channels */
+	uint32_t channel_odr_mhz;	/* output rate of every enabled channel */
+	uint32_t conv_timeout_polls;	/* for ad7124_wait_for_conv_ready() */
+	uint8_t channels;		/* enabled channel count */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Timing of the configuration in configuration.h */
+extern const struct ad7124_timing ad7124_config_timing;
+
+void ad7124_timing_from_map(const struct ad7124_st_reg *regs,
+			    struct ad7124_timing *timing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AD7124_TIMING_H_ */
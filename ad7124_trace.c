@@ -0,0 +1,149 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_trace.c
+
+  @brief: RAM trace of task switches, ISRs and acquisition pipeline events
+
+  @details: The export format is line based so it can be captured from the
+            console and rendered by tools/ad7124_trace.py:
+              #trace begin
+              #task <number> <name>
+              <timestamp us> <core> <type> <arg>
+              #trace end
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ad7124_trace.h"
+
+#define TRACE_CORES		2
+#define TRACE_MAX_TASKS	16
+
+struct trace_ring {
+	struct ad7124_trace_record records[AD7124_TRACE_DEPTH];
+	uint32_t head;		// total number of records written
+};
+
+static struct trace_ring trace_rings[TRACE_CORES];
+
+// cleared while exporting so the dump is a consistent snapshot
+static volatile bool trace_recording = true;
+
+#if AD7124_TRACE_ENABLED
+/*!
+ * @brief      Appends an event to the ring of the calling core
+ *
+ * @details    Interrupts are masked so an ISR on the same core cannot
+ *             interleave with the write, the other core has its own ring.
+ */
+void __time_critical_func(ad7124_trace)(enum ad7124_trace_event type, uint16_t arg)
+{
+	if (!trace_recording)
+		return;
+
+	uint32_t irq_state = save_and_disable_interrupts();
+	struct trace_ring *ring = &trace_rings[get_core_num()];
+	struct ad7124_trace_record *record =
+		&ring->records[ring->head & (AD7124_TRACE_DEPTH - 1)];
+
+	record->timestamp_us = time_us_32();
+	record->type = type;
+	record->core = get_core_num();
+	record->arg = arg;
+	ring->head++;
+	restore_interrupts(irq_state);
+}
+
+/*!
+ * @brief      Kernel hook, records the task being switched in or out
+ *
+ * @details
+ */
+void __time_critical_func(ad7124_trace_task_switched)(enum ad7124_trace_event type)
+{
+	ad7124_trace(type, uxTaskGetTaskNumber(xTaskGetCurrentTaskHandle()));
+}
+#endif
+
+/*!
+ * @brief      Drops all recorded events
+ *
+ * @details
+ */
+void ad7124_trace_clear(void)
+{
+	trace_recording = false;
+	for (uint8_t core = 0; core < TRACE_CORES; core++) {
+		trace_rings[core].head = 0;
+	}
+	trace_recording = true;
+}
+
+/*!
+ * @brief      Prints the task table and the per-core rings merged in time order
+ *
+ * @details
+ */
+void ad7124_trace_export(void)
+{
+	uint32_t next[TRACE_CORES], end[TRACE_CORES];
+
+	trace_recording = false;
+
+	printf("\r\n#trace begin\r\n");
+
+	if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+		static TaskStatus_t tasks[TRACE_MAX_TASKS];
+		static char run_time_stats[TRACE_MAX_TASKS * 48];
+		UBaseType_t task_count = uxTaskGetSystemState(tasks, TRACE_MAX_TASKS, NULL);
+
+		for (UBaseType_t i = 0; i < task_count; i++) {
+			printf("#task %lu %s\r\n", (uint32_t)tasks[i].xTaskNumber,
+			       tasks[i].pcTaskName);
+		}
+		if (task_count <= TRACE_MAX_TASKS) {
+			vTaskGetRunTimeStats(run_time_stats);
+			printf("#runtime\r\n%s", run_time_stats);
+		}
+	}
+
+	for (uint8_t core = 0; core < TRACE_CORES; core++) {
+		end[core] = trace_rings[core].head;
+		next[core] = end[core] > AD7124_TRACE_DEPTH ? end[core] - AD7124_TRACE_DEPTH : 0;
+	}
+
+	for (;;) {
+		struct ad7124_trace_record *oldest = NULL;
+		uint8_t oldest_core = 0;
+
+		for (uint8_t core = 0; core < TRACE_CORES; core++) {
+			struct ad7124_trace_record *record;
+
+			if (next[core] == end[core])
+				continue;
+			record = &trace_rings[core].records[next[core] & (AD7124_TRACE_DEPTH - 1)];
+			// signed difference keeps the order right across a timer wrap
+			if (!oldest || (int32_t)(record->timestamp_us - oldest->timestamp_us) < 0) {
+				oldest = record;
+				oldest_core = core;
+			}
+		}
+		if (!oldest)
+			break;
+
+		printf("%lu %u %u %u\r\n", oldest->timestamp_us, oldest->core,
+		       oldest->type, oldest->arg);
+		next[oldest_core]++;
+	}
+
+	printf("#trace end\r\n");
+
+	trace_recording = true;
+}
@@ -0,0 +1,68 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_trace.h
+
+  @brief: RAM trace of task switches, ISRs and acquisition pipeline events
+
+  @details: Every core records into its own ring buffer with interrupts
+            masked for the few instructions of the write, so no lock is
+            shared between the cores. This header is pulled in by
+            FreeRTOSConfig.h to install the kernel trace hooks and must
+            therefore stay free of FreeRTOS includes.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_TRACE_H_
+#define AD7124_TRACE_H_
+
+#include <stdint.h>
+
+/* Set to 0 to compile all trace points away */
+#ifndef AD7124_TRACE_ENABLED
+#define AD7124_TRACE_ENABLED	1
+#endif
+
+/* Events kept per core, must be a power of two */
+#define AD7124_TRACE_DEPTH		1024
+
+/* Event types, the host tool (tools/ad7124_trace.py) uses the same values */
+enum ad7124_trace_event {
+	AD7124_TRACE_TASK_IN = 0,	/* arg: task number */
+	AD7124_TRACE_TASK_OUT,		/* arg: task number */
+	AD7124_TRACE_ISR_ENTER,		/* arg: irq / gpio number */
+	AD7124_TRACE_ISR_EXIT,		/* arg: irq / gpio number */
+	AD7124_TRACE_CONV_READY,	/* arg: channel from STATUS */
+	AD7124_TRACE_SAMPLE_READ,	/* arg: channel */
+	AD7124_TRACE_OUTPUT,		/* arg: bytes handed to the output path */
+	AD7124_TRACE_STREAM_START,
+	AD7124_TRACE_STREAM_STOP,
+	AD7124_TRACE_RECOVERY,		/* failed read, ad7124_recover() follows */
+	AD7124_TRACE_USER
+};
+
+/* ISR argument of the stdio rx callback, gpio ISRs use the pin number */
+#define AD7124_TRACE_ARG_STDIO_RX	0x100
+
+struct ad7124_trace_record {
+	uint32_t timestamp_us;
+	uint8_t type;
+	uint8_t core;
+	uint16_t arg;
+};
+
+#if AD7124_TRACE_ENABLED
+void ad7124_trace(enum ad7124_trace_event type, uint16_t arg);
+void ad7124_trace_task_switched(enum ad7124_trace_event type);
+#else
+#define ad7124_trace(type, arg)
+#define ad7124_trace_task_switched(type)
+#endif
+
+void ad7124_trace_clear(void);
+void ad7124_trace_export(void);
+
+/* FreeRTOS kernel hooks */
+#define traceTASK_SWITCHED_IN()		ad7124_trace_task_switched(AD7124_TRACE_TASK_IN)
+#define traceTASK_SWITCHED_OUT()	ad7124_trace_task_switched(AD7124_TRACE_TASK_OUT)
+
+#endif /* AD7124_TRACE_H_ */
@@ -0,0 +1,76 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_usb_frame.h
+
+  @brief: Frames of the vendor bulk stream, shared by the firmware and the
+          host reader tools/ad7124_bulk_reader.c
+
+  @details: A frame is one 512 byte bulk transfer, eight full speed packets:
+            an 8 byte header and 63 records of 8 bytes. Everything is little
+            endian. Frames are sent whole, a frame flushed early has fewer
+            valid records in count. The host starts and stops the stream by
+            writing AD7124_USB_START / AD7124_USB_STOP to the OUT endpoint.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_USB_FRAME_H_
+#define AD7124_USB_FRAME_H_
+
+#include <stdint.h>
+
+/* The SDK's stdio device, the reader finds the stream by interface class */
+#define AD7124_USB_VID			0x2E8A
+#define AD7124_USB_PID			0x000A
+
+#define AD7124_USB_EP_OUT		0x03
+#define AD7124_USB_EP_IN		0x83
+#define AD7124_USB_START		'S'
+#define AD7124_USB_STOP			'X'
+
+#define AD7124_USB_FRAME_SIZE		512
+#define AD7124_USB_FRAME_RECORDS	63
+#define AD7124_USB_FRAME_MAGIC		0x4441	/* "AD" */
+
+/* Frame flags */
+#define AD7124_USB_FRAME_PATTERN	(1 << 0)	/* test pattern, no ADC */
+
+/* Record channel byte */
+#define AD7124_USB_RECORD_CHANNEL	0x0F
+#define AD7124_USB_RECORD_LOST		(1 << 4)	/* conversion overwritten, code repeats */
+#define AD7124_USB_RECORD_EDGE		(1 << 5)	/* input edge, channel is the pin, code the levels */
+
+struct ad7124_usb_record {
+	uint32_t timestamp_us;
+	uint8_t code[3];
+	uint8_t channel;
+};
+
+struct ad7124_usb_frame {
+	uint16_t magic;
+	uint16_t sequence;
+	uint8_t count;
+	uint8_t flags;
+	uint16_t dropped;		/* records dropped since the previous frame, saturates */
+	struct ad7124_usb_record records[AD7124_USB_FRAME_RECORDS];
+};
+
+_Static_assert(sizeof(struct ad7124_usb_frame) == AD7124_USB_FRAME_SIZE,
+	       "vendor frame must be one 512 byte transfer");
+
+static inline void ad7124_usb_record_pack(struct ad7124_usb_record *record,
+					  uint32_t timestamp_us, uint8_t channel,
+					  int32_t code, uint8_t flags)
+{
+	record->timestamp_us = timestamp_us;
+	record->code[0] = code;
+	record->code[1] = code >> 8;
+	record->code[2] = code >> 16;
+	record->channel = (channel & AD7124_USB_RECORD_CHANNEL) | flags;
+}
+
+static inline int32_t ad7124_usb_record_code(const struct ad7124_usb_record *record)
+{
+	return record->code[0] | record->code[1] << 8 | record->code[2] << 16;
+}
+
+#endif /* AD7124_USB_FRAME_H_ */
@@ -0,0 +1,170 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_usb_out.c
+
+  @brief: Stream output straight to the TinyUSB CDC endpoint, batched into
+          full 64 byte packets
+
+  @details: pico_stdio_usb runs tud_task() from a low priority interrupt on
+            this core, the CDC calls here mask interrupts around the few
+            microseconds of the fifo copy so the two never interleave.
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "tusb.h"
+
+#include "ad7124_usb_out.h"
+#include "ad7124_trace.h"
+
+/* Longest record ad7124_usb_out_printf() formats */
+#define AD7124_USB_OUT_RECORD		96
+
+struct ad7124_usb_out_stats ad7124_usb_out_stats;
+
+static char out_buffer[AD7124_USB_OUT_SIZE];
+static uint32_t out_length = 0;
+static uint32_t out_pending_since_us = 0;
+static bool out_last_cr = false;
+
+/*
+ * Hands the first len bytes of the buffer to the CDC fifo and moves the
+ * rest to the front. Waits while the fifo is full, the stdio interrupt
+ * keeps sending meanwhile.
+ */
+static void submit(uint32_t len)
+{
+	struct ad7124_usb_out_stats *stats = &ad7124_usb_out_stats;
+	uint32_t start = time_us_32();
+	uint32_t sent = 0;
+	uint32_t written;
+	uint32_t save;
+	bool waited = false;
+
+	while (sent < len) {
+		if (!tud_cdc_connected() || time_us_32() - start > AD7124_USB_OUT_TIMEOUT_US) {
+			stats->dropped += len - sent;
+			break;
+		}
+		save = save_and_disable_interrupts();
+		written = tud_cdc_write(out_buffer + sent, len - sent);
+		tud_cdc_write_flush();
+		restore_interrupts(save);
+
+		sent += written;
+		if (written == 0)
+			waited = true;
+	}
+
+	ad7124_trace(AD7124_TRACE_OUTPUT, sent);
+	stats->bytes += sent;
+	stats->flushes++;
+	stats->waits += waited;
+	if (len > stats->max_flush_bytes)
+		stats->max_flush_bytes = len;
+
+	out_length -= len;
+	memmove(out_buffer, out_buffer + len, out_length);
+	out_pending_since_us = time_us_32();
+}
+
+/*!
+ * @brief      Appends bytes, sends the whole packets once the buffer is full
+ *
+ * @details
+ */
+void ad7124_usb_out_write(const char *data, uint32_t len)
+{
+	while (len--) {
+		// one byte of room for the '\r' in front of a '\n'
+		if (out_length + 2 > AD7124_USB_OUT_SIZE) {
+			ad7124_usb_out_stats.fill_flushes++;
+			submit(out_length & ~(AD7124_USB_OUT_PACKET - 1));
+		}
+		if (out_length == 0)
+			out_pending_since_us = time_us_32();
+		if (*data == '\n' && !out_last_cr)
+			out_buffer[out_length++] = '\r';
+		out_last_cr = *data == '\r';
+		out_buffer[out_length++] = *data++;
+	}
+}
+
+/*!
+ * @brief      printf() into the output buffer
+ *
+ * @details    Records longer than AD7124_USB_OUT_RECORD are cut.
+ */
+void ad7124_usb_out_printf(const char *format, ...)
+{
+	char record[AD7124_USB_OUT_RECORD];
+	va_list args;
+	int len;
+
+	va_start(args, format);
+	len = vsnprintf(record, sizeof(record), format, args);
+	va_end(args);
+
+	if (len > (int)sizeof(record) - 1)
+		len = sizeof(record) - 1;
+	if (len > 0)
+		ad7124_usb_out_write(record, len);
+}
+
+/*!
+ * @brief      Sends whole packets, and a partial one held for longer than
+ *             AD7124_USB_OUT_FLUSH_US
+ *
+ * @details    The stream calls this once per conversion.
+ */
+void ad7124_usb_out_poll(void)
+{
+	if (out_length >= AD7124_USB_OUT_PACKET) {
+		ad7124_usb_out_stats.fill_flushes++;
+		submit(out_length & ~(AD7124_USB_OUT_PACKET - 1));
+	}
+	if (out_length > 0 && time_us_32() - out_pending_since_us > AD7124_USB_OUT_FLUSH_US) {
+		ad7124_usb_out_stats.timer_flushes++;
+		submit(out_length);
+	}
+}
+
+/*!
+ * @brief      Sends everything buffered
+ *
+ * @details    Call before printing through stdio.
+ */
+void ad7124_usb_out_flush(void)
+{
+	if (out_length > 0)
+		submit(out_length);
+}
+
+/*!
+ * @brief      Clears the counters
+ *
+ * @details
+ */
+void ad7124_usb_out_reset_stats(void)
+{
+	memset(&ad7124_usb_out_stats, 0, sizeof(ad7124_usb_out_stats));
+}
+
+/*!
+ * @brief      Prints the counters of the output path
+ *
+ * @details
+ */
+void ad7124_usb_out_print(void)
+{
+	struct ad7124_usb_out_stats *stats = &ad7124_usb_out_stats;
+
+	printf("usb out %lu bytes in %lu flushes (%lu on fill, %lu on timer), %lu bytes per flush, max %lu\r\n",
+	       stats->bytes, stats->flushes, stats->fill_flushes, stats->timer_flushes,
+	       stats->flushes ? stats->bytes / stats->flushes : 0, stats->max_flush_bytes);
+	printf("usb out waits %lu, dropped %lu bytes\r\n", stats->waits, stats->dropped);
+}
@@ -0,0 +1,55 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_usb_out.h
+
+  @brief: Stream output straight to the TinyUSB CDC endpoint, batched into
+          full 64 byte packets
+
+  @details: Records are collected in a buffer and handed to tud_cdc_write()
+            a whole number of packets at a time, the rest waits for more
+            records or for AD7124_USB_OUT_FLUSH_US to pass. This skips the
+            stdio mutex and the flush pico_stdio_usb does after every call.
+            '\n' becomes "\r\n" as on stdio, so the bytes on the wire stay
+            the same. Output through printf() must call
+            ad7124_usb_out_flush() first to keep the order.
+
+            The rate against stdio has not been measured on the target yet,
+            the 'U' menu item measures both paths against the same host.
+            tools/ad7124_usb_out_sim.c checks the bytes and the batching.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_USB_OUT_H_
+#define AD7124_USB_OUT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Full speed bulk packet */
+#define AD7124_USB_OUT_PACKET		64
+#define AD7124_USB_OUT_SIZE		(8 * AD7124_USB_OUT_PACKET)
+/* Longest a partial packet is held, one USB frame */
+#define AD7124_USB_OUT_FLUSH_US		1000
+/* Longest a flush waits for the host, as PICO_STDIO_USB_STDOUT_TIMEOUT_US */
+#define AD7124_USB_OUT_TIMEOUT_US	500000
+
+struct ad7124_usb_out_stats {
+	uint32_t bytes;
+	uint32_t flushes;
+	uint32_t fill_flushes;		/* whole packets, buffer filling up */
+	uint32_t timer_flushes;		/* partial packet held too long */
+	uint32_t max_flush_bytes;
+	uint32_t waits;			/* flushes that found the CDC fifo full */
+	uint32_t dropped;		/* bytes lost, host gone or timed out */
+};
+
+extern struct ad7124_usb_out_stats ad7124_usb_out_stats;
+
+void ad7124_usb_out_write(const char *data, uint32_t len);
+void ad7124_usb_out_printf(const char *format, ...);
+void ad7124_usb_out_poll(void);
+void ad7124_usb_out_flush(void);
+void ad7124_usb_out_reset_stats(void);
+void ad7124_usb_out_print(void);
+
+#endif /* AD7124_USB_OUT_H_ */
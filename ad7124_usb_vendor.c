@@ -0,0 +1,269 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_usb_vendor.c
+
+  @brief: Sample stream on a vendor class bulk endpoint next to the CDC
+          console
+
+  @details: Two frames alternate: one fills while the other waits for room
+            in the endpoint fifo, which holds two frames in flight. A frame
+            that fills while the other still waits is dropped, the next one
+            carries the count. With TinyUSB linked by the application
+            pico_stdio_usb only runs tud_task() from its interrupt because
+            CMakeLists.txt sets PICO_STDIO_USB_ENABLE_IRQ_BACKGROUND_TASK,
+            the calls here mask interrupts around the fifo copy as
+            ad7124_usb_out does.
+ -----------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "tusb.h"
+
+#include "ad7124_usb_frame.h"
+#include "ad7124_usb_vendor.h"
+#include "ad7124_command.h"
+#include "ad7124_trace.h"
+
+struct ad7124_usb_vendor_stats ad7124_usb_vendor_stats;
+
+static struct ad7124_usb_frame frames[2];
+static uint8_t filling = 0;
+static bool waiting[2] = {false, false};
+static uint32_t filling_since_us = 0;
+static uint16_t sequence = 0;
+static uint16_t dropped = 0;
+static uint8_t frame_flags = 0;
+static volatile bool streaming = false;
+
+static void start_frame(struct ad7124_usb_frame *frame)
+{
+	frame->magic = AD7124_USB_FRAME_MAGIC;
+	frame->count = 0;
+	frame->flags = frame_flags;
+}
+
+/* Copies a frame into the endpoint fifo if both fit, the fifo holds two */
+static bool submit(struct ad7124_usb_frame *frame)
+{
+	bool sent = false;
+	uint32_t save;
+
+	save = save_and_disable_interrupts();
+	if (tud_vendor_write_available() >= AD7124_USB_FRAME_SIZE) {
+		tud_vendor_write(frame, AD7124_USB_FRAME_SIZE);
+		tud_vendor_write_flush();
+		sent = true;
+	}
+	restore_interrupts(save);
+	if (sent)
+		ad7124_trace(AD7124_TRACE_OUTPUT, AD7124_USB_FRAME_SIZE);
+	return sent;
+}
+
+/* Sends the frame waiting for room, true when there is none left */
+static bool send_waiting(void)
+{
+	uint8_t other = filling ^ 1;
+
+	if (waiting[other] && submit(&frames[other]))
+		waiting[other] = false;
+	return !waiting[other];
+}
+
+/* Hands the filling frame on and switches to the other one */
+static void complete_frame(void)
+{
+	struct ad7124_usb_frame *frame = &frames[filling];
+	uint8_t other = filling ^ 1;
+
+	// the waiting frame is older and goes first
+	if (!send_waiting()) {
+		ad7124_usb_vendor_stats.dropped += frame->count;
+		// a host that stops reading for long saturates the header count
+		dropped = dropped > UINT16_MAX - frame->count ? UINT16_MAX : dropped + frame->count;
+		start_frame(frame);
+		return;
+	}
+
+	frame->sequence = sequence++;
+	frame->dropped = dropped;
+	dropped = 0;
+	ad7124_usb_vendor_stats.frames++;
+	ad7124_usb_vendor_stats.records += frame->count;
+	if (!submit(frame)) {
+		waiting[filling] = true;
+		ad7124_usb_vendor_stats.held_frames++;
+	}
+	filling = other;
+	start_frame(&frames[filling]);
+}
+
+/* Start and stop requests of the host reader */
+static void read_requests(void)
+{
+	uint8_t request;
+	uint32_t save;
+	uint32_t len;
+
+	if (!tud_vendor_mounted()) {
+		streaming = false;
+		return;
+	}
+	while (true) {
+		save = save_and_disable_interrupts();
+		len = tud_vendor_available() ? tud_vendor_read(&request, 1) : 0;
+		restore_interrupts(save);
+		if (len == 0)
+			break;
+		if (request == AD7124_USB_START) {
+			sequence = 0;
+			dropped = 0;
+			waiting[0] = waiting[1] = false;
+			start_frame(&frames[filling]);
+			streaming = true;
+		} else if (request == AD7124_USB_STOP) {
+			streaming = false;
+		}
+	}
+}
+
+/*!
+ * @brief      Brings up TinyUSB with the composite descriptors
+ *
+ * @details    Must run before stdio_init_all(), pico_stdio_usb expects an
+ *             initialised device when the application links TinyUSB.
+ */
+void ad7124_usb_vendor_init(void)
+{
+	tusb_init();
+	start_frame(&frames[0]);
+}
+
+/*!
+ * @brief      True while the host reader has the stream started
+ *
+ * @details
+ */
+bool ad7124_usb_vendor_streaming(void)
+{
+	return streaming;
+}
+
+/*!
+ * @brief      Adds a sample to the filling frame
+ *
+ * @details    flags takes AD7124_USB_RECORD_LOST.
+ */
+void ad7124_usb_vendor_put(uint32_t timestamp_us, uint8_t channel, int32_t code,
+			   uint8_t flags)
+{
+	struct ad7124_usb_frame *frame = &frames[filling];
+
+	if (frame->count == 0)
+		filling_since_us = timestamp_us;
+	ad7124_usb_record_pack(&frame->records[frame->count++], timestamp_us,
+			       channel, code, flags);
+	if (frame->count == AD7124_USB_FRAME_RECORDS)
+		complete_frame();
+}
+
+/*!
+ * @brief      Retries a waiting frame, sends one held for longer than
+ *             AD7124_USB_VENDOR_FLUSH_US and reads the host's requests
+ *
+ * @details    The stream calls this once per conversion.
+ */
+void ad7124_usb_vendor_poll(void)
+{
+	read_requests();
+	send_waiting();
+	if (frames[filling].count > 0 &&
+	    time_us_32() - filling_since_us > AD7124_USB_VENDOR_FLUSH_US) {
+		ad7124_usb_vendor_stats.early_frames++;
+		complete_frame();
+	}
+}
+
+/*!
+ * @brief      Sends the waiting and the partly filled frame, when the
+ *             stream stops
+ *
+ * @details    Gives the host up to AD7124_USB_VENDOR_STOP_US to take them.
+ */
+void ad7124_usb_vendor_flush(void)
+{
+	uint32_t start = time_us_32();
+
+	if (!streaming)
+		return;
+	while (!send_waiting() && time_us_32() - start < AD7124_USB_VENDOR_STOP_US)
+		tight_loop_contents();
+	if (frames[filling].count > 0) {
+		ad7124_usb_vendor_stats.early_frames++;
+		complete_frame();
+	}
+	while (!send_waiting() && time_us_32() - start < AD7124_USB_VENDOR_STOP_US)
+		tight_loop_contents();
+}
+
+/*!
+ * @brief      Streams a counting pattern as fast as the host takes it,
+ *             until a key is pressed or the host stops
+ *
+ * @details    Four channels, the code counts up by one per record. Measures
+ *             the bulk path on its own, the reader checks the pattern.
+ */
+void ad7124_usb_vendor_test_pattern(void)
+{
+	uint32_t records = 0;
+	uint32_t start;
+	uint32_t elapsed_us;
+
+	read_requests();
+	if (!streaming) {
+		printf("Start the host reader first (tools/ad7124_bulk_reader.c)\r\n");
+		return;
+	}
+	memset(&ad7124_usb_vendor_stats, 0, sizeof(ad7124_usb_vendor_stats));
+	frame_flags = AD7124_USB_FRAME_PATTERN;
+	start_frame(&frames[filling]);
+	printf("Sending the test pattern, any key stops\r\n");
+
+	start = time_us_32();
+	while (streaming && ad7124_command_poll() == AD7124_COMMAND_NONE) {
+		// the pattern waits for the host instead of dropping frames
+		if (!send_waiting()) {
+			read_requests();
+			continue;
+		}
+		ad7124_usb_vendor_put(time_us_32(), records & 3, records & 0xFFFFFF, 0);
+		records++;
+		if ((records & 63) == 0)
+			read_requests();
+	}
+	ad7124_usb_vendor_flush();
+	elapsed_us = time_us_32() - start;
+	frame_flags = 0;
+
+	printf("%lu records in %lu ms, %lu bytes/s\r\n", records, elapsed_us / 1000,
+	       (uint32_t)((uint64_t)ad7124_usb_vendor_stats.frames * AD7124_USB_FRAME_SIZE *
+			  1000000 / elapsed_us));
+	ad7124_usb_vendor_print();
+}
+
+/*!
+ * @brief      Prints the counters of the bulk stream
+ *
+ * @details
+ */
+void ad7124_usb_vendor_print(void)
+{
+	struct ad7124_usb_vendor_stats *stats = &ad7124_usb_vendor_stats;
+
+	printf("usb bulk %lu frames, %lu records, %lu sent early, %lu held, %lu records dropped\r\n",
+	       stats->frames, stats->records, stats->early_frames, stats->held_frames,
+	       stats->dropped);
+}
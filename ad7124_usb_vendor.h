@@ -0,0 +1,60 @@
+/*!
+ *****************************************************************************
+  @file:  ad7124_usb_vendor.h
+
+  @brief: Sample stream on a vendor class bulk endpoint next to the CDC
+          console
+
+  @details: Built with the CMake option AD7124_USB_VENDOR, which replaces
+            the descriptors of pico_stdio_usb with the composite device in
+            usb/. While the host reader has started the stream, samples go
+            out as binary frames (ad7124_usb_frame.h) instead of text rows.
+            Without the option every call compiles away.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef AD7124_USB_VENDOR_H_
+#define AD7124_USB_VENDOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ad7124_usb_frame.h"
+
+#ifndef AD7124_USB_VENDOR
+#define AD7124_USB_VENDOR	0
+#endif
+
+/* Longest a partly filled frame is held */
+#define AD7124_USB_VENDOR_FLUSH_US	2000
+/* Longest the end of a stream waits for the host */
+#define AD7124_USB_VENDOR_STOP_US	100000
+
+#if AD7124_USB_VENDOR
+struct ad7124_usb_vendor_stats {
+	uint32_t frames;
+	uint32_t records;
+	uint32_t early_frames;		/* flushed partly filled */
+	uint32_t held_frames;		/* waited for room in the fifo */
+	uint32_t dropped;		/* records, both frames waiting */
+};
+
+extern struct ad7124_usb_vendor_stats ad7124_usb_vendor_stats;
+
+void ad7124_usb_vendor_init(void);
+bool ad7124_usb_vendor_streaming(void);
+void ad7124_usb_vendor_put(uint32_t timestamp_us, uint8_t channel, int32_t code,
+			   uint8_t flags);
+void ad7124_usb_vendor_poll(void);
+void ad7124_usb_vendor_flush(void);
+void ad7124_usb_vendor_test_pattern(void);
+void ad7124_usb_vendor_print(void);
+#else
+#define ad7124_usb_vendor_init()
+#define ad7124_usb_vendor_streaming()	false
+#define ad7124_usb_vendor_put(timestamp_us, channel, code, flags)
+#define ad7124_usb_vendor_poll()
+#define ad7124_usb_vendor_flush()
+#define ad7124_usb_vendor_print()
+#endif
+
+#endif /* AD7124_USB_VENDOR_H_ */
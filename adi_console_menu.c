@@ -17,9 +17,13 @@ Copyright (c) 2019 Analog Devices, Inc.  All rights reserved.
 #include <ctype.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "adi_console_menu.h"
 
+// Where the menus read their key presses from
+static int (*adi_console_input)(void) = getchar;
+
 
 /*!
  * @brief      displays the text of a console menu
@@ -83,7 +87,7 @@ int32_t adi_do_console_menu(const console_menu * menu)
 	 *  user presses a valid menu option.
 	 */
 	do {
-		char keyPressed = toupper(getchar());
+		char keyPressed = toupper(adi_console_input());
 
 		if (menu->enableEscapeKey)
 		{
@@ -161,5 +165,76 @@ void adi_clear_console(void)
 void adi_press_any_key_to_continue(void)
 {
     printf("\r\nPress any key to continue...\r\n");
-	getchar();
+	adi_console_input();
+}
+
+
+
+/*!
+ * @brief      Reads a signed decimal number typed on the console
+ *
+ * @details    Characters are echoed, backspace edits, enter finishes. At most
+ *             input_len characters are accepted.
+ */
+int32_t adi_get_decimal_int(uint8_t input_len)
+{
+	char buf[12] = {0};
+	uint8_t count = 0;
+	int key;
+
+	if (input_len >= sizeof(buf))
+		input_len = sizeof(buf) - 1;
+
+	while ((key = adi_console_input()) != '\r' && key != '\n') {
+		if ((key == '\b' || key == 0x7F) && count > 0) {
+			count--;
+			printf("\b \b");
+		} else if (count < input_len &&
+			   (isdigit(key) || (key == '-' && count == 0))) {
+			buf[count++] = (char)key;
+			putchar(key);
+		}
+	}
+	buf[count] = '\0';
+	printf("\r\n");
+
+	return atol(buf);
+}
+
+
+/*!
+ * @brief      Reads a line of printable characters typed on the console
+ *
+ * @details    Characters are echoed, backspace edits, enter finishes. The
+ *             result is always terminated, the length is returned.
+ */
+uint16_t adi_get_line(char *buf, uint16_t buf_len)
+{
+	uint16_t count = 0;
+	int key;
+
+	while ((key = adi_console_input()) != '\r' && key != '\n') {
+		if ((key == '\b' || key == 0x7F) && count > 0) {
+			count--;
+			printf("\b \b");
+		} else if (count + 1 < buf_len && isprint(key)) {
+			buf[count++] = (char)key;
+			putchar(key);
+		}
+	}
+	buf[count] = '\0';
+	printf("\r\n");
+
+	return count;
+}
+
+/*!
+ * @brief      Sets the function the menus use to wait for a key press
+ *
+ * @details    Lets the application read from its own input queue instead
+ *             of competing with stdio.
+ */
+void adi_console_set_input(int (*input)(void))
+{
+	adi_console_input = input;
 }
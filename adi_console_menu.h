@@ -54,5 +54,9 @@ typedef struct{
 int32_t adi_do_console_menu(const console_menu * menu);
 void adi_clear_console(void);
 void adi_press_any_key_to_continue(void);
+int32_t adi_get_decimal_int(uint8_t input_len);
+uint16_t adi_get_line(char *buf, uint16_t buf_len);
+/* Replace the blocking character source of the menus, getchar() by default */
+void adi_console_set_input(int (*input)(void));
 
 #endif /* ADI_CONSOLE_MENU_H_ */
@@ -14,7 +14,7 @@ Copyright (c) 2019 Analog Devices, Inc.
 #define boardname "BALANCEBOARD03"
 #define filterFS 44
 
-const struct ad7124_st_reg ad7124_regs_config_a[AD7124_REG_NO] = {
+AD7124_CONFIG_CONST struct ad7124_st_reg ad7124_regs_config_a[AD7124_REG_NO] = {
     {0x00, 0x00,   1, 2}, /* AD7124_Status */
 	{0x01, AD7124_ADC_CTRL_REG_MODE(2) | AD7124_ADC_CTRL_REG_POWER_MODE(3) | AD7124_ADC_CTRL_REG_CLK_SEL(3), 2, 1}, /* AD7124_ADC_Control */
 	{0x02, 0x0000, 3, 2}, /* AD7124_Data */
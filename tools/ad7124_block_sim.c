@@ -0,0 +1,139 @@
+/*
+ * Host loopback of the sample blocks between a stream and a slow consumer.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -o ad7124_block_sim \
+ *         tools/ad7124_block_sim.c ad7124_block.c
+ *
+ * Usage:
+ *     ad7124_block_sim [--scans N] [--seed N]
+ *
+ * A stream of 8 channels (mask 0F0F) writes a row every 100 us through
+ * ad7124_block_row() and ad7124_block_put(), with one conversion in 50
+ * stored as lost. Each code tells its row and channel. The consumer runs
+ * in bursts and falls behind for most of every 5000 rows, so the producer
+ * has to drop blocks. Every acquired block is checked against the rows it
+ * should hold: codes, validity bits and timestamps. The gaps in the
+ * sequence numbers must add up to the drop count, and the ring must never
+ * hold more than two blocks. Exits nonzero on the first mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ad7124_block.h"
+#include "ad7124_stats.h"
+
+#define SIM_MASK	0x0F0F
+#define SIM_SCAN_US	100
+#define SIM_LOST_ONE_IN	50
+
+struct ad7124_stats_core ad7124_stats_cores[AD7124_STATS_CORES];
+static uint32_t now_us;
+/* Validity of every conversion written, bit per channel */
+static uint16_t *written_valid;
+
+uint32_t time_us_32(void)
+{
+	return now_us;
+}
+
+uint get_core_num(void)
+{
+	return 0;
+}
+
+static int32_t code_of(long row, uint8_t ch)
+{
+	return (int32_t)(row * AD7124_BLOCK_CHANNELS + ch);
+}
+
+static int check_block(const struct ad7124_block *block, long *checked)
+{
+	for (uint8_t s = 0; s < block->scans; s++) {
+		long row = block->timestamp_us[s] / SIM_SCAN_US - 1;
+
+		for (uint8_t ch = 0; ch < AD7124_BLOCK_CHANNELS; ch++) {
+			bool valid = block->valid[ch] & (1u << s);
+
+			if (!(SIM_MASK & (1 << ch)))
+				continue;
+			if (block->codes[ch][s] != code_of(row, ch) ||
+			    valid != !!(written_valid[row] & (1 << ch))) {
+				printf("block %u scan %u channel %u: code %ld valid %d, row %ld\n",
+				       block->sequence, s, ch, (long)block->codes[ch][s], valid, row);
+				return 1;
+			}
+			(*checked)++;
+		}
+	}
+	return 0;
+}
+
+/* Takes every published block, returns nonzero on a mismatch */
+static int consume(uint32_t *expected_sequence, long *gaps, long *checked)
+{
+	const struct ad7124_block *block;
+
+	while ((block = ad7124_block_acquire())) {
+		*gaps += block->sequence - *expected_sequence;
+		*expected_sequence = block->sequence + 1;
+		if (check_block(block, checked))
+			return 1;
+		ad7124_block_release();
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long scans = 200000, gaps = 0, checked = 0;
+	uint32_t expected_sequence = 0, high_water;
+	unsigned seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--scans") == 0 && i + 1 < argc)
+			scans = atol(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--scans N] [--seed N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(seed);
+	written_valid = calloc(scans, sizeof(*written_valid));
+	ad7124_block_enable(true);
+	ad7124_block_start(SIM_MASK);
+	for (long row = 0; row < scans; row++) {
+		now_us += SIM_SCAN_US;
+		ad7124_block_row(now_us);
+		for (uint8_t ch = 0; ch < AD7124_BLOCK_CHANNELS; ch++) {
+			bool valid = rand() % SIM_LOST_ONE_IN != 0;
+
+			if (!(SIM_MASK & (1 << ch)))
+				continue;
+			if (valid)
+				written_valid[row] |= 1 << ch;
+			ad7124_block_put(ch, code_of(row, ch), valid);
+		}
+		// in bursts, and behind for most of every 5000 rows
+		if ((rand() % 40 == 0 || row % 5000 > 1000) &&
+		    consume(&expected_sequence, &gaps, &checked))
+			return 1;
+	}
+	// the partial block of a stream that stopped
+	ad7124_block_flush();
+	if (consume(&expected_sequence, &gaps, &checked))
+		return 1;
+
+	high_water = ad7124_stats_cores[0].queue_high_water;
+	printf("%ld scans, %u blocks completed, %u dropped, %ld missing in the sequence\n",
+	       scans, ad7124_blocks.completed, ad7124_blocks.dropped, gaps);
+	printf("%ld codes checked, ring high water %u, block %zu bytes\n", checked, high_water,
+	       sizeof(struct ad7124_block));
+	return gaps != ad7124_blocks.dropped || high_water > AD7124_BLOCK_BUFFERS - 1;
+}
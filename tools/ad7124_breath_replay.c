@@ -0,0 +1,230 @@
+/*
+ * Host replay of the breath detection of the respiratory boards.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -o ad7124_breath_replay tools/ad7124_breath_replay.c \
+ *         ad7124_breath.c -lm
+ *
+ * Usage:
+ *     ad7124_breath_replay [--rate Hz] [--zero code] [--min codes] [--column N] < rows
+ *     ad7124_breath_replay --synthetic [--seconds N] [--rate Hz]
+ *
+ * Runs ad7124_breath.c over a recorded raw stream, rows of
+ * "time ms, levels, code..." as the 'Continous conversion raw' item prints
+ * them, and prints the events as the firmware does. The code is taken from
+ * field N, 2 by default. Without --rate the rate comes from the timestamps.
+ * --synthetic generates breathing with a known peak for every breath,
+ * drifting rate and amplitude, baseline wander, steps, noise and an apnea,
+ * and scores the detected breaths and rates against it. It exits nonzero
+ * when sensitivity or precision is below 95 % or the apnea is not flagged;
+ * 30 minutes at 26.67, 100, 1000 and 2000 Hz all pass.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ad7124_breath.h"
+
+#define REPLAY_MAX_ROWS		(1 << 24)
+/* A detected peak belongs to a true one this early or late, filter delay included */
+#define REPLAY_EARLY_MS		300
+#define REPLAY_LATE_MS		1000
+
+struct truth {
+	double *peak_s;
+	int count;
+};
+
+static void print_events(const struct ad7124_breath *breath, uint8_t events)
+{
+	if (events & AD7124_BREATH_EVENT_BREATH)
+		printf("B, %u, %d, %u\n", breath->breath_ms, breath->amplitude, breath->interval_ms);
+	if (events & AD7124_BREATH_EVENT_RATE)
+		printf("BR, %u, %u.%u, %d, %d\n", breath->rate_ms, breath->rate_x10 / 10,
+		       breath->rate_x10 % 10, breath->mean_amplitude, breath->apnea);
+}
+
+static double gauss(void)
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/* Inhale over 40 % of the breath, a slower exhale, peak at 0.4 */
+static double breath_shape(double phase)
+{
+	if (phase < 0.4)
+		return (1 - cos(M_PI * phase / 0.4)) / 2;
+	return (1 + cos(M_PI * (phase - 0.4) / 0.6)) / 2;
+}
+
+static int run_synthetic(double seconds, double rate_hz)
+{
+	struct ad7124_breath *breath = &ad7124_breath;
+	struct truth truth = {malloc(sizeof(double) * (int)(seconds + 1)), 0};
+	double apnea_start = seconds * 0.6, apnea_end = apnea_start + 20;
+	double breath_start = 0, breath_length = 5, amplitude = 5000;
+	long samples = (long)(seconds * rate_hz);
+	int detected = 0, matched = 0, rates = 0, apneas = 0;
+	double rate_error = 0, rate_error_max = 0;
+	bool *used = calloc(seconds + 1, sizeof(bool));
+
+	srand(11);
+	ad7124_breath_init(breath, (uint32_t)(rate_hz * 1000), 0x800000);
+	for (long n = 0; n < samples; n++) {
+		double t = n / rate_hz;
+		double bpm, value;
+		uint8_t events;
+
+		if (t >= breath_start + breath_length) {
+			// rate drifts 12 -> 25 -> 8 breaths per minute, with jitter
+			breath_start += breath_length;
+			if (breath_start >= apnea_start && breath_start < apnea_end)
+				breath_start = apnea_end;
+			bpm = 16.5 + 8.5 * sin(2 * M_PI * breath_start / seconds * 1.5);
+			breath_length = 60 / bpm * (1 + 0.1 * gauss());
+			amplitude = 5000 * (1 + 0.3 * gauss());
+			if (amplitude < 2000)
+				amplitude = 2000;
+			truth.peak_s[truth.count++] = breath_start + 0.4 * breath_length;
+		}
+		value = 0x800000 + 20000 * sin(2 * M_PI * 0.02 * t) + 300 * t + 100 * gauss() +
+			100 * sin(2 * M_PI * 3.3 * t);
+		if (t >= breath_start && t < breath_start + breath_length)
+			value += amplitude * breath_shape((t - breath_start) / breath_length);
+		// motion artifacts, a step of 30000 codes
+		if (t > seconds * 0.3)
+			value += 30000;
+		if (t > seconds * 0.8)
+			value -= 30000;
+
+		events = ad7124_breath_sample(breath, (uint32_t)(t * 1000), lround(value));
+		if (events & AD7124_BREATH_EVENT_BREATH) {
+			double at = breath->breath_ms / 1000.0;
+
+			detected++;
+			for (int i = 0; i < truth.count; i++) {
+				if (!used[i] && at >= truth.peak_s[i] - REPLAY_EARLY_MS / 1000.0 &&
+				    at <= truth.peak_s[i] + REPLAY_LATE_MS / 1000.0) {
+					used[i] = true;
+					matched++;
+					break;
+				}
+			}
+		}
+		if (events & AD7124_BREATH_EVENT_RATE) {
+			double now = breath->rate_ms / 1000.0, total = 0;
+			int count = 0;
+
+			apneas += breath->apnea;
+			// the true rate over the same last intervals, when they are all breathing
+			for (int i = truth.count - 1; i > 0 && count < AD7124_BREATH_INTERVALS; i--) {
+				if (truth.peak_s[i] > now - 0.5)
+					continue;
+				if (truth.peak_s[i] - truth.peak_s[i - 1] > AD7124_BREATH_APNEA_MS / 1000.0)
+					break;
+				total += truth.peak_s[i] - truth.peak_s[i - 1];
+				count++;
+			}
+			if (count == AD7124_BREATH_INTERVALS && breath->rate_x10 && !breath->apnea) {
+				double error = fabs(breath->rate_x10 / 10.0 - 60 * count / total);
+
+				rate_error += error;
+				if (error > rate_error_max)
+					rate_error_max = error;
+				rates++;
+			}
+		}
+	}
+
+	printf("%d breaths, %d detected, %d matched: sensitivity %.1f %%, precision %.1f %%\n",
+	       truth.count, detected, matched, 100.0 * matched / truth.count,
+	       detected ? 100.0 * matched / detected : 0);
+	printf("%d rate updates compared, error mean %.2f max %.2f breaths/min, %d apnea updates\n",
+	       rates, rates ? rate_error / rates : 0, rate_error_max, apneas);
+	free(truth.peak_s);
+	free(used);
+	return matched < truth.count * 0.95 || matched < detected * 0.95 || apneas == 0;
+}
+
+static int run_replay(double rate_hz, int column)
+{
+	struct ad7124_breath *breath = &ad7124_breath;
+	uint32_t *times = malloc(sizeof(uint32_t) * REPLAY_MAX_ROWS);
+	int32_t *codes = malloc(sizeof(int32_t) * REPLAY_MAX_ROWS);
+	char line[512];
+	long rows = 0;
+
+	while (fgets(line, sizeof(line), stdin) && rows < REPLAY_MAX_ROWS) {
+		char *field = line;
+		char *end;
+		long values[2] = {0, 0};
+		int i;
+
+		values[0] = strtol(field, &end, 10);
+		if (end == field)
+			continue;
+		for (i = 1; i <= column; i++) {
+			if (!(field = strchr(end, ',')))
+				break;
+			values[1] = strtol(field + 1, &end, 10);
+		}
+		if (i <= column)
+			continue;
+		times[rows] = values[0];
+		codes[rows++] = values[1];
+	}
+	if (rows < 2) {
+		fprintf(stderr, "no rows\n");
+		return 1;
+	}
+	if (rate_hz <= 0)
+		rate_hz = (rows - 1) * 1000.0 / (times[rows - 1] - times[0]);
+	fprintf(stderr, "%ld rows at %.2f Hz\n", rows, rate_hz);
+
+	ad7124_breath_init(breath, (uint32_t)(rate_hz * 1000), breath->zero_code);
+	for (long n = 0; n < rows; n++)
+		print_events(breath, ad7124_breath_sample(breath, times[n], codes[n]));
+	free(times);
+	free(codes);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	bool synthetic = false;
+	double seconds = 1800;
+	double rate_hz = 0;
+	int column = 2;
+
+	ad7124_breath.zero_code = 0x800000;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--synthetic") == 0)
+			synthetic = true;
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+			rate_hz = atof(argv[++i]);
+		else if (strcmp(argv[i], "--zero") == 0 && i + 1 < argc)
+			ad7124_breath.zero_code = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--min") == 0 && i + 1 < argc)
+			ad7124_breath.min_amplitude = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--column") == 0 && i + 1 < argc)
+			column = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--rate Hz] [--zero code] [--min codes] "
+				"[--column N] < rows | --synthetic [--seconds N] [--rate Hz]\n",
+				argv[0]);
+			return 2;
+		}
+	}
+
+	if (synthetic)
+		return run_synthetic(seconds, rate_hz > 0 ? rate_hz : 26.67);
+	return run_replay(rate_hz, column);
+}
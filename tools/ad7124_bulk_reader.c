@@ -0,0 +1,300 @@
+/*
+ * Host reader of the vendor bulk sample stream (AD7124_USB_VENDOR builds).
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -o ad7124_bulk_reader tools/ad7124_bulk_reader.c \
+ *         $(pkg-config --cflags --libs libusb-1.0)
+ *
+ * Usage:
+ *     ad7124_bulk_reader [--csv] [--seconds N] [--serial S]
+ *     ad7124_bulk_reader --loopback [--seconds N]
+ *
+ * Starts the stream, keeps AD7124_BULK_TRANSFERS transfers queued on the IN
+ * endpoint and checks frame sequence numbers, dropped records and the test
+ * pattern of the 'USB bulk test pattern' menu item. Rates go to stderr once
+ * a second, samples to stdout as "timestamp_us,channel,code,lost" with
+ * --csv and input edges as "timestamp_us,E,pin,levels". --loopback packs
+ * frames in this process instead, to test the frame code and the checks
+ * without a board.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libusb.h>
+
+#include "ad7124_usb_frame.h"
+
+/* Queued transfers and frames per transfer, 64 KiB in flight */
+#define AD7124_BULK_TRANSFERS	8
+#define AD7124_BULK_FRAMES	16
+#define AD7124_BULK_TIMEOUT_MS	1000
+
+struct reader {
+	bool csv;
+	bool started;
+	int in_flight;
+	uint16_t next_sequence;
+	uint32_t next_pattern;
+	unsigned long frames, records, edges, lost, dropped, sequence_gaps, pattern_errors;
+	unsigned long bad_frames;
+	unsigned long bytes, second_bytes;
+	double second_start;
+};
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void check_frame(struct reader *r, const struct ad7124_usb_frame *frame)
+{
+	if (frame->magic != AD7124_USB_FRAME_MAGIC || frame->count > AD7124_USB_FRAME_RECORDS) {
+		r->bad_frames++;
+		return;
+	}
+	if (r->started && frame->sequence != r->next_sequence)
+		r->sequence_gaps += (uint16_t)(frame->sequence - r->next_sequence);
+	r->started = true;
+	r->next_sequence = frame->sequence + 1;
+	r->dropped += frame->dropped;
+	r->frames++;
+
+	for (uint8_t i = 0; i < frame->count; i++) {
+		const struct ad7124_usb_record *record = &frame->records[i];
+		int32_t code = ad7124_usb_record_code(record);
+		bool lost = record->channel & AD7124_USB_RECORD_LOST;
+
+		if (record->channel & AD7124_USB_RECORD_EDGE) {
+			r->edges++;
+			if (r->csv)
+				printf("%u,E,%u,%d\n", record->timestamp_us,
+				       record->channel & AD7124_USB_RECORD_CHANNEL, code);
+			continue;
+		}
+		if (frame->flags & AD7124_USB_FRAME_PATTERN) {
+			// the code counts up by one per record, the channel with it
+			if (r->records && (uint32_t)code != r->next_pattern)
+				r->pattern_errors++;
+			r->next_pattern = (code + 1) & 0xFFFFFF;
+		}
+		r->lost += lost;
+		if (r->csv)
+			printf("%u,%u,%d,%d\n", record->timestamp_us,
+			       record->channel & AD7124_USB_RECORD_CHANNEL, code, lost);
+		r->records++;
+	}
+}
+
+static void take_bytes(struct reader *r, const uint8_t *data, int len)
+{
+	double now;
+
+	for (int i = 0; i + AD7124_USB_FRAME_SIZE <= len; i += AD7124_USB_FRAME_SIZE)
+		check_frame(r, (const struct ad7124_usb_frame *)(data + i));
+	r->bytes += len;
+	r->second_bytes += len;
+
+	now = now_s();
+	if (now - r->second_start >= 1.0) {
+		fprintf(stderr, "%9.0f bytes/s, %lu frames, %lu records, %lu edges, gaps %lu, "
+			"dropped %lu, pattern errors %lu\n",
+			r->second_bytes / (now - r->second_start), r->frames, r->records,
+			r->edges, r->sequence_gaps, r->dropped, r->pattern_errors);
+		r->second_bytes = 0;
+		r->second_start = now;
+	}
+}
+
+/* Frames of the test pattern packed here, as the firmware packs them */
+static void run_loopback(struct reader *r, double seconds)
+{
+	static struct ad7124_usb_frame frames[AD7124_BULK_FRAMES];
+	uint32_t code = 0;
+	uint16_t sequence = 0;
+	double start = now_s();
+
+	while (!stop && now_s() - start < seconds) {
+		for (int f = 0; f < AD7124_BULK_FRAMES; f++) {
+			struct ad7124_usb_frame *frame = &frames[f];
+
+			frame->magic = AD7124_USB_FRAME_MAGIC;
+			frame->sequence = sequence++;
+			frame->count = AD7124_USB_FRAME_RECORDS;
+			frame->flags = AD7124_USB_FRAME_PATTERN;
+			frame->dropped = 0;
+			for (int i = 0; i < AD7124_USB_FRAME_RECORDS; i++, code++)
+				ad7124_usb_record_pack(&frame->records[i], code * 10, code & 3,
+						       code & 0xFFFFFF, 0);
+		}
+		take_bytes(r, (const uint8_t *)frames, sizeof(frames));
+	}
+}
+
+static void LIBUSB_CALL transfer_done(struct libusb_transfer *transfer)
+{
+	struct reader *r = transfer->user_data;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED)
+		take_bytes(r, transfer->buffer, transfer->actual_length);
+	else if (transfer->status != LIBUSB_TRANSFER_TIMED_OUT)
+		stop = 1;
+	if (stop || libusb_submit_transfer(transfer) < 0) {
+		stop = 1;
+		r->in_flight--;
+	}
+}
+
+static libusb_device_handle *open_stream(libusb_context *usb, const char *serial,
+					 int *interface)
+{
+	libusb_device **list;
+	libusb_device_handle *handle = NULL;
+	ssize_t count = libusb_get_device_list(usb, &list);
+
+	for (ssize_t d = 0; d < count && !handle; d++) {
+		struct libusb_device_descriptor desc;
+		struct libusb_config_descriptor *config;
+		unsigned char text[64];
+
+		if (libusb_get_device_descriptor(list[d], &desc) < 0 ||
+		    desc.idVendor != AD7124_USB_VID || desc.idProduct != AD7124_USB_PID)
+			continue;
+		if (libusb_open(list[d], &handle) < 0) {
+			handle = NULL;
+			continue;
+		}
+		if (serial && (libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber,
+								  text, sizeof(text)) < 0 ||
+			       strcmp((char *)text, serial) != 0)) {
+			libusb_close(handle);
+			handle = NULL;
+			continue;
+		}
+		// the stdio only firmware has no vendor interface
+		*interface = -1;
+		if (libusb_get_active_config_descriptor(list[d], &config) == 0) {
+			for (int i = 0; i < config->bNumInterfaces; i++) {
+				if (config->interface[i].altsetting[0].bInterfaceClass ==
+				    LIBUSB_CLASS_VENDOR_SPEC)
+					*interface = config->interface[i].altsetting[0].bInterfaceNumber;
+			}
+			libusb_free_config_descriptor(config);
+		}
+		if (*interface < 0 || libusb_claim_interface(handle, *interface) < 0) {
+			libusb_close(handle);
+			handle = NULL;
+		}
+	}
+	libusb_free_device_list(list, 1);
+	return handle;
+}
+
+static int run_device(struct reader *r, double seconds, const char *serial)
+{
+	struct libusb_transfer *transfers[AD7124_BULK_TRANSFERS];
+	libusb_context *usb;
+	libusb_device_handle *handle;
+	unsigned char request;
+	int interface;
+	int sent;
+	double start;
+
+	if (libusb_init(&usb) < 0)
+		return 1;
+	if (!(handle = open_stream(usb, serial, &interface))) {
+		fprintf(stderr, "no board with the vendor stream interface found\n");
+		libusb_exit(usb);
+		return 1;
+	}
+
+	for (int t = 0; t < AD7124_BULK_TRANSFERS; t++) {
+		transfers[t] = libusb_alloc_transfer(0);
+		libusb_fill_bulk_transfer(transfers[t], handle, AD7124_USB_EP_IN,
+					  malloc(AD7124_BULK_FRAMES * AD7124_USB_FRAME_SIZE),
+					  AD7124_BULK_FRAMES * AD7124_USB_FRAME_SIZE,
+					  transfer_done, r, AD7124_BULK_TIMEOUT_MS);
+		if (libusb_submit_transfer(transfers[t]) == 0)
+			r->in_flight++;
+	}
+	request = AD7124_USB_START;
+	libusb_bulk_transfer(handle, AD7124_USB_EP_OUT, &request, 1, &sent,
+			     AD7124_BULK_TIMEOUT_MS);
+
+	start = now_s();
+	while (!stop && (seconds <= 0 || now_s() - start < seconds))
+		libusb_handle_events(usb);
+
+	request = AD7124_USB_STOP;
+	libusb_bulk_transfer(handle, AD7124_USB_EP_OUT, &request, 1, &sent,
+			     AD7124_BULK_TIMEOUT_MS);
+	stop = 1;
+	for (int t = 0; t < AD7124_BULK_TRANSFERS; t++)
+		libusb_cancel_transfer(transfers[t]);
+	// the callbacks of the cancelled transfers run before they are freed
+	while (r->in_flight > 0)
+		libusb_handle_events(usb);
+	for (int t = 0; t < AD7124_BULK_TRANSFERS; t++) {
+		free(transfers[t]->buffer);
+		libusb_free_transfer(transfers[t]);
+	}
+	libusb_release_interface(handle, interface);
+	libusb_close(handle);
+	libusb_exit(usb);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct reader r;
+	bool loopback = false;
+	double seconds = 0;
+	const char *serial = NULL;
+	double start;
+	int ret = 0;
+
+	memset(&r, 0, sizeof(r));
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--csv") == 0)
+			r.csv = true;
+		else if (strcmp(argv[i], "--loopback") == 0)
+			loopback = true;
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--serial") == 0 && i + 1 < argc)
+			serial = argv[++i];
+		else {
+			fprintf(stderr, "usage: %s [--csv] [--seconds N] [--serial S] | "
+				"--loopback [--seconds N]\n", argv[0]);
+			return 2;
+		}
+	}
+	signal(SIGINT, on_signal);
+
+	start = r.second_start = now_s();
+	if (loopback)
+		run_loopback(&r, seconds > 0 ? seconds : 1);
+	else
+		ret = run_device(&r, seconds, serial);
+
+	fprintf(stderr, "total %lu bytes in %.1f s (%.0f bytes/s), %lu frames, %lu records, "
+		"%lu edges, %lu lost, gaps %lu, dropped %lu, pattern errors %lu, bad frames %lu\n",
+		r.bytes, now_s() - start, r.bytes / (now_s() - start), r.frames, r.records,
+		r.edges, r.lost, r.sequence_gaps, r.dropped, r.pattern_errors, r.bad_frames);
+	return ret || r.sequence_gaps || r.pattern_errors || r.bad_frames;
+}
@@ -0,0 +1,143 @@
+/*
+ * Host model of the wall time of the 'Z' calibration.
+ *
+ * Build from the repository root, with the board's register map:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -DSIM_CONFIG='"config.stella.h"' \
+ *         -o ad7124_calibration_time tools/ad7124_calibration_time.c \
+ *         ad7124_calibration_plan.c
+ *
+ * Usage:
+ *     ad7124_calibration_time [--full-scale-periods N]
+ *
+ * Counts the register writes, console lines and calibrations of
+ * do_fullscale_calibration() for the board's map and for two variants of
+ * it, 8 channels on 2 setups and 16 channels on setup 0. Three sequences
+ * are compared: the old channel by channel loop, which did zero-scale only,
+ * and the plan of ad7124_calibration_plan() with zero-scale only and with
+ * the internal full-scale calibration added. A calibration takes one
+ * settling period of the slow filter the calibration writes, FS 1024 sinc4
+ * in mid power; --full-scale-periods changes the periods the internal
+ * full-scale calibration is modelled with. Exits nonzero if the plan takes
+ * longer than the loop for the same calibrations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ad7124_calibration_plan.h"
+#ifndef SIM_CONFIG
+#define SIM_CONFIG "configuration.h"
+#endif
+#include SIM_CONFIG
+
+/* Register write of 4 bytes at 500 kHz with the driver overhead, console line */
+#define SIM_WRITE_US		74.0
+#define SIM_LINE_US		50.0
+/* Mid power master clock and the filter set_slow_filters() writes */
+#define SIM_MCLK_MID_HZ		153600.0
+#define SIM_CAL_FS		1024
+
+static double full_scale_periods = 1;
+
+static double settling_us(void)
+{
+	return (4 * 32.0 * SIM_CAL_FS + 95) / SIM_MCLK_MID_HZ * 1e6;
+}
+
+static int enabled_channels(const struct ad7124_st_reg *regs)
+{
+	int n = 0;
+
+	for (int ch = 0; ch < 16; ch++)
+		n += !!(regs[AD7124_Channel_0 + ch].value & AD7124_CH_MAP_REG_CH_ENABLE);
+	return n;
+}
+
+/*
+ * The loop before the plan: offsets and filters of all 8 setups, a console
+ * line for every channel switch and a zero-scale calibration per channel
+ */
+static double channel_loop_us(const struct ad7124_st_reg *regs)
+{
+	int n = enabled_channels(regs);
+	double us = 8 * SIM_WRITE_US;
+
+	us += n * (SIM_WRITE_US + SIM_LINE_US);		// disable
+	us += 8 * SIM_WRITE_US;				// slow filters
+	us += n * (2 * (SIM_WRITE_US + SIM_LINE_US) +	// enable, disable
+		   SIM_WRITE_US + SIM_LINE_US + settling_us());
+	us += 8 * SIM_WRITE_US;				// filters back
+	us += n * (SIM_WRITE_US + SIM_LINE_US);		// enable
+	return us + SIM_WRITE_US;			// idle
+}
+
+/* The planned sequence, offsets and filters of the planned setups only */
+static double plan_us(const struct ad7124_st_reg *regs, uint8_t modes, uint8_t *step_count)
+{
+	struct ad7124_calibration_step steps[AD7124_CAL_STEPS];
+	int n = enabled_channels(regs);
+	uint8_t k = ad7124_calibration_plan(regs, modes, steps);
+	double us = k * SIM_WRITE_US + n * SIM_WRITE_US + k * SIM_WRITE_US;
+
+	for (uint8_t s = 0; s < k; s++) {
+		us += 2 * SIM_WRITE_US;
+		if (steps[s].modes & AD7124_CAL_INTERNAL_FULL_SCALE)
+			us += SIM_WRITE_US + SIM_LINE_US + full_scale_periods * settling_us();
+		if (steps[s].modes & AD7124_CAL_SYSTEM_ZERO_SCALE)
+			us += SIM_WRITE_US + SIM_LINE_US + settling_us();
+	}
+	*step_count = k;
+	return us + k * SIM_WRITE_US + n * SIM_WRITE_US + SIM_WRITE_US;
+}
+
+static int run(const char *name, const struct ad7124_st_reg *regs)
+{
+	uint8_t zero_steps, both_steps;
+	double loop = channel_loop_us(regs);
+	double zero = plan_us(regs, AD7124_CAL_SYSTEM_ZERO_SCALE, &zero_steps);
+	double both = plan_us(regs, AD7124_CAL_SYSTEM_ZERO_SCALE |
+			      AD7124_CAL_INTERNAL_FULL_SCALE, &both_steps);
+
+	printf("%-26s %2d channels: loop %6.2f s, plan %6.2f s zero-scale, %6.2f s with "
+	       "full-scale, %u setups\n", name, enabled_channels(regs), loop / 1e6,
+	       zero / 1e6, both / 1e6, zero_steps);
+	return zero > loop;
+}
+
+/* n channels of the board's first setup spread round robin over setups */
+static void spread(struct ad7124_st_reg *regs, int n, int setups)
+{
+	int32_t channel = ad7124_regs_config_a[AD7124_Channel_0].value &
+			  ~AD7124_CH_MAP_REG_SETUP(0x7);
+
+	memcpy(regs, ad7124_regs_config_a, sizeof(ad7124_regs_config_a));
+	for (int ch = 0; ch < 16; ch++)
+		regs[AD7124_Channel_0 + ch].value = ch < n ?
+			channel | AD7124_CH_MAP_REG_SETUP(ch % setups) : 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct ad7124_st_reg regs[AD7124_REG_NO];
+	int failed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--full-scale-periods") == 0 && i + 1 < argc)
+			full_scale_periods = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--full-scale-periods N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	printf("calibration %.1f ms, write %.0f us, console line %.0f us\n",
+	       settling_us() / 1000, SIM_WRITE_US, SIM_LINE_US);
+	memcpy(regs, ad7124_regs_config_a, sizeof(ad7124_regs_config_a));
+	failed |= run(boardname, regs);
+	spread(regs, 8, 2);
+	failed |= run("8 channels on 2 setups", regs);
+	spread(regs, 16, 1);
+	failed |= run("16 channels on 1 setup", regs);
+	return failed;
+}
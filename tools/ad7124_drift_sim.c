@@ -0,0 +1,342 @@
+/*
+ * Host model of the drift probe in a continuous stream.
+ *
+ * Build from the repository root, with the board's register map:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -DSIM_CONFIG='"config.stella.h"' \
+ *         -o ad7124_drift_sim tools/ad7124_drift_sim.c ad7124_drift.c \
+ *         ad7124_sequencer.c -lm
+ *
+ * Usage:
+ *     ad7124_drift_sim [--seconds N] [--interval SCANS] [--fs N] [--stall-us N]
+ *                      [--restart 0|1] [--seed N]
+ *
+ * The device converts the enabled channels of the map in turn, each in the
+ * settling time of its filter, and the data register holds the last result.
+ * A write to a channel register either restarts the sequence at the lowest
+ * enabled channel, dropping the conversion in progress and a finished one
+ * not yet read, as the datasheet describes for register writes in
+ * continuous mode (--restart 1), or only changes the channels converted
+ * from the next one on (--restart 0). Without --restart both are run.
+ * The stream is the loop of do_continuous_conversion(): it polls, reads,
+ * works 100 to 400 us per sample plus, one sample in 200, a stall of
+ * --stall-us (default 2000) for a full USB fifo, and enables and disables
+ * the probe through ad7124_drift and ad7124_sequencer the way the firmware
+ * does, counting missed[] with drift_probe_write()'s STATUS check.
+ * Every setup's offset ramps at 0.5 codes/s times the setup number plus one.
+ *
+ * Printed per run: conversions lost, those the stream counted in missed[],
+ * conversions restarted, finished ones a write dropped, the scan rate
+ * against a run without probes, and per setup the mean error of the
+ * corrected samples over the last quarter next to the lag of the 1/8 low
+ * pass on the ramp. Exits nonzero if missed[] differs from the conversions
+ * lost or the error is off the lag by more than a code and 10 %; with a
+ * fast --fs overruns of whole scans and writes just after the STATUS read
+ * lose conversions missed[] cannot count.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ad7124_drift.h"
+#include "ad7124_sequencer.h"
+#ifndef SIM_CONFIG
+#define SIM_CONFIG "configuration.h"
+#endif
+#include SIM_CONFIG
+
+/* Bus times, the poll interval and the work per sample of the loop */
+#define SIM_READ_US		40.0
+#define SIM_WRITE_US		74.0
+#define SIM_POLL_US		30.0
+#define SIM_WORK_MIN_US		100.0
+#define SIM_WORK_MAX_US		400.0
+#define SIM_STALL_EVERY		200
+/* Offset ramp of setup s: (s + 1) * SIM_RAMP codes per second */
+#define SIM_RAMP		0.5
+#define SIM_NOISE		1.0
+#define SIM_SIGNAL		0x800000
+
+static const double mclk_hz[4] = {76800, 153600, 614400, 614400};
+
+struct model {
+	struct ad7124_st_reg regs[AD7124_REG_NO];
+	bool restart;
+	double stall_us;
+	/* device */
+	uint16_t chip_mask;		/* enabled on the device, with the probe */
+	int32_t probe_value;		/* channel register of the spare on the device */
+	double now_us;
+	uint8_t converting;
+	double conversion_end;
+	bool unread;
+	uint8_t data_channel;
+	double data_time;
+	/* truth and what the stream counted */
+	uint32_t converted[16], read[16], missed[16];
+	uint32_t restarted, scans;
+	uint32_t discarded, discarded_late;	/* finished, lost to a restart */
+	/* corrected error per setup over the last quarter */
+	double error_sum[8];
+	uint32_t error_count[8];
+	double baseline_time[8];
+	bool had_baseline[8];
+};
+
+static double uniform(double low, double high)
+{
+	return low + (high - low) * rand() / (double)RAND_MAX;
+}
+
+static double gauss(void)
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double settling_us(const struct model *m, uint8_t ch)
+{
+	int32_t value = ch == ad7124_drift.probe_channel ? m->probe_value :
+			m->regs[AD7124_Channel_0 + ch].value;
+	uint8_t setup = (value >> 12) & 0x7;
+	int32_t filter = m->regs[AD7124_Filter_0 + setup].value;
+	int order = ((filter >> 21) & 0x7) == 0 ? 4 : 3;
+	uint8_t power = (m->regs[AD7124_ADC_Control].value >> 6) & 0x3;
+
+	return (order * 32.0 * (filter & 0x7FF) + 95) / mclk_hz[power] * 1e6;
+}
+
+static uint8_t next_enabled(uint16_t mask, uint8_t ch)
+{
+	for (uint8_t i = 1; i <= 16; i++) {
+		if (mask & (1 << ((ch + i) & 15)))
+			return (ch + i) & 15;
+	}
+	return ch;
+}
+
+static void start_conversion(struct model *m, uint8_t ch, double at_us)
+{
+	m->converting = ch;
+	m->conversion_end = at_us + settling_us(m, ch);
+}
+
+/* Runs the device up to now_us */
+static void advance(struct model *m)
+{
+	while (m->conversion_end <= m->now_us) {
+		m->converted[m->converting]++;
+		m->unread = true;
+		m->data_channel = m->converting;
+		m->data_time = m->conversion_end;
+		start_conversion(m, next_enabled(m->chip_mask, m->converting), m->conversion_end);
+	}
+}
+
+static double offset_codes(uint8_t setup, double at_us)
+{
+	return (setup + 1) * SIM_RAMP * at_us / 1e6;
+}
+
+/* drift_probe_write(): STATUS read, missed[] for a finished conversion, write */
+static void probe_write(struct model *m, struct ad7124_sequencer *seq, int32_t value)
+{
+	uint8_t probe = ad7124_drift.probe_channel;
+	bool seen;
+
+	m->now_us += SIM_READ_US;
+	advance(m);
+	seen = m->unread;
+	if (m->unread && seq->expected >= 0 && (seq->enabled_mask & (1 << m->data_channel))) {
+		for (uint8_t i = seq->expected; ; i = seq->following[i]) {
+			m->missed[i]++;
+			if (i == m->data_channel)
+				break;
+		}
+	}
+	m->now_us += SIM_WRITE_US;
+	advance(m);
+
+	m->probe_value = value;
+	if (value & AD7124_CH_MAP_REG_CH_ENABLE)
+		m->chip_mask |= 1 << probe;
+	else
+		m->chip_mask &= ~(1 << probe);
+	if (m->restart) {
+		if (m->unread) {
+			m->discarded++;
+			m->discarded_late += !seen;
+		}
+		m->unread = false;
+		m->restarted++;
+		start_conversion(m, next_enabled(m->chip_mask, 15), m->now_us);
+	}
+	ad7124_sequencer_restart(seq);
+}
+
+static void run(struct model *m, double seconds)
+{
+	struct ad7124_sequencer seq;
+	uint16_t mask = 0;
+	uint32_t samples = 0;
+
+	for (uint8_t ch = 0; ch < 16; ch++) {
+		if (m->regs[AD7124_Channel_0 + ch].value & AD7124_CH_MAP_REG_CH_ENABLE)
+			mask |= 1 << ch;
+	}
+	ad7124_drift_reset();
+	ad7124_drift_start(m->regs);
+	ad7124_sequencer_init(&seq, mask);
+	m->chip_mask = mask;
+	m->now_us = 0;
+	m->unread = false;
+	start_conversion(m, next_enabled(mask, 15), 0);
+
+	while (m->now_us < seconds * 1e6) {
+		uint8_t ch;
+		int32_t code;
+		int8_t setup;
+		struct ad7124_sequencer_gap gap;
+
+		// ad7124_wait_for_conv_ready() polls STATUS
+		m->now_us += SIM_POLL_US;
+		advance(m);
+		if (!m->unread) {
+			m->now_us = m->conversion_end + uniform(0, SIM_POLL_US);
+			advance(m);
+		}
+		ch = m->data_channel;
+		setup = (ch == ad7124_drift.probe_channel ? m->probe_value :
+			 m->regs[AD7124_Channel_0 + ch].value) >> 12 & 0x7;
+		code = SIM_SIGNAL + (ch == ad7124_drift.probe_channel ? 0 : 1000 * ch) +
+		       (int32_t)lround(offset_codes(setup, m->data_time) + SIM_NOISE * gauss());
+		m->now_us += SIM_READ_US;
+		m->unread = false;
+		m->read[ch]++;
+		advance(m);
+
+		if (ch == ad7124_drift.probe_channel && ad7124_drift.active_setup != AD7124_DRIFT_NONE) {
+			if (!ad7124_drift.has_baseline[setup]) {
+				m->baseline_time[setup] = m->data_time;
+				m->had_baseline[setup] = true;
+			}
+			ad7124_drift_probe_result(code);
+			probe_write(m, &seq, m->regs[AD7124_Channel_0 + ch].value);
+			continue;
+		}
+		if (!(mask & (1 << ch)))
+			continue;
+
+		code = ad7124_drift_correct(ch, code);
+		if (m->had_baseline[setup] && m->now_us > seconds * 0.75e6) {
+			m->error_sum[setup] += code - SIM_SIGNAL - 1000 * ch -
+					       offset_codes(setup, m->baseline_time[setup]);
+			m->error_count[setup]++;
+		}
+		gap = ad7124_sequencer_next(&seq, ch);
+		for (uint8_t i = gap.skipped ? gap.first : ch; i != ch; i = seq.following[i])
+			m->missed[i]++;
+
+		m->now_us += uniform(SIM_WORK_MIN_US, SIM_WORK_MAX_US);
+		if (++samples % SIM_STALL_EVERY == 0)
+			m->now_us += m->stall_us;
+		advance(m);
+
+		if (seq.following[ch] == seq.first) {
+			m->scans++;
+			if ((setup = ad7124_drift_scan_done()) != AD7124_DRIFT_NONE)
+				probe_write(m, &seq, ad7124_drift_probe_register(m->regs, setup).value);
+		}
+	}
+}
+
+static int report(const char *name, struct model *m, double seconds, double plain_scans)
+{
+	uint32_t lost = 0, missed = 0;
+	int failed = 0;
+
+	for (uint8_t ch = 0; ch < 16; ch++) {
+		if (ch == ad7124_drift.probe_channel)
+			continue;
+		lost += m->converted[ch] - m->read[ch];
+		missed += m->missed[ch];
+		failed |= m->converted[ch] - m->read[ch] != m->missed[ch];
+	}
+	printf("%s: %u scans, %u probes, %u conversions lost, %u counted in missed[], "
+	       "%u restarted, %u finished ones dropped by a write (%u after the STATUS "
+	       "read), scan rate %.2f %% below no probes\n", name, m->scans,
+	       ad7124_drift.probes, lost, missed, m->restarted, m->discarded,
+	       m->discarded_late, 100 * (1 - m->scans / plain_scans));
+	for (uint8_t setup = 0; setup < 8; setup++) {
+		// a setup is probed every interval * tracked setups scans
+		double period_s = seconds / (ad7124_drift.probes ? ad7124_drift.probes : 1) *
+				  __builtin_popcount(ad7124_drift.tracked);
+		double lag = (setup + 1) * SIM_RAMP * period_s * 7.5;
+		double error;
+
+		if (!m->error_count[setup])
+			continue;
+		error = m->error_sum[setup] / m->error_count[setup];
+		printf("  setup %u: ramp %.1f codes/s, error %.2f codes, low pass lag %.2f\n",
+		       setup, (setup + 1) * SIM_RAMP, error, lag);
+		failed |= fabs(error - lag) > 1 + 0.1 * lag;
+	}
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	static struct model m;
+	double seconds = 600, plain_scans;
+	int interval = 10, fs = -1, restart = -1, failed = 0;
+	double stall_us = 2000;
+	unsigned seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+			interval = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--fs") == 0 && i + 1 < argc)
+			fs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--stall-us") == 0 && i + 1 < argc)
+			stall_us = atof(argv[++i]);
+		else if (strcmp(argv[i], "--restart") == 0 && i + 1 < argc)
+			restart = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--seconds N] [--interval SCANS] [--fs N] "
+				"[--stall-us N] [--restart 0|1] [--seed N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	for (int r = 0; r <= 1; r++) {
+		if (restart >= 0 && r != restart)
+			continue;
+		memset(&m, 0, sizeof(m));
+		memcpy(m.regs, ad7124_regs_config_a, sizeof(m.regs));
+		for (uint8_t s = 0; s < 8 && fs > 0; s++)
+			m.regs[AD7124_Filter_0 + s].value = (m.regs[AD7124_Filter_0 + s].value &
+							     ~0x7FF) | fs;
+		m.restart = r;
+		m.stall_us = stall_us;
+
+		srand(seed);
+		ad7124_drift.interval = 0;
+		run(&m, seconds);
+		plain_scans = m.scans;
+
+		memset(m.converted, 0, sizeof(m) - offsetof(struct model, converted));
+		srand(seed);
+		ad7124_drift.interval = interval;
+		run(&m, seconds);
+		failed |= report(r ? "restart" : "no restart", &m, seconds, plain_scans);
+	}
+	return failed;
+}
@@ -0,0 +1,155 @@
+/*
+ * Host check of the integer stream formatting against printf.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -o ad7124_format_check \
+ *         tools/ad7124_format_check.c ad7124_format.c ad7124_support.c
+ *
+ * Usage:
+ *     ad7124_format_check [--pga N] [--bipolar 0|1]
+ *
+ * Formats every 24-bit code with ad7124_format_volts() and compares the
+ * bytes with "%.8f" of ad7124_convert_sample_to_voltage() itself, for all
+ * eight gains and both polarities unless --pga or --bipolar picks one. That
+ * is 2^28 codes and takes a minute or two. ad7124_format_int() is checked
+ * against "%i" and "%09d" at the int32 limits and around powers of ten.
+ * Then both paths are timed on the host; the 'U' menu item times them on
+ * the target. Exits nonzero on a mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ad7124_format.h"
+#include "ad7124_support.h"
+
+#define SIM_CODES		(1u << 24)
+#define SIM_BENCH_FIELDS	5000000
+
+static struct ad7124_st_reg regs[AD7124_REG_NO];
+static struct ad7124_dev dev = {regs, AD7124_DISABLE_CRC, 1, 25};
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Channel 0 on setup 0 with the gain and polarity to check */
+static void configure(uint8_t pga, bool bipolar)
+{
+	regs[AD7124_Channel_0].value = 0;
+	regs[AD7124_Config_0].value = AD7124_CFG_REG_PGA(pga) |
+				      (bipolar ? AD7124_CFG_REG_BIPOLAR : 0);
+}
+
+static long check_volts(uint8_t pga, bool bipolar)
+{
+	char expected[32], out[AD7124_FORMAT_FIELD_LEN];
+	long mismatches = 0;
+
+	configure(pga, bipolar);
+	for (uint32_t code = 0; code < SIM_CODES; code++) {
+		int n = snprintf(expected, sizeof(expected), "%.8f",
+				 ad7124_convert_sample_to_voltage(&dev, 0, code));
+		char *end = ad7124_format_volts(out, code, bipolar, pga);
+
+		if (end - out != n || memcmp(out, expected, n)) {
+			if (mismatches++ < 5)
+				printf("pga %u bipolar %d code %06lx: \"%s\", formatted \"%.*s\"\n",
+				       pga, bipolar, (unsigned long)code, expected,
+				       (int)(end - out), out);
+		}
+	}
+	printf("pga %u bipolar %d: %u codes, %ld mismatches\n", pga, bipolar, SIM_CODES,
+	       mismatches);
+	return mismatches;
+}
+
+static long check_int(int32_t value)
+{
+	char expected[32], out[AD7124_FORMAT_FIELD_LEN];
+	long mismatches = 0;
+
+	for (uint8_t width = 0; width <= 9; width += 9) {
+		int n = width ? snprintf(expected, sizeof(expected), "%09d", (int)value) :
+				snprintf(expected, sizeof(expected), "%i", (int)value);
+		char *end = ad7124_format_int(out, value, width);
+
+		if (end - out != n || memcmp(out, expected, n)) {
+			printf("int %ld width %u: \"%s\", formatted \"%.*s\"\n", (long)value, width,
+			       expected, (int)(end - out), out);
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+static void bench(void)
+{
+	char out[32];
+	volatile long sink = 0;
+	double start, printf_volts, format_volts, printf_int, format_int;
+
+	configure(1, true);
+	start = now_s();
+	for (uint32_t i = 0; i < SIM_BENCH_FIELDS; i++)
+		sink += snprintf(out, sizeof(out), "%.8f",
+				 ad7124_convert_sample_to_voltage(&dev, 0, 0x800000 + i * 3));
+	printf_volts = now_s() - start;
+	start = now_s();
+	for (uint32_t i = 0; i < SIM_BENCH_FIELDS; i++)
+		sink += ad7124_format_volts(out, 0x800000 + i * 3, true, 1) - out;
+	format_volts = now_s() - start;
+	start = now_s();
+	for (uint32_t i = 0; i < SIM_BENCH_FIELDS; i++)
+		sink += snprintf(out, sizeof(out), "%i", (int)(0x800000 + i * 3));
+	printf_int = now_s() - start;
+	start = now_s();
+	for (uint32_t i = 0; i < SIM_BENCH_FIELDS; i++)
+		sink += ad7124_format_int(out, 0x800000 + i * 3, 0) - out;
+	format_int = now_s() - start;
+
+	printf("host, ns per field: volts %.0f printf, %.0f formatted; codes %.0f printf, "
+	       "%.0f formatted\n", printf_volts / SIM_BENCH_FIELDS * 1e9,
+	       format_volts / SIM_BENCH_FIELDS * 1e9, printf_int / SIM_BENCH_FIELDS * 1e9,
+	       format_int / SIM_BENCH_FIELDS * 1e9);
+}
+
+int main(int argc, char **argv)
+{
+	int pga = -1, bipolar = -1;
+	long mismatches = 0;
+	int64_t power = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--pga") == 0 && i + 1 < argc)
+			pga = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--bipolar") == 0 && i + 1 < argc)
+			bipolar = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--pga N] [--bipolar 0|1]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	for (int p = 0; p < 8; p++) {
+		for (int b = 0; b < 2; b++) {
+			if ((pga < 0 || p == pga) && (bipolar < 0 || b == bipolar))
+				mismatches += check_volts(p, b);
+		}
+	}
+
+	mismatches += check_int(INT32_MAX) + check_int(INT32_MIN);
+	for (int e = 0; e < 10; e++, power *= 10) {
+		for (int32_t d = -1; d <= 1; d++)
+			mismatches += check_int(power + d) + check_int(-power - d);
+	}
+	printf("%ld mismatches\n", mismatches);
+	bench();
+	return mismatches != 0;
+}
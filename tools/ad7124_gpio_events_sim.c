@@ -0,0 +1,234 @@
+/*
+ * Host test of the GPIO edge capture with simulated pin toggles.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -o ad7124_gpio_events_sim \
+ *         tools/ad7124_gpio_events_sim.c ad7124_gpio_events.c -lm
+ *
+ * Usage:
+ *     ad7124_gpio_events_sim [--seconds N] [--seed N]
+ *
+ * Toggles the eight inputs at random, with pulses shorter than the
+ * interrupt latency so that both edges are latched, and runs the callback of
+ * ad7124_gpio_events.c when the simulated interrupt is serviced. A stream
+ * stamps a row every scan and, some time later, pops the edges up to the
+ * row's timestamp as the stream loop does. Checks that:
+ *   - no edge is lost or duplicated while the ring has room
+ *   - edges of a pin alternate and their levels match the pin
+ *   - no edge later than the row is printed in front of it, and none
+ *     at or before it is left behind
+ *   - a consumer that stops reading gets exactly the overflow counted
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ad7124_gpio_events.h"
+#include "ad7124_trace.h"
+
+/* Time from an edge to its interrupt, and the share of short pulses */
+#define SIM_LATENCY_MIN_US	3
+#define SIM_LATENCY_MAX_US	8
+#define SIM_SHORT_PULSE_PERCENT	5
+/* Mean time between edges of a pin */
+#define SIM_EDGE_MEAN_US	3000
+/* Scan period, and the time from stamping a row to printing it */
+#define SIM_SCAN_US		1000
+#define SIM_PRINT_DELAY_MAX_US	400
+
+struct pin {
+	uint64_t next_edge_us;		/* next toggle */
+	uint64_t service_us;		/* pending interrupt, 0 for none */
+	uint32_t latched;		/* edge flags waiting for it */
+	bool expect_rising;		/* next recorded edge */
+	long edges;
+};
+
+static struct pin pins[AD7124_GPIO_EVENT_PINS];
+static gpio_irq_callback_t callback;
+static uint64_t now_us;
+static uint32_t levels = 0xFF;
+static long serviced;
+
+uint64_t time_us_64(void)
+{
+	return now_us;
+}
+
+uint32_t gpio_get_all(void)
+{
+	return levels;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled,
+					gpio_irq_callback_t irq_callback)
+{
+	callback = irq_callback;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled)
+{
+}
+
+void ad7124_trace(enum ad7124_trace_event type, uint16_t arg)
+{
+}
+
+static uint64_t random_us(uint64_t low, uint64_t high)
+{
+	return low + (uint64_t)rand() % (high - low + 1);
+}
+
+static uint64_t next_gap_us(bool pending)
+{
+	// a pulse that ends before the interrupt of its first edge runs, a
+	// third edge before the interrupt would be lost in the hardware too
+	if (!pending && rand() % 100 < SIM_SHORT_PULSE_PERCENT)
+		return random_us(1, SIM_LATENCY_MIN_US - 1);
+	return SIM_LATENCY_MAX_US + 1 + (uint64_t)(-SIM_EDGE_MEAN_US *
+		log1p(-(rand() / (RAND_MAX + 1.0))));
+}
+
+/* Toggles the pins and services the interrupts up to and including a time */
+static void run_until(uint64_t until_us)
+{
+	for (;;) {
+		uint64_t next = UINT64_MAX;
+		uint8_t pin = 0;
+		bool service = false;
+
+		for (uint8_t i = 0; i < AD7124_GPIO_EVENT_PINS; i++) {
+			if (pins[i].next_edge_us < next) {
+				next = pins[i].next_edge_us;
+				pin = i;
+				service = false;
+			}
+			if (pins[i].service_us && pins[i].service_us <= next) {
+				next = pins[i].service_us;
+				pin = i;
+				service = true;
+			}
+		}
+		if (next > until_us) {
+			now_us = until_us;
+			return;
+		}
+		now_us = next;
+
+		if (service) {
+			uint32_t latched = pins[pin].latched;
+
+			pins[pin].service_us = 0;
+			pins[pin].latched = 0;
+			serviced += __builtin_popcount(latched);
+			callback(pin, latched);
+		} else {
+			bool rising = !(levels & (1 << pin));
+
+			levels ^= 1 << pin;
+			pins[pin].edges++;
+			pins[pin].latched |= rising ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+			if (!pins[pin].service_us) {
+				pins[pin].service_us = now_us +
+					random_us(SIM_LATENCY_MIN_US, SIM_LATENCY_MAX_US);
+				pins[pin].next_edge_us = now_us + next_gap_us(false);
+			} else {
+				pins[pin].next_edge_us = now_us + next_gap_us(true);
+			}
+		}
+	}
+}
+
+static int check_event(const struct ad7124_gpio_event *event, uint64_t row_us,
+		       uint64_t *last_us)
+{
+	struct pin *pin = &pins[event->pin];
+
+	if (event->pin >= AD7124_GPIO_EVENT_PINS || event->rising != pin->expect_rising ||
+	    !(event->levels & (1 << event->pin)) != !event->rising) {
+		printf("edge at %llu on pin %u out of order\n",
+		       (unsigned long long)event->timestamp_us, event->pin);
+		return 1;
+	}
+	if (event->timestamp_us > row_us || event->timestamp_us < *last_us) {
+		printf("edge at %llu printed with the row of %llu\n",
+		       (unsigned long long)event->timestamp_us, (unsigned long long)row_us);
+		return 1;
+	}
+	pin->expect_rising = !pin->expect_rising;
+	*last_us = event->timestamp_us;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct ad7124_gpio_event event;
+	double seconds = 60;
+	unsigned seed = 1;
+	uint64_t last_us = 0;
+	long edges = 0, recorded = 0, rows = 0;
+	uint32_t overflow;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--seconds N] [--seed N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(seed);
+	for (uint8_t i = 0; i < AD7124_GPIO_EVENT_PINS; i++)
+		pins[i].next_edge_us = 1 + next_gap_us(true);
+	ad7124_gpio_events_start();
+
+	for (uint64_t row_us = SIM_SCAN_US; row_us < seconds * 1e6; row_us += SIM_SCAN_US) {
+		long at_stamp;
+
+		// the row is stamped, edges keep coming until it is printed
+		run_until(row_us);
+		at_stamp = serviced;
+		run_until(row_us + random_us(0, SIM_PRINT_DELAY_MAX_US));
+		while (ad7124_gpio_events_pop_until(row_us, &event)) {
+			if (check_event(&event, row_us, &last_us))
+				return 1;
+			recorded++;
+		}
+		if (recorded != at_stamp) {
+			printf("row %llu: %ld edges up to it, %ld printed in front\n",
+			       (unsigned long long)row_us, at_stamp, recorded);
+			return 1;
+		}
+		rows++;
+	}
+	ad7124_gpio_events_stop();
+	while (ad7124_gpio_events_pop_until(UINT64_MAX, &event)) {
+		if (check_event(&event, UINT64_MAX, &last_us))
+			return 1;
+		recorded++;
+	}
+
+	for (uint8_t i = 0; i < AD7124_GPIO_EVENT_PINS; i++)
+		edges += pins[i].edges;
+	printf("%ld rows, %ld edges, %ld serviced, %ld recorded, %u dropped\n", rows, edges,
+	       serviced, recorded, ad7124_gpio_events_dropped());
+	if (serviced != recorded || ad7124_gpio_events_dropped())
+		return 1;
+
+	// a consumer that stops reading loses what does not fit the ring
+	ad7124_gpio_events_start();
+	for (int i = 0; i < AD7124_GPIO_EVENT_DEPTH + 100; i++) {
+		levels ^= 1;
+		callback(0, (levels & 1) ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL);
+	}
+	overflow = ad7124_gpio_events_dropped();
+	printf("%d edges into a full ring, %u dropped\n", AD7124_GPIO_EVENT_DEPTH + 100, overflow);
+	return overflow != 100;
+}
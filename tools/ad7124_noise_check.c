@@ -0,0 +1,215 @@
+/*
+ * Host check of the fixed point noise statistics against double precision.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -o ad7124_noise_check \
+ *         tools/ad7124_noise_check.c ad7124_noise.c ad7124_block.c ad7124_support.c -lm
+ *
+ * Usage:
+ *     ad7124_noise_check [--seed N]
+ *
+ * Feeds gaussian codes through ad7124_noise_add() and compares the summary
+ * with the same statistics in double: 540 cases, n from 1 to 2e6, rms from
+ * 0 to 30000 codes, offsets across the bipolar and unipolar range, with
+ * and without a step of 500 codes halfway. Cases whose sum of squares
+ * saturates must raise the overflow flag and are not compared. Then 20 s
+ * of four channels at 8 kHz scans, one conversion in 100 lost, go through
+ * the blocks and every valid code must be counted in a summary line.
+ * Exits nonzero if an error is above the output resolution of 0.01 or a
+ * code is missing.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ad7124_noise.h"
+#include "ad7124_block.h"
+#include "ad7124_stats.h"
+
+/* Largest errors allowed: codes, rms and nV relative to at least a code, bits */
+#define SIM_MEAN_MAX		0.011
+#define SIM_RMS_REL_MAX		0.0051
+#define SIM_BITS_MAX		0.011
+
+#define SIM_SCAN_US		125
+#define SIM_SCANS		160000
+
+struct ad7124_stats_core ad7124_stats_cores[AD7124_STATS_CORES];
+static uint32_t now_us;
+static long summary_counts, summary_lines;
+
+uint32_t time_us_32(void)
+{
+	return now_us;
+}
+
+absolute_time_t get_absolute_time(void)
+{
+	return now_us;
+}
+
+uint get_core_num(void)
+{
+	return 0;
+}
+
+/* Counts the samples of the "N" summary lines */
+void ad7124_usb_out_printf(const char *format, ...)
+{
+	unsigned long time_ms, channel, count;
+	char line[200];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	if (sscanf(line, "\nN, %lu, %lu, %lu", &time_ms, &channel, &count) == 3) {
+		summary_counts += count;
+		summary_lines++;
+	}
+}
+
+void ad7124_usb_out_write(const char *data, uint32_t len)
+{
+}
+
+void ad7124_usb_out_flush(void)
+{
+}
+
+static double gauss(void)
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double worst[6];
+static int overflows, failures;
+
+static void run_case(long n, double offset, double sigma, int step, uint8_t pga, bool bipolar)
+{
+	static const char *names[6] = {"mean", "rms", "peak-to-peak", "effective bits",
+				       "noise-free bits", "nV"};
+	static const double limits[6] = {SIM_MEAN_MAX, SIM_RMS_REL_MAX, 0, SIM_BITS_MAX,
+					 SIM_BITS_MAX, SIM_RMS_REL_MAX};
+	struct ad7124_noise_channel stats;
+	struct ad7124_noise_summary summary;
+	int32_t *codes = malloc(n * sizeof(*codes));
+	double sum = 0, squares = 0, min = INFINITY, max = -INFINITY;
+	double mean, rms, peak_to_peak, effective_bits, noise_free_bits, nv_per_code, rms_nv;
+	double error[6];
+
+	memset(&stats, 0, sizeof(stats));
+	for (long i = 0; i < n; i++) {
+		double value = offset + sigma * gauss() + (step && i > n / 2 ? step : 0);
+
+		codes[i] = (int32_t)fmax(-0xFFFFFF, fmin(0xFFFFFF, llround(value)));
+		sum += codes[i];
+		min = fmin(min, codes[i]);
+		max = fmax(max, codes[i]);
+		ad7124_noise_add(&stats, codes[i]);
+	}
+	mean = sum / n;
+	for (long i = 0; i < n; i++)
+		squares += (codes[i] - mean) * (codes[i] - mean);
+	free(codes);
+	if (stats.overflow) {
+		overflows++;
+		return;
+	}
+
+	rms = n > 1 ? sqrt(squares / (n - 1)) : 0;
+	peak_to_peak = max - min;
+	effective_bits = rms > 0 ? fmin(24, fmax(0, 24 - log2(rms))) : 24;
+	noise_free_bits = peak_to_peak > 0 ? fmin(24, 24 - log2(peak_to_peak)) : 24;
+	nv_per_code = (bipolar ? 5e9 : 2.5e9) / (1 << pga) / 16777216.0;
+	rms_nv = rms * nv_per_code;
+	ad7124_noise_summarize(&stats, pga, bipolar, &summary);
+
+	error[0] = fabs(summary.mean_x100 / 100.0 - mean);
+	error[1] = fabs(summary.rms_x100 / 100.0 - rms) / fmax(rms, 1);
+	error[2] = fabs(summary.peak_to_peak - peak_to_peak);
+	error[3] = fabs(summary.effective_bits_x100 / 100.0 - effective_bits);
+	error[4] = fabs(summary.noise_free_bits_x100 / 100.0 - noise_free_bits);
+	// the rms error, scaled, on top of the rounding to whole nV
+	error[5] = fmax(0, fabs(summary.rms_nv - rms_nv) - 0.5) / fmax(rms_nv, nv_per_code);
+	for (int k = 0; k < 6; k++) {
+		worst[k] = fmax(worst[k], error[k]);
+		if (error[k] > limits[k]) {
+			printf("n %ld offset %.0f sigma %.2f step %d pga %u bipolar %d: %s off by %g\n",
+			       n, offset, sigma, step, pga, bipolar, names[k], error[k]);
+			failures++;
+		}
+	}
+}
+
+/* Four channels through the blocks, every valid code must reach a summary */
+static int run_stream(void)
+{
+	struct ad7124_st_reg regs[AD7124_REG_NO];
+	long put = 0;
+
+	memset(regs, 0, sizeof(regs));
+	for (uint8_t ch = 0; ch < 4; ch++)
+		regs[AD7124_Channel_0 + ch].value = AD7124_CH_MAP_REG_CH_ENABLE;
+	regs[AD7124_Config_0].value = AD7124_CFG_REG_BIPOLAR | AD7124_CFG_REG_PGA(1);
+
+	ad7124_noise_begin(regs, AD7124_NOISE_DEFAULT_PERIOD_MS);
+	ad7124_block_start(0x000F);
+	for (long scan = 0; scan < SIM_SCANS; scan++) {
+		now_us += SIM_SCAN_US;
+		ad7124_block_row(now_us);
+		for (uint8_t ch = 0; ch < 4; ch++) {
+			bool valid = rand() % 100;
+
+			ad7124_block_put(ch, 0x800000 + (int32_t)(3 * gauss()), valid);
+			put += valid;
+		}
+		ad7124_noise_poll(now_us / 1000);
+	}
+	ad7124_block_flush();
+	ad7124_noise_end();
+
+	printf("stream: %ld valid codes put, %ld in %ld summary lines, %lu blocks dropped\n",
+	       put, summary_counts, summary_lines, (unsigned long)ad7124_blocks.dropped);
+	return summary_counts != put;
+}
+
+int main(int argc, char **argv)
+{
+	static const double sigmas[] = {0, 0.2, 0.5, 1, 3, 10, 100, 1000, 30000};
+	static const double offsets[] = {0, 1000, 0x800000, 0xFFF000, -5000};
+	static const long lengths[] = {1, 2, 10, 1000, 100000, 2000000};
+	unsigned seed = 7;
+	int cases = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--seed N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(seed);
+	for (int s = 0; s < 9; s++) {
+		for (int o = 0; o < 5; o++) {
+			for (int l = 0; l < 6; l++) {
+				for (int step = 0; step <= 500; step += 500, cases++)
+					run_case(lengths[l], offsets[o], sigmas[s], step,
+						 (s + l) & 7, o & 1);
+			}
+		}
+	}
+	printf("%d cases, %d with the overflow flag; largest errors: mean %.4f codes, rms %.5f, "
+	       "peak-to-peak %.0f, effective bits %.4f, noise-free bits %.4f, nV %.5f\n",
+	       cases, overflows, worst[0], worst[1], worst[2], worst[3], worst[4], worst[5]);
+	return run_stream() || failures;
+}
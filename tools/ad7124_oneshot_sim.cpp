@@ -0,0 +1,209 @@
+/*
+ * Host model of the single-conversion read latency.
+ *
+ * Build from the repository root, with the board's register map:
+ *     g++ -O2 -I. -Itools/host -DSIM_CONFIG='"config.stella.h"' \
+ *         -o ad7124_oneshot_sim tools/ad7124_oneshot_sim.cpp ad7124_timing.cpp \
+ *         -x c ad7124_oneshot.c
+ *
+ * Usage:
+ *     ad7124_oneshot_sim [--reads N] [--seed N] [--channels MASK]
+ *
+ * The device settles each channel of a single conversion sequence in
+ * (order * 32 * FS + 95) master clocks, the datasheet's formula for the
+ * sinc3/sinc4 filters with the zero latency dead time, at a clock with 1.5%
+ * sigma spread, clipped at the 5% the bound allows. It is written apart from
+ * the timing model the bound comes from. Every transfer takes its bus time at
+ * 500 kHz plus 1 to 6 us of CPU time. Reads start at random times and their
+ * latency from the call to the last data read is reported as a distribution
+ * next to ad7124_oneshot.worst_case_us. Without --channels the masks 0001,
+ * 0003 and 000F are run. Exits nonzero if a read fails, mixes up channels or
+ * takes longer than the bound.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "pico/stdlib.h"
+extern "C" {
+#include "ad7124_oneshot.h"
+}
+#ifndef SIM_CONFIG
+#define SIM_CONFIG "configuration.h"
+#endif
+#include SIM_CONFIG
+
+/* Master clock in full power, its spread and the CPU time per transfer */
+#define SIM_MCLK_HZ		614400.0
+#define SIM_CLOCK_SIGMA		0.015
+#define SIM_CLOCK_LIMIT		0.05
+#define SIM_CPU_MIN_US		1.0
+#define SIM_CPU_MAX_US		6.0
+#define SIM_SPI_US_PER_BYTE	16.0
+
+static const uint8_t mclk_divider[4] = {8, 4, 1, 1};	/* low, mid, full, full */
+
+static double now_us;
+static std::mt19937 rng(1);
+static std::vector<double> conversion_end;
+static std::vector<uint8_t> conversion_channel;
+static size_t next_conversion;
+
+extern "C" uint32_t time_us_32(void)
+{
+	return (uint32_t)(uint64_t)now_us;
+}
+
+static void bus(const struct ad7124_dev *dev, int32_t size)
+{
+	std::uniform_real_distribution<double> cpu(SIM_CPU_MIN_US, SIM_CPU_MAX_US);
+
+	now_us += (1 + size + (dev->use_crc != AD7124_DISABLE_CRC)) * SIM_SPI_US_PER_BYTE +
+		  cpu(rng);
+}
+
+static double settling_us(const struct ad7124_st_reg *regs, uint8_t ch, double mclk_hz)
+{
+	uint8_t setup = (regs[AD7124_Channel_0 + ch].value >> 12) & 0x7;
+	int32_t filter = regs[AD7124_Filter_0 + setup].value;
+	int order = ((filter >> 21) & 0x7) == 0 ? 4 : 3;
+
+	return (order * 32.0 * (filter & 0x7FF) + 95) / mclk_hz * 1e6;
+}
+
+/* A single conversion sequence starts with the mode write */
+static void start_sequence(const struct ad7124_st_reg *regs)
+{
+	std::normal_distribution<double> spread(0, SIM_CLOCK_SIGMA);
+	uint8_t power = (regs[AD7124_ADC_Control].value >> 6) & 0x3;
+	double mclk_hz = SIM_MCLK_HZ / mclk_divider[power] *
+			 (1 - std::clamp(spread(rng), -SIM_CLOCK_LIMIT, SIM_CLOCK_LIMIT));
+	double t = now_us;
+
+	conversion_end.clear();
+	conversion_channel.clear();
+	next_conversion = 0;
+	for (uint8_t ch = 0; ch < AD7124_ONESHOT_CHANNELS; ch++) {
+		if (!(regs[AD7124_Channel_0 + ch].value & AD7124_CH_MAP_REG_CH_ENABLE))
+			continue;
+		t += settling_us(regs, ch, mclk_hz);
+		conversion_end.push_back(t);
+		conversion_channel.push_back(ch);
+	}
+}
+
+extern "C" int32_t ad7124_no_check_write_register(struct ad7124_dev *dev,
+						  struct ad7124_st_reg reg)
+{
+	bus(dev, reg.size);
+	if (reg.addr == AD7124_ADC_CTRL_REG &&
+	    (reg.value & AD7124_ADC_CTRL_REG_MODE(0xF)) == AD7124_ADC_CTRL_REG_MODE(1))
+		start_sequence(dev->regs);
+	return 0;
+}
+
+extern "C" int32_t ad7124_write_register(struct ad7124_dev *dev, struct ad7124_st_reg reg)
+{
+	return ad7124_no_check_write_register(dev, reg);
+}
+
+extern "C" int32_t ad7124_no_check_read_register(struct ad7124_dev *dev,
+						 struct ad7124_st_reg *reg)
+{
+	bus(dev, reg->size);
+	if (reg->addr == AD7124_STATUS_REG) {
+		bool ready = next_conversion < conversion_end.size() &&
+			     now_us >= conversion_end[next_conversion];
+
+		reg->value = (ready ? 0 : AD7124_STATUS_REG_RDY) |
+			     (next_conversion < conversion_channel.size() ?
+			      conversion_channel[next_conversion] : 0);
+	} else if (reg->addr == AD7124_DATA_REG) {
+		// the code tells which conversion it came from
+		reg->value = 0x800000 + conversion_channel[next_conversion++];
+	}
+	return 0;
+}
+
+static int run(uint16_t mask, long reads)
+{
+	static struct ad7124_st_reg regs[AD7124_REG_NO];
+	struct ad7124_dev dev = {regs, AD7124_DISABLE_CRC, 1, 10000};
+	struct ad7124_oneshot_reading readings[AD7124_ONESHOT_CHANNELS];
+	std::uniform_real_distribution<double> idle(0, 1000);
+	std::vector<double> latency;
+	int failed = 0;
+
+	memcpy(regs, ad7124_regs_config_a, sizeof(regs));
+	if (ad7124_oneshot_prepare(&dev, mask) < 0) {
+		std::printf("mask %04x: prepare failed\n", mask);
+		return 1;
+	}
+	for (long i = 0; i < reads && !failed; i++) {
+		double start;
+		int32_t n;
+
+		now_us += idle(rng);
+		start = now_us;
+		n = ad7124_oneshot_read(&dev, readings);
+		if (n != ad7124_oneshot.count) {
+			std::printf("mask %04x read %ld: returned %ld\n", mask, i, (long)n);
+			failed = 1;
+			break;
+		}
+		for (int32_t k = 0; k < n; k++) {
+			if (readings[k].code != 0x800000 + readings[k].channel ||
+			    !(mask & (1 << readings[k].channel))) {
+				std::printf("mask %04x read %ld: channel %u got %06lx\n", mask, i,
+					    readings[k].channel, (unsigned long)readings[k].code);
+				failed = 1;
+			}
+		}
+		latency.push_back(now_us - start);
+	}
+	if (failed)
+		return 1;
+
+	std::sort(latency.begin(), latency.end());
+	std::printf("mask %04x, %2u ch | min %8.2f  median %8.2f  p99 %8.2f  max %8.2f | bound %8.2f ms\n",
+		    mask, ad7124_oneshot.count, latency.front() / 1000,
+		    latency[latency.size() / 2] / 1000, latency[latency.size() * 99 / 100] / 1000,
+		    latency.back() / 1000, ad7124_oneshot.worst_case_us / 1000.0);
+	failed = latency.back() > ad7124_oneshot.worst_case_us;
+	ad7124_oneshot_release(&dev);
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint16_t masks[] = {0x0001, 0x0003, 0x000F};
+	long reads = 20000;
+	unsigned seed = 1;
+	uint16_t mask = 0;
+	int failed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--reads") == 0 && i + 1 < argc)
+			reads = std::atol(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--channels") == 0 && i + 1 < argc)
+			mask = std::strtoul(argv[++i], nullptr, 16);
+		else {
+			std::fprintf(stderr, "usage: %s [--reads N] [--seed N] [--channels MASK]\n",
+				     argv[0]);
+			return 2;
+		}
+	}
+
+	rng.seed(seed);
+	if (mask)
+		return run(mask, reads);
+	for (uint16_t m : masks)
+		failed |= run(m, reads);
+	return failed;
+}
@@ -0,0 +1,80 @@
+/*
+ * Host side of the sample-rate planner.
+ *
+ * Build from the repository root:
+ *     g++ -std=c++17 -I. -o ad7124_plan tools/ad7124_plan.cpp ad7124_planner.cpp
+ *
+ * Usage:
+ *     ad7124_plan <rate Hz> [noise nV rms] [profile name]
+ *
+ * Plans the filters for the channels and setups of the board in
+ * configuration.h and prints the profile as hex, ready for the 'Upload
+ * profile' item of the register profile menu.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ad7124_planner.h"
+#include "ad7124_profile_store.h"
+#include "configuration.h"
+
+#define AD7124_CRC8_POLYNOMIAL	0x07
+
+static uint8_t crc8(const uint8_t *buf, size_t size)
+{
+	uint8_t crc = 0;
+
+	while (size--) {
+		crc ^= *buf++;
+		for (int i = 0; i < 8; i++)
+			crc = crc & 0x80 ? (crc << 1) ^ AD7124_CRC8_POLYNOMIAL : crc << 1;
+	}
+	return crc;
+}
+
+int main(int argc, char **argv)
+{
+	struct ad7124_st_reg regs[AD7124_REG_NO];
+	struct ad7124_profile profile;
+	struct ad7124_plan plan;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <rate Hz> [noise nV rms] [profile name]\n",
+			argv[0]);
+		return 2;
+	}
+
+	memcpy(regs, ad7124_regs_config_a, sizeof(regs));
+	if (ad7124_plan_filters(regs, (uint32_t)(atof(argv[1]) * 1000),
+				argc > 2 ? atoi(argv[2]) : 0, &plan) < 0) {
+		fprintf(stderr, "no filter setting meets the rate and noise budget\n");
+		return 1;
+	}
+	ad7124_plan_apply(&plan, regs);
+
+	printf("power mode %u, %s, FS %u, post filter %u\n", plan.power_mode,
+	       ad7124_plan_filter_name(&plan), plan.fs, plan.post_filter);
+	printf("%u.%03u Hz per channel, about %u nV rms\n",
+	       plan.channel_odr_mhz / 1000, plan.channel_odr_mhz % 1000, plan.noise_nv);
+
+	// same packing as ad7124_profile_from_map()
+	memset(&profile, 0, sizeof(profile));
+	profile.magic = AD7124_PROFILE_MAGIC;
+	strncpy(profile.name, argc > 3 ? argv[3] : "planned", AD7124_PROFILE_NAME_LEN - 1);
+	for (int i = 0; i < AD7124_PROFILE_REG_COUNT; i++) {
+		uint32_t value = regs[AD7124_PROFILE_FIRST_REG + i].value;
+
+		profile.values[i][0] = value >> 16;
+		profile.values[i][1] = value >> 8;
+		profile.values[i][2] = value;
+	}
+	profile.crc = crc8((const uint8_t *)&profile, offsetof(struct ad7124_profile, crc));
+
+	for (size_t i = 0; i < sizeof(profile); i++)
+		printf("%02x", ((const uint8_t *)&profile)[i]);
+	printf("\n");
+	return 0;
+}
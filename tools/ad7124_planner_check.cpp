@@ -0,0 +1,137 @@
+/*
+ * Host check of the planner's timing against the AD7124-8 datasheet.
+ *
+ * Build from the repository root:
+ *     g++ -std=c++17 -I. -o ad7124_planner_check tools/ad7124_planner_check.cpp \
+ *         ad7124_planner.cpp
+ *
+ * Usage:
+ *     ad7124_planner_check
+ *
+ * Every row is a filter type, power mode and FS (or post filter) with the
+ * output data rate and settling time from the datasheet's filter tables and
+ * equations, dead time included, rounded as the tables print them: the FS corners 1 and 2047 and the
+ * 50 Hz setting of each power mode for the sinc filters, the fast settling
+ * filters with their sinc1 average of 16 (8 in low power), and the four
+ * post filters. The setting goes into a one channel map through
+ * ad7124_plan_apply() and the rate and settling come from the same timing
+ * model the planner uses. With four channels the sequencer switches after
+ * every conversion, so each channel must then run at a quarter of
+ * 1/settling. A plan for each row's rate must give a setting at least that
+ * fast. Exits nonzero on any mismatch.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "ad7124_config_builder.hpp"
+#include "ad7124_planner.h"
+
+#define CHECK_ODR_TOLERANCE		0.002
+#define CHECK_SETTLING_TOLERANCE	0.005
+
+struct datasheet_row {
+	uint8_t power_mode;		/* ADC_Control POWER_MODE, 0 low, 1 mid, 2 full */
+	uint8_t filter;
+	uint16_t fs;			/* 0 for the post filters */
+	uint8_t post;
+	double odr_hz;
+	double settling_ms;
+};
+
+static const datasheet_row rows[] = {
+	// full power, 614.4 kHz
+	{2, ad7124::filter_sinc4, 1, 0, 19200, 0.363},
+	{2, ad7124::filter_sinc4, 384, 0, 50, 80.15},
+	{2, ad7124::filter_sinc4, 2047, 0, 9.38, 426.61},
+	{2, ad7124::filter_sinc3, 1, 0, 19200, 0.311},
+	{2, ad7124::filter_sinc3, 384, 0, 50, 60.15},
+	{2, ad7124::filter_sinc3, 2047, 0, 9.38, 320.00},
+	{2, ad7124::filter_sinc4_fast, 1, 0, 1010.5, 1.144},
+	{2, ad7124::filter_sinc4_fast, 20, 0, 50.53, 19.95},
+	{2, ad7124::filter_sinc3_fast, 1, 0, 1066.7, 1.092},
+	{2, ad7124::filter_sinc3_fast, 2047, 0, 0.521, 1919.0},
+	{2, ad7124::filter_post, 0, ad7124::post_27sps, 27.27, 36.67},
+	{2, ad7124::filter_post, 0, ad7124::post_25sps, 25, 40},
+	{2, ad7124::filter_post, 0, ad7124::post_20sps, 20, 50},
+	{2, ad7124::filter_post, 0, ad7124::post_16sps, 16.67, 60},
+	// mid power, 153.6 kHz
+	{1, ad7124::filter_sinc4, 1, 0, 4800, 1.035},
+	{1, ad7124::filter_sinc4, 96, 0, 50, 80.20},
+	{1, ad7124::filter_sinc4, 2047, 0, 2.345, 1706.0},
+	{1, ad7124::filter_sinc3, 96, 0, 50, 60.20},
+	{1, ad7124::filter_sinc4_fast, 5, 0, 50.53, 19.99},
+	{1, ad7124::filter_sinc3_fast, 1, 0, 266.7, 3.952},
+	{1, ad7124::filter_post, 0, ad7124::post_25sps, 25, 40},
+	{1, ad7124::filter_post, 0, ad7124::post_16sps, 16.67, 60},
+	// low power, 76.8 kHz
+	{0, ad7124::filter_sinc4, 1, 0, 2400, 1.914},
+	{0, ad7124::filter_sinc4, 48, 0, 50, 80.25},
+	{0, ad7124::filter_sinc4, 2047, 0, 1.172, 3411.9},
+	{0, ad7124::filter_sinc3, 48, 0, 50, 60.25},
+	{0, ad7124::filter_sinc3, 2047, 0, 1.172, 2559.0},
+	{0, ad7124::filter_sinc4_fast, 1, 0, 218.2, 4.831},
+	{0, ad7124::filter_sinc3_fast, 1, 0, 240, 4.414},
+	{0, ad7124::filter_post, 0, ad7124::post_27sps, 27.27, 36.67},
+	{0, ad7124::filter_post, 0, ad7124::post_20sps, 20, 50},
+};
+
+static bool close_to(double value, double expected, double tolerance)
+{
+	// the tables print three or four significant digits, rates are whole mHz
+	return std::fabs(value - expected) <= tolerance * expected + 0.001;
+}
+
+/* Built at compile time, config_error() is never defined */
+static constexpr ad7124::register_map board(unsigned channels)
+{
+	ad7124::config_builder builder;
+
+	builder.adc_control(0, 2, 0, AD7124_ADC_CTRL_REG_REF_EN)
+	       .setups(true, 2, 0);
+	for (uint8_t ch = 0; ch < channels; ch++)
+		builder.channel(ch, 0, 2 * ch, 2 * ch + 1);
+	return builder.build();
+}
+
+static constexpr ad7124::register_map one_channel = board(1);
+static constexpr ad7124::register_map four_channels = board(4);
+
+int main()
+{
+	int failed = 0;
+
+	std::printf("power filter      fs post | odr Hz     table | settling ms  table\n");
+	for (const datasheet_row &row : rows) {
+		ad7124::register_map one = one_channel, four = four_channels;
+		ad7124_plan setting{}, plan{};
+
+		setting.power_mode = row.power_mode;
+		setting.filter = row.filter;
+		setting.fs = row.fs;
+		setting.post_filter = row.post;
+		ad7124_plan_apply(&setting, one.data());
+		ad7124_plan_apply(&setting, four.data());
+
+		ad7124_timing single = ad7124::timing_of(one);
+		ad7124_timing scan = ad7124::timing_of(four);
+		double odr_hz = single.channel_odr_mhz / 1000.0;
+		double settling_ms = single.settling_us[0] / 1000.0;
+		double switched_hz = scan.channel_odr_mhz / 1000.0;
+		bool ok = close_to(odr_hz, row.odr_hz, CHECK_ODR_TOLERANCE) &&
+			  close_to(settling_ms, row.settling_ms, CHECK_SETTLING_TOLERANCE) &&
+			  close_to(switched_hz, 250 / row.settling_ms, CHECK_SETTLING_TOLERANCE);
+
+		// the planner must find something at least as fast for this rate
+		if (ad7124_plan_filters(one.data(), (uint32_t)(row.odr_hz * 1000 * 0.999), 0,
+					&plan) < 0 || plan.channel_odr_mhz < row.odr_hz * 1000 * 0.999)
+			ok = false;
+
+		std::printf("%5u %-10s %4u %4u | %9.3f %9.3f | %9.3f %9.3f  %s\n",
+			    row.power_mode, ad7124_plan_filter_name(&setting), row.fs, row.post,
+			    odr_hz, row.odr_hz, settling_ms, row.settling_ms, ok ? "" : "MISMATCH");
+		failed |= !ok;
+	}
+	return failed;
+}
@@ -0,0 +1,437 @@
+/*
+ * Host model of the stream recovery: time to recover and conversions lost.
+ *
+ * Build from the repository root, with the board's register map:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -c ad7124.c ad7124_snapshot.c \
+ *         ad7124_recovery.c
+ *     g++ -O2 -I. -Itools/host -DSIM_CONFIG='"config.stella.h"' \
+ *         -o ad7124_recovery_sim tools/ad7124_recovery_sim.cpp ad7124_timing.cpp \
+ *         ad7124.o ad7124_snapshot.o ad7124_recovery.o
+ *
+ * Usage:
+ *     ad7124_recovery_sim
+ *
+ * Links the driver, the burst restore and the recovery unchanged against a
+ * byte level model of the AD7124: frames with CRC, the 64 ones reset, the
+ * POR flag, factory gains trimmed off the nominal 0x500000 of the register
+ * table, a window after a reset in which the interface ignores writes
+ * and flags SPI_IGNORE, and a continuous sequence that restarts on a mode
+ * write and converts with the settling of the timing model. The bus runs
+ * at 500 kHz with 2 us per transfer on top. The stream loop of
+ * do_continuous_conversion() is reduced to its polls, reads and recovery
+ * calls; the offsets and gains the setup leaves alone are read back into
+ * the shadow map, as verify_register_image() does. Two faults are injected a second into a stream, with CRC on:
+ *   - a bit flipped in a data read, the CRC check fails (resync tier)
+ *   - a brown-out, the device is back at its power-on values (reset tier)
+ * For each the tool prints the tier, the time from the failed access to
+ * the end of ad7124_recover() and the conversions lost against a stream
+ * without the fault, and checks that the device kept its factory gains. The old path, ad7124_setup() and the calibration
+ * writes after which the stream stayed stopped, is timed for comparison.
+ * The boot is timed too: ad7124_setup() from power-on and the readback of
+ * the register image the app verifies. A device that never leaves the
+ * SPI_IGNORE state must fail the setup and leave the device pointer alone.
+ * Exits nonzero if a recovery, the gain check or the boot check fails.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+extern "C" {
+#include "ad7124_recovery.h"
+#include "ad7124_snapshot.h"
+}
+#include "ad7124_timing.h"
+#ifndef SIM_CONFIG
+#define SIM_CONFIG "configuration.h"
+#endif
+#include SIM_CONFIG
+
+/* Bus time per byte at 500 kHz and per transfer, the ignore window after a reset */
+#define SIM_SPI_US_PER_BYTE	16.0
+#define SIM_TRANSFER_US		2.0
+#define SIM_RESET_IGNORE_US	2000.0
+#define SIM_FAULT_AFTER_US	1e6
+
+static double now_us;
+
+/* Gains of the device at power-on, as trimmed in the factory */
+static const int32_t factory_gains[8] = {
+	0x4FE91B, 0x500A42, 0x4FF3C7, 0x50127E, 0x4FDD05, 0x5003B9, 0x4FF860, 0x501F2A
+};
+
+extern "C" {
+
+uint32_t time_us_32(void)
+{
+	return (uint32_t)(uint64_t)now_us;
+}
+
+uint64_t time_us_64(void)
+{
+	return (uint64_t)now_us;
+}
+
+absolute_time_t get_absolute_time(void)
+{
+	return (uint64_t)now_us;
+}
+
+void sleep_us(uint64_t us)
+{
+	now_us += us;
+}
+
+void sleep_ms(uint32_t ms)
+{
+	now_us += ms * 1000.0;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+}
+
+void gpio_set_function(uint gpio, uint fn)
+{
+}
+
+}
+
+struct device {
+	int32_t regs[AD7124_REG_NO];
+	int32_t size[AD7124_REG_NO];
+	double ignore_until_us;
+	double ignore_us;		/* window after a reset */
+	bool por;
+	double sequence_start_us;	/* < 0 when not converting */
+	std::vector<uint8_t> sequence;	/* enabled channels */
+	std::vector<double> settling_us;
+	long last_read;			/* conversion read last */
+	int corrupt_reads;		/* data reads to flip a bit in */
+	int ones;
+
+	bool crc() const
+	{
+		return regs[AD7124_Error_En] & AD7124_ERREN_REG_SPI_CRC_ERR_EN;
+	}
+
+	/* Conversions completed since the sequence started */
+	long done() const
+	{
+		double scan = 0, rest;
+		long scans, n;
+
+		if (sequence_start_us < 0 || sequence.empty())
+			return 0;
+		for (double s : settling_us)
+			scan += s;
+		scans = (long)((now_us - sequence_start_us) / scan);
+		rest = now_us - sequence_start_us - scans * scan;
+		n = scans * sequence.size();
+		for (double s : settling_us) {
+			if (rest < s)
+				break;
+			rest -= s;
+			n++;
+		}
+		return n;
+	}
+
+	/* A mode write restarts the sequence at the first channel */
+	void start()
+	{
+		struct ad7124_st_reg map[AD7124_REG_NO];
+		struct ad7124_timing timing;
+
+		sequence.clear();
+		settling_us.clear();
+		sequence_start_us = -1;
+		last_read = -1;
+		if (regs[AD7124_ADC_Control] & AD7124_ADC_CTRL_REG_MODE(0xF))
+			return;
+		for (int i = 0; i < AD7124_REG_NO; i++)
+			map[i] = {i, regs[i], size[i], AD7124_RW};
+		ad7124_timing_from_map(map, &timing);
+		for (uint8_t ch = 0; ch < AD7124_TIMING_CHANNELS; ch++) {
+			if (timing.settling_us[ch]) {
+				sequence.push_back(ch);
+				settling_us.push_back(timing.settling_us[ch]);
+			}
+		}
+		sequence_start_us = now_us;
+	}
+
+	void power_on()
+	{
+		memset(regs, 0, sizeof(regs));
+		regs[AD7124_ID] = 0x14;
+		for (int i = 0; i < 16; i++)
+			regs[AD7124_Channel_0 + i] = i == 0 ? 0x8001 : 0x0001;
+		for (int i = 0; i < 8; i++) {
+			regs[AD7124_Config_0 + i] = 0x0860;
+			regs[AD7124_Filter_0 + i] = 0x060180;
+			regs[AD7124_Offset_0 + i] = 0x800000;
+			regs[AD7124_Gain_0 + i] = factory_gains[i];
+		}
+		regs[AD7124_Error_En] = AD7124_ERREN_REG_SPI_IGNORE_ERR_EN;
+		ones = 0;
+		start();
+	}
+
+	void reset()
+	{
+		power_on();
+		por = true;
+		ignore_until_us = now_us + ignore_us;
+	}
+
+	uint32_t status()
+	{
+		long n = done();
+		uint32_t value = n > last_read + 1 ? 0 : AD7124_STATUS_REG_RDY;
+
+		if (n > 0)
+			value |= sequence[(n - 1) % sequence.size()];
+		if (por)
+			value |= AD7124_STATUS_REG_POR_FLAG;
+		return value;
+	}
+};
+
+static struct device device;
+
+/* One frame from tx[0], returns its length */
+static size_t frame(const uint8_t *tx, uint8_t *rx, size_t len)
+{
+	uint8_t command = tx[0], addr = AD7124_COMM_REG_RA(command), buf[6] = {command};
+	bool ignore = now_us < device.ignore_until_us;
+	bool crc = device.crc();
+	int32_t size = device.size[addr];
+	uint32_t value = 0;
+
+	rx[0] = 0xFF;
+	// 64 ones reset the interface, WEN high is no command
+	device.ones = command == 0xFF ? device.ones + 8 : 0;
+	if (device.ones >= 64) {
+		device.reset();
+		return 1;
+	}
+	if (command & 0x80)
+		return 1;
+
+	if (command & AD7124_COMM_REG_RD) {
+		if (addr == AD7124_STATUS_REG) {
+			value = device.status();
+			device.por = false;
+		} else if (addr == AD7124_DATA_REG) {
+			device.last_read = device.done() - 1;
+			value = 0x800000;
+			if (device.regs[AD7124_ADC_Control] & AD7124_ADC_CTRL_REG_DATA_STATUS) {
+				value = value << 8 | (device.status() & 0xFF);
+				size++;
+			}
+		} else {
+			value = device.regs[addr];
+			if (addr == AD7124_ERR_REG && ignore)
+				value |= AD7124_ERR_REG_SPI_IGNORE_ERR;
+		}
+		for (int32_t b = 0; b < size && 1 + b < (int32_t)len; b++)
+			rx[1 + b] = buf[1 + b] = value >> (8 * (size - 1 - b));
+		if (crc && 1 + size < (int32_t)len)
+			rx[1 + size] = ad7124_compute_crc8(buf, size + 1);
+		if (addr == AD7124_DATA_REG && device.corrupt_reads > 0 && len > 2) {
+			device.corrupt_reads--;
+			rx[2] ^= 0x10;
+		}
+	} else if (!ignore) {
+		for (int32_t b = 0; b < size && 1 + b < (int32_t)len; b++)
+			value = value << 8 | tx[1 + b];
+		device.regs[addr] = value;
+		if (addr == AD7124_ADC_CTRL_REG)
+			device.start();
+	}
+	return 1 + size + crc;
+}
+
+extern "C" int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst,
+				       size_t len)
+{
+	for (size_t i = 0; i < len;)
+		i += frame(src + i, dst + i, len - i);
+	now_us += len * SIM_SPI_US_PER_BYTE + SIM_TRANSFER_US;
+	return len;
+}
+
+static struct ad7124_st_reg regs[AD7124_REG_NO];
+
+struct result {
+	int32_t tier;
+	double recover_us;
+	long lost;
+	bool gains_kept;
+};
+
+static struct ad7124_dev *start_stream(struct ad7124_timing *timing)
+{
+	struct ad7124_init_param init = {regs, 10000};
+	struct ad7124_snapshot snapshot;
+	struct ad7124_dev *dev = NULL;
+
+	memcpy(regs, ad7124_regs_config_a, sizeof(regs));
+	regs[AD7124_Error_En].value |= AD7124_ERREN_REG_SPI_CRC_ERR_EN;
+	for (int i = 0; i < AD7124_REG_NO; i++)
+		device.size[i] = regs[i].size;
+	device.power_on();
+	device.por = false;
+	device.ignore_until_us = 0;
+	device.ignore_us = SIM_RESET_IGNORE_US;
+	if (ad7124_setup(&dev, init) < 0)
+		return NULL;
+	if (ad7124_snapshot_dump(dev, &snapshot) < 0) {
+		free(dev);
+		return NULL;
+	}
+	ad7124_snapshot_adopt_calibration(dev, &snapshot);
+	regs[AD7124_ADC_Control].value &= ~AD7124_ADC_CTRL_REG_MODE(0xF);
+	if (ad7124_write_register(dev, regs[AD7124_ADC_Control]) < 0)
+		return NULL;
+	ad7124_timing_from_map(regs, timing);
+	return dev;
+}
+
+/* The stream loop reduced to its polls, reads and recovery */
+static struct result stream_with_fault(bool brown_out)
+{
+	struct ad7124_timing timing;
+	struct ad7124_dev *dev = start_stream(&timing);
+	struct result result = {INVALID_VAL, 0, 0, false};
+	double fault_at_us = now_us + SIM_FAULT_AFTER_US, last_sample_us = now_us;
+	bool injected = false;
+
+	if (!dev)
+		return result;
+	while (now_us < fault_at_us + 3e6) {
+		int32_t faults = 0, ret, data;
+		double failed_at_us;
+
+		if (!injected && now_us >= fault_at_us) {
+			injected = true;
+			if (brown_out)
+				device.reset();
+			else
+				device.corrupt_reads = 1;
+		}
+		ret = ad7124_wait_for_conv_ready(dev, timing.conv_timeout_polls);
+		if (ret >= 0 && (regs[AD7124_Status].value & AD7124_STATUS_REG_POR_FLAG))
+			faults = AD7124_RECOVERY_POWER_ON;
+		if (ret >= 0 && !faults)
+			ret = ad7124_read_data(dev, &data);
+		if (ret >= 0 && !faults) {
+			last_sample_us = now_us;
+			continue;
+		}
+
+		failed_at_us = now_us;
+		result.tier = ad7124_recover(dev, faults);
+		result.recover_us = now_us - failed_at_us;
+		// against a stream that had gone on, up to the first new sample
+		if (result.tier < 0 || ad7124_wait_for_conv_ready(dev, timing.conv_timeout_polls) < 0 ||
+		    ad7124_read_data(dev, &data) < 0) {
+			result.tier = result.tier < 0 ? result.tier : COMM_ERR;
+			break;
+		}
+		result.lost = (long)((now_us - last_sample_us) * timing.channels /
+				     timing.scan_period_us) - 1;
+		result.gains_kept = true;
+		for (int i = 0; i < 8; i++)
+			result.gains_kept &= device.regs[AD7124_Gain_0 + i] == factory_gains[i];
+		break;
+	}
+	free(dev);
+	return result;
+}
+
+/* What a failed read led to before: setup again and the calibration writes */
+static double reinit_us(void)
+{
+	struct ad7124_init_param init = {regs, 10000};
+	struct ad7124_dev *dev = NULL;
+	double start_us = now_us;
+
+	memcpy(regs, ad7124_regs_config_a, sizeof(regs));
+	if (ad7124_setup(&dev, init) < 0)
+		return -1;
+	for (int i = AD7124_Offset_0; i <= AD7124_Gain_7; i++)
+		ad7124_write_register(dev, regs[i]);
+	free(dev);
+	return now_us - start_us;
+}
+
+/* Setup and readback from power-on, then a device stuck in SPI_IGNORE */
+static int boot(void)
+{
+	struct ad7124_init_param init = {regs, 10000};
+	struct ad7124_snapshot snapshot;
+	struct ad7124_dev *dev = NULL;
+	double start_us = now_us, setup_us;
+	int32_t ret, differing = 0;
+
+	memcpy(regs, ad7124_regs_config_a, sizeof(regs));
+	for (int i = 0; i < AD7124_REG_NO; i++)
+		device.size[i] = regs[i].size;
+	device.power_on();
+	device.ignore_us = SIM_RESET_IGNORE_US;
+	if ((ret = ad7124_setup(&dev, init)) < 0) {
+		std::printf("  boot: setup failed with %ld\n", (long)ret);
+		return 1;
+	}
+	setup_us = now_us - start_us;
+	start_us = now_us;
+	if ((ret = ad7124_snapshot_dump(dev, &snapshot)) < 0) {
+		std::printf("  boot: readback failed with %ld\n", (long)ret);
+		return 1;
+	}
+	for (uint8_t reg = AD7124_Status; reg < AD7124_Offset_0; reg++)
+		differing += (snapshot.differs[reg / 8] >> (reg % 8)) & 1;
+	std::printf("  boot: setup %6.0f us, readback %6.0f us, %ld registers differ\n",
+		    setup_us, now_us - start_us, (long)differing);
+	free(dev);
+
+	dev = NULL;
+	device.power_on();
+	device.ignore_us = 1e12;
+	ret = ad7124_setup(&dev, init);
+	std::printf("  boot, device stuck ignoring the bus: setup returns %ld, device %s\n",
+		    (long)ret, dev ? "set" : "left NULL");
+	return differing != 0 || ret >= 0 || dev != NULL;
+}
+
+int main()
+{
+	static const char *const faults[] = {"CRC error on a read", "brown-out"};
+	struct ad7124_timing timing;
+	int failed = 0;
+
+	ad7124_timing_from_map(ad7124_regs_config_a, &timing);
+	std::printf("%u channels, scan %lu us\n", timing.channels,
+		    (unsigned long)timing.scan_period_us);
+	for (int k = 0; k < 2; k++) {
+		struct result result = stream_with_fault(k == 1);
+
+		std::printf("  %-20s tier %ld  recover %8.0f us  lost %ld conversions, "
+			    "factory gains %s\n", faults[k], (long)result.tier, result.recover_us,
+			    result.lost, result.gains_kept ? "kept" : "overwritten");
+		failed |= result.tier < 0 || !result.gains_kept;
+	}
+	std::printf("  old path, setup and calibration writes %8.0f us, stream stopped\n",
+		    reinit_us());
+	failed |= boot();
+	return failed;
+}
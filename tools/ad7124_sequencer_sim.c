@@ -0,0 +1,143 @@
+/*
+ * Host simulation of conversions lost to a slow reader.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -o ad7124_sequencer_sim tools/ad7124_sequencer_sim.c \
+ *         ad7124_sequencer.c
+ *
+ * Usage:
+ *     ad7124_sequencer_sim [--reads N] [--seed N]
+ *
+ * An AD7124 in continuous mode converts the enabled channels in order, one
+ * conversion every period, and a new conversion overwrites one that was not
+ * read. The reader takes a random time per read with occasional long stalls
+ * and always gets the latest conversion, as the stream loop does. Every read
+ * goes through ad7124_sequencer_next() and the reported gap is checked
+ * against the conversions that were really lost: the skipped channels and
+ * their order as the stream walks them, and the repeated flag. Runs of a
+ * whole number of scans cannot be seen from the channel index and are
+ * counted apart. Exits nonzero on the first mismatch.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ad7124_sequencer.h"
+
+/* Reader time per read in conversion periods, and the stalls on top */
+#define SIM_READ_MIN		0.2
+#define SIM_READ_MAX		0.9
+#define SIM_STALL_PERCENT	5
+#define SIM_STALL_MAX		40.0
+
+struct totals {
+	long lost;
+	long detected;
+	long hidden;		/* lost in whole scans */
+	long repeats;
+};
+
+static double uniform(double low, double high)
+{
+	return low + (high - low) * rand() / (double)RAND_MAX;
+}
+
+static int run(uint16_t mask, long reads, struct totals *totals)
+{
+	struct ad7124_sequencer seq;
+	struct ad7124_sequencer_gap gap;
+	uint8_t order[AD7124_SEQUENCER_CHANNELS];
+	int n = 0;
+	long last = -1;
+	double now = 0;
+
+	for (uint8_t i = 0; i < AD7124_SEQUENCER_CHANNELS; i++) {
+		if (mask & (1 << i))
+			order[n++] = i;
+	}
+	ad7124_sequencer_init(&seq, mask);
+	memset(totals, 0, sizeof(*totals));
+
+	for (long r = 0; r < reads; r++) {
+		long index, lost;
+		uint16_t expected_mask = 0;
+		uint8_t channel;
+
+		// ready: the latest finished conversion, or the next one
+		index = (long)now;
+		if (index <= last)
+			index = last + 1;
+		if (now < index)
+			now = index;
+		lost = last < 0 ? 0 : index - last - 1;
+		channel = order[index % n];
+
+		gap = ad7124_sequencer_next(&seq, channel);
+		for (long k = lost - lost % n; k < lost; k++)
+			expected_mask |= 1 << order[(last + 1 + k) % n];
+
+		if (gap.skipped != expected_mask ||
+		    gap.repeated != (n > 1 && lost % n == n - 1)) {
+			printf("mask %04x read %ld: %ld lost, skipped %04x expected %04x, repeated %d\n",
+			       mask, r, lost, gap.skipped, expected_mask, gap.repeated);
+			return 1;
+		}
+		if (gap.skipped) {
+			// the stream fills the lost columns from first along following[]
+			long k = lost - lost % n;
+			uint8_t i;
+
+			for (i = gap.first; i != channel; i = seq.following[i], k++) {
+				if (i != order[(last + 1 + k) % n]) {
+					printf("mask %04x read %ld: walk gives channel %u, expected %u\n",
+					       mask, r, i, order[(last + 1 + k) % n]);
+					return 1;
+				}
+			}
+		}
+
+		totals->lost += lost;
+		totals->detected += __builtin_popcount(gap.skipped);
+		totals->hidden += lost - lost % n;
+		totals->repeats += gap.repeated;
+		last = index;
+		now += uniform(SIM_READ_MIN, SIM_READ_MAX);
+		if (rand() % 100 < SIM_STALL_PERCENT)
+			now += uniform(0, SIM_STALL_MAX);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint16_t masks[] = {0x0001, 0x0003, 0x0005, 0x000F, 0x8421, 0x00FF, 0xFFFF};
+	long reads = 1000000;
+	unsigned seed = 1;
+	int failed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--reads") == 0 && i + 1 < argc)
+			reads = atol(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--reads N] [--seed N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(seed);
+	for (size_t m = 0; m < sizeof(masks) / sizeof(masks[0]); m++) {
+		struct totals totals;
+
+		if (run(masks[m], reads, &totals)) {
+			failed = 1;
+			continue;
+		}
+		printf("mask %04x: %ld lost, %ld detected, %ld in whole scans, %ld repeats\n",
+		       masks[m], totals.lost, totals.detected, totals.hidden, totals.repeats);
+	}
+	return failed;
+}
@@ -0,0 +1,324 @@
+/*
+ * Host test of the register bursts against a model of the AD7124 framing.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -o ad7124_snapshot_sim \
+ *         tools/ad7124_snapshot_sim.c ad7124_snapshot.c ad7124.c
+ *
+ * Usage:
+ *     ad7124_snapshot_sim [--cases N] [--seed N] [--hardware-cs]
+ *
+ * The device model takes a byte at a time: a command, then the register's
+ * bytes and CRC if it is on, and drops a frame that CS ends early. The bus
+ * model lets an interrupt stall the core in the middle of transfers longer
+ * than the PL022 FIFO. With CSN on the SPI function the FIFO then runs empty
+ * and CSN goes high, as on the chip. Every case writes a random shadow map
+ * with ad7124_snapshot_restore(), half of them with CRC on, and checks the
+ * device registers and a dump against it. --hardware-cs leaves CSN on the
+ * SPI function through the bursts, to show the failure the GPIO hold avoids.
+ * Then a device at power-on, its gains trimmed off the nominal 0x500000 of
+ * the register table, is dumped, the offsets and gains taken into the shadow
+ * map as verify_register_image() does, and restored twice, once as it is and
+ * once after a reset; its gains must keep the trim both times. Exits nonzero
+ * on the first mismatch.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "ad7124_snapshot.h"
+#include "configuration.h"
+
+/* Transfers the FIFO holds whole, and the chance of a stall per byte */
+#define SIM_FIFO_DEPTH		8
+#define SIM_STALL_PERMILLE	5
+/* Largest trim of a factory gain off the nominal value */
+#define SIM_GAIN_TRIM		0x10000
+
+struct device {
+	uint32_t regs[AD7124_REG_NO];
+	bool crc;
+	bool selected;
+	uint8_t frame[6];
+	uint8_t out[6];
+	uint8_t pos;
+	uint8_t len;		/* bytes in the frame, command included */
+	uint8_t ones;		/* consecutive 0xFF bytes, eight reset */
+};
+
+static struct device device;
+static struct ad7124_st_reg shadow[AD7124_REG_NO];
+static uint32_t factory_gains[8];
+static uint csn_function = GPIO_FUNC_SPI;
+static bool csn_level = true;
+static bool hardware_cs;
+static long bursts, stalls, stalled_bursts, crc_errors;
+
+absolute_time_t get_absolute_time(void)
+{
+	return 0;
+}
+
+void sleep_us(uint64_t us)
+{
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+}
+
+static bool cs_high(void)
+{
+	// the PL022 drives CSN high between transfers
+	return csn_function == GPIO_FUNC_SPI ? true : csn_level;
+}
+
+static void cs_changed(bool was_high)
+{
+	if (!was_high && cs_high()) {
+		device.selected = false;
+		device.pos = 0;
+	}
+}
+
+void gpio_put(uint gpio, bool value)
+{
+	bool was_high = cs_high();
+
+	if (gpio == PICO_DEFAULT_SPI_CSN_PIN) {
+		csn_level = value;
+		cs_changed(was_high);
+	}
+}
+
+void gpio_set_function(uint gpio, uint fn)
+{
+	bool was_high = cs_high();
+
+	if (gpio != PICO_DEFAULT_SPI_CSN_PIN || (hardware_cs && fn == GPIO_FUNC_SIO))
+		return;
+	csn_function = fn;
+	cs_changed(was_high);
+}
+
+static void device_reset(void)
+{
+	memset(&device, 0, sizeof(device));
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++)
+		device.regs[i] = rand() & ((1u << (8 * shadow[i].size)) - 1);
+	device.regs[AD7124_Error] = 0;
+	device.regs[AD7124_Error_En] = AD7124_ERREN_REG_SPI_IGNORE_ERR_EN;
+}
+
+/* The board's registers, but the offsets and gains at their power-on values */
+static void device_power_on(void)
+{
+	memset(&device, 0, sizeof(device));
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++)
+		device.regs[i] = ad7124_regs_config_a[i].value;
+	for (uint8_t i = 0; i < 8; i++) {
+		device.regs[AD7124_Offset_0 + i] = 0x800000;
+		device.regs[AD7124_Gain_0 + i] = factory_gains[i];
+	}
+	device.regs[AD7124_Error] = 0;
+	device.regs[AD7124_Error_En] = AD7124_ERREN_REG_SPI_IGNORE_ERR_EN;
+}
+
+static uint8_t device_byte(uint8_t in)
+{
+	const struct ad7124_st_reg *reg;
+	uint8_t out = 0xFF;
+
+	// 64 ones reset the interface whatever frame it is in
+	device.ones = in == 0xFF ? device.ones + 1 : 0;
+	if (device.ones == 8) {
+		device_reset();
+		return out;
+	}
+
+	if (device.pos == 0) {
+		// WEN must be 0, the ones of a reset are not a command
+		if (in & 0x80)
+			return out;
+		reg = &shadow[AD7124_COMM_REG_RA(in)];
+		device.len = 1 + reg->size + device.crc;
+		device.frame[0] = in;
+		if (in & AD7124_COMM_REG_RD) {
+			uint32_t value = device.regs[reg->addr];
+
+			device.out[0] = in;
+			for (uint8_t b = 0; b < reg->size; b++)
+				device.out[1 + b] = value >> (8 * (reg->size - 1 - b));
+			if (device.crc)
+				device.out[1 + reg->size] = ad7124_compute_crc8(device.out,
+										reg->size + 1);
+		}
+		device.pos = 1;
+		return out;
+	}
+
+	reg = &shadow[AD7124_COMM_REG_RA(device.frame[0])];
+	device.frame[device.pos] = in;
+	if (device.frame[0] & AD7124_COMM_REG_RD)
+		out = device.out[device.pos];
+	if (++device.pos < device.len)
+		return out;
+
+	device.pos = 0;
+	if (!(device.frame[0] & AD7124_COMM_REG_RD)) {
+		uint32_t value = 0;
+
+		if (device.crc && ad7124_compute_crc8(device.frame, device.len) != 0) {
+			crc_errors++;
+			return out;
+		}
+		for (uint8_t b = 0; b < reg->size; b++)
+			value = value << 8 | device.frame[1 + b];
+		if (reg->rw == AD7124_RW)
+			device.regs[reg->addr] = value;
+		if (reg->addr == AD7124_ERREN_REG)
+			device.crc = value & AD7124_ERREN_REG_SPI_CRC_ERR_EN;
+	}
+	return out;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len)
+{
+	bool stalled = false;
+
+	if (len > SIM_FIFO_DEPTH)
+		bursts++;
+	for (size_t i = 0; i < len; i++) {
+		// an interrupt lets the TX FIFO run dry before this byte
+		if (len > SIM_FIFO_DEPTH && i > 0 && rand() % 1000 < SIM_STALL_PERMILLE) {
+			stalls++;
+			stalled = true;
+			if (csn_function == GPIO_FUNC_SPI) {
+				device.selected = false;
+				device.pos = 0;
+			}
+		}
+		if (!cs_high() || csn_function == GPIO_FUNC_SPI)
+			device.selected = true;
+		dst[i] = device.selected ? device_byte(src[i]) : 0xFF;
+	}
+	stalled_bursts += stalled;
+	if (csn_function == GPIO_FUNC_SPI) {
+		device.selected = false;
+		device.pos = 0;
+	}
+	return len;
+}
+
+static int run_case(int index)
+{
+	struct ad7124_dev dev = {shadow, AD7124_DISABLE_CRC, 1, 25};
+	struct ad7124_snapshot snapshot;
+	int32_t written, differing;
+
+	memcpy(shadow, ad7124_regs_config_a, sizeof(shadow));
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++) {
+		if (shadow[i].rw == AD7124_RW)
+			shadow[i].value = rand() & ((1u << (8 * shadow[i].size)) - 1);
+	}
+	shadow[AD7124_Error_En].value &= ~AD7124_ERREN_REG_SPI_CRC_ERR_EN;
+	if (rand() % 2)
+		shadow[AD7124_Error_En].value |= AD7124_ERREN_REG_SPI_CRC_ERR_EN;
+	device_reset();
+
+	written = ad7124_snapshot_restore(&dev);
+	if (written < 0) {
+		printf("case %d: restore failed with %ld\n", index, (long)written);
+		return 1;
+	}
+	for (uint8_t i = 0; i < AD7124_REG_NO; i++) {
+		if (shadow[i].rw == AD7124_RW && device.regs[i] != (uint32_t)shadow[i].value) {
+			printf("case %d: register %02x is %06lx, the shadow map has %06lx\n", index, i,
+			       (unsigned long)device.regs[i], (unsigned long)shadow[i].value);
+			return 1;
+		}
+	}
+	differing = ad7124_snapshot_dump(&dev, &snapshot);
+	if (differing != 0) {
+		printf("case %d: the dump gives %ld after the restore\n", index, (long)differing);
+		return 1;
+	}
+	if (cs_high() != true || csn_function != GPIO_FUNC_SPI) {
+		printf("case %d: CSN left low or off the SPI function\n", index);
+		return 1;
+	}
+	return 0;
+}
+
+/* A restore after boot and after a reset must keep the factory gains */
+static int run_power_on(void)
+{
+	struct ad7124_dev dev = {shadow, AD7124_DISABLE_CRC, 1, 25};
+	struct ad7124_snapshot snapshot;
+	int32_t ret;
+
+	memcpy(shadow, ad7124_regs_config_a, sizeof(shadow));
+	for (uint8_t i = 0; i < 8; i++)
+		factory_gains[i] = 0x500000 + rand() % (2 * SIM_GAIN_TRIM + 1) - SIM_GAIN_TRIM;
+	device_power_on();
+	if ((ret = ad7124_snapshot_dump(&dev, &snapshot)) < 0) {
+		printf("power-on: dump failed with %ld\n", (long)ret);
+		return 1;
+	}
+	ad7124_snapshot_adopt_calibration(&dev, &snapshot);
+
+	for (int round = 0; round < 2; round++) {
+		if (round == 1) {
+			// as after ad7124_reset(), CRC off on both sides
+			device_power_on();
+			dev.use_crc = AD7124_DISABLE_CRC;
+		}
+		if ((ret = ad7124_snapshot_restore(&dev)) < 0) {
+			printf("power-on: restore failed with %ld\n", (long)ret);
+			return 1;
+		}
+		for (uint8_t i = 0; i < 8; i++) {
+			if (device.regs[AD7124_Gain_0 + i] != factory_gains[i]) {
+				printf("power-on: gain %u is %06lx after the %s, the factory trim is "
+				       "%06lx\n", i, (unsigned long)device.regs[AD7124_Gain_0 + i],
+				       round ? "reset and restore" : "restore",
+				       (unsigned long)factory_gains[i]);
+				return 1;
+			}
+		}
+	}
+	printf("power-on: factory gains kept by the restore and after a reset\n");
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int cases = 2000;
+	unsigned seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc)
+			cases = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--hardware-cs") == 0)
+			hardware_cs = true;
+		else {
+			fprintf(stderr, "usage: %s [--cases N] [--seed N] [--hardware-cs]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(seed);
+	for (int i = 0; i < cases; i++) {
+		if (run_case(i))
+			return 1;
+	}
+	printf("%d cases, %ld bursts, %ld stalled %ld times, %ld CRC errors, device matches\n",
+	       cases, bursts, stalled_bursts, stalls, crc_errors);
+	return run_power_on();
+}
@@ -0,0 +1,134 @@
+/*
+ * Host check of the software tare.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -o ad7124_tare_check tools/ad7124_tare_check.c \
+ *         ad7124_tare.c -lm
+ *
+ * Usage:
+ *     ad7124_tare_check [--cases N] [--seed N]
+ *
+ * Streams random codes of 1 to 16 channels with bipolar and unipolar
+ * setups through ad7124_tare_apply() and retares in the middle of the
+ * stream. Every output code is compared with a reference in double
+ * precision: the raw code until the first average is complete, then
+ * code - round(mean of the averaged samples) + zero code, with the old
+ * baseline kept until the new average completes. Exits nonzero on the
+ * first mismatch.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ad7124_tare.h"
+
+struct reference {
+	double sum[AD7124_TARE_CHANNELS];
+	int count[AD7124_TARE_CHANNELS];
+	bool active[AD7124_TARE_CHANNELS];
+	bool pending[AD7124_TARE_CHANNELS];
+	long baseline[AD7124_TARE_CHANNELS];
+};
+
+static struct ad7124_st_reg regs[AD7124_REG_NO];
+
+static void reference_begin(struct reference *ref, uint16_t mask)
+{
+	for (int ch = 0; ch < AD7124_TARE_CHANNELS; ch++) {
+		if (!(mask & (1 << ch)))
+			continue;
+		ref->sum[ch] = 0;
+		ref->count[ch] = 0;
+		ref->pending[ch] = true;
+	}
+}
+
+static long reference_apply(struct reference *ref, int ch, int32_t code, int samples,
+			    long zero_code)
+{
+	if (ref->pending[ch]) {
+		ref->sum[ch] += code;
+		if (++ref->count[ch] == samples) {
+			ref->baseline[ch] = (long)floor(ref->sum[ch] / samples + 0.5);
+			ref->active[ch] = true;
+			ref->pending[ch] = false;
+		}
+	}
+	return ref->active[ch] ? code - ref->baseline[ch] + zero_code : code;
+}
+
+static int run_case(int index)
+{
+	struct reference ref;
+	uint16_t mask = 0, bipolar = rand() & 0xFF;
+	int samples = rand() % 4 ? 1 + rand() % 200 : 1 + rand() % 65535;
+	long rows = 3L * samples + rand() % 100;
+	int32_t level[AD7124_TARE_CHANNELS], spread;
+
+	while (!mask)
+		mask = rand() & 0xFFFF;
+	spread = 1 << (rand() % 24);
+	memset(&ref, 0, sizeof(ref));
+	for (int ch = 0; ch < AD7124_TARE_CHANNELS; ch++) {
+		regs[AD7124_Channel_0 + ch].value = (mask & (1 << ch)) ?
+			AD7124_CH_MAP_REG_CH_ENABLE | AD7124_CH_MAP_REG_SETUP(ch & 7) : 0;
+		level[ch] = rand() % (1 << 24);
+	}
+	for (int s = 0; s < 8; s++)
+		regs[AD7124_Config_0 + s].value = (bipolar & (1 << s)) ? AD7124_CFG_REG_BIPOLAR : 0;
+
+	ad7124_tare_clear();
+	ad7124_tare_begin(regs, samples);
+	reference_begin(&ref, mask);
+	for (long row = 0; row < rows; row++) {
+		// a retare halfway, the first baseline stays until it is done
+		if (row == rows / 2) {
+			ad7124_tare_begin(regs, samples);
+			reference_begin(&ref, mask);
+		}
+		for (int ch = 0; ch < AD7124_TARE_CHANNELS; ch++) {
+			long code, expected, tared;
+
+			if (!(mask & (1 << ch)))
+				continue;
+			code = level[ch] + rand() % spread - spread / 2;
+			code = code < 0 ? 0 : code > 0xFFFFFF ? 0xFFFFFF : code;
+			expected = reference_apply(&ref, ch, code, samples,
+						   (bipolar & (1 << (ch & 7))) ? 0x800000 : 0);
+			tared = ad7124_tare_apply(ch, code);
+			if (tared != expected) {
+				printf("case %d, row %ld, channel %d: %ld, expected %ld\n",
+				       index, row, ch, tared, expected);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int cases = 500;
+	unsigned seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc)
+			cases = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--cases N] [--seed N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(seed);
+	for (int i = 0; i < cases; i++) {
+		if (run_case(i))
+			return 1;
+	}
+	printf("%d cases, every tared code matches the reference\n", cases);
+	return 0;
+}
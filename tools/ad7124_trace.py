@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Render a trace exported with the 'Export trace' menu item.
+
+Usage:
+    ad7124_trace.py capture.txt [--width 100]
+    ad7124_trace.py /dev/ttyACM0 [--width 100]   (needs pyserial)
+
+Prints the CPU load per task and core, the time between pipeline events
+and an ASCII timeline with one row per core.
+"""
+
+import argparse
+import collections
+import sys
+
+# must match enum ad7124_trace_event in ad7124_trace.h
+TASK_IN, TASK_OUT, ISR_ENTER, ISR_EXIT, CONV_READY, SAMPLE_READ, OUTPUT, \
+    STREAM_START, STREAM_STOP, RECOVERY, USER = range(11)
+
+EVENT_NAMES = ["task_in", "task_out", "isr_enter", "isr_exit", "conv_ready",
+               "sample_read", "output", "stream_start", "stream_stop",
+               "recovery", "user"]
+
+TIMELINE_MARKS = {ISR_ENTER: "!", CONV_READY: "r", SAMPLE_READ: "s",
+                  OUTPUT: "o", STREAM_START: "[", STREAM_STOP: "]",
+                  RECOVERY: "R", USER: "u"}
+
+
+def read_lines(source):
+    if source.startswith("/dev/") or source.upper().startswith("COM"):
+        import serial
+        port = serial.Serial(source, timeout=5)
+        port.write(b"E")
+        while True:
+            line = port.readline().decode(errors="replace").strip()
+            if not line:
+                raise SystemExit("timeout waiting for the trace")
+            yield line
+            if line == "#trace end":
+                port.write(b" ")
+                return
+    with open(source, errors="replace") as capture:
+        for line in capture:
+            yield line.strip()
+
+
+def parse(lines):
+    tasks, events, inside = {}, [], False
+    for line in lines:
+        if line == "#trace begin":
+            inside = True
+        elif line == "#trace end":
+            break
+        elif not inside or not line:
+            continue
+        elif line.startswith("#task "):
+            _, number, name = line.split(maxsplit=2)
+            tasks[int(number)] = name
+        elif line[0].isdigit():
+            fields = line.split()
+            if len(fields) == 4:
+                events.append(tuple(int(f) for f in fields))
+    # unwrap the 32 bit microsecond timer
+    unwrapped, offset, last = [], 0, None
+    for timestamp, core, kind, arg in events:
+        if last is not None and timestamp < last and last - timestamp > 1 << 31:
+            offset += 1 << 32
+        last = timestamp
+        unwrapped.append((timestamp + offset, core, kind, arg))
+    return tasks, unwrapped
+
+
+def task_load(tasks, events):
+    busy = collections.defaultdict(int)
+    running = {}
+    for timestamp, core, kind, arg in events:
+        if kind == TASK_IN:
+            running[core] = (arg, timestamp)
+        elif kind == TASK_OUT and core in running:
+            task, since = running.pop(core)
+            busy[(core, task)] += timestamp - since
+    span = events[-1][0] - events[0][0] if events else 0
+    print("CPU load per task")
+    if not busy:
+        print("  no task switches recorded (scheduler not running?)")
+    for (core, task), us in sorted(busy.items()):
+        name = tasks.get(task, "task%d" % task)
+        print("  core %d %-16s %10d us %6.2f %%" % (core, name, us,
+                                                  100.0 * us / span if span else 0))
+
+
+def pipeline_latency(events):
+    print("Pipeline events")
+    counts = collections.Counter(kind for _, _, kind, _ in events)
+    for kind, count in sorted(counts.items()):
+        print("  %-12s %8d" % (EVENT_NAMES[kind] if kind < len(EVENT_NAMES) else kind, count))
+    ready = None
+    gaps = []
+    output_bytes = 0
+    for timestamp, _, kind, arg in events:
+        if kind == CONV_READY:
+            ready = timestamp
+        elif kind == SAMPLE_READ and ready is not None:
+            gaps.append(timestamp - ready)
+            ready = None
+        elif kind == OUTPUT:
+            output_bytes += arg
+    if gaps:
+        gaps.sort()
+        print("  ready->read us: min %d median %d max %d" %
+              (gaps[0], gaps[len(gaps) // 2], gaps[-1]))
+    if counts[OUTPUT]:
+        print("  output: %d bytes, %d per hand-off" %
+              (output_bytes, output_bytes // counts[OUTPUT]))
+
+
+def timeline(tasks, events, width):
+    if not events:
+        return
+    start, end = events[0][0], events[-1][0]
+    step = max(1, (end - start + width - 1) // width)
+    print("Timeline, %d us per column" % step)
+    for core in sorted({e[1] for e in events}):
+        row = [" "] * width
+        current = None
+        last_column = 0
+        for timestamp, event_core, kind, arg in events:
+            if event_core != core:
+                continue
+            column = min(width - 1, (timestamp - start) // step)
+            if current is not None:
+                for c in range(last_column, column):
+                    if row[c] == " ":
+                        row[c] = current
+            if kind == TASK_IN:
+                current = tasks.get(arg, str(arg))[:1] or "?"
+            elif kind == TASK_OUT:
+                current = None
+            elif kind in TIMELINE_MARKS:
+                row[column] = TIMELINE_MARKS[kind]
+            last_column = column
+        print("  core %d |%s|" % (core, "".join(row)))
+    print("  marks: " + ", ".join("%s=%s" % (m, EVENT_NAMES[k]) for k, m in TIMELINE_MARKS.items()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="capture file or serial port")
+    parser.add_argument("--width", type=int, default=100)
+    args = parser.parse_args()
+
+    tasks, events = parse(read_lines(args.source))
+    if not events:
+        sys.exit("no trace records found")
+    task_load(tasks, events)
+    pipeline_latency(events)
+    timeline(tasks, events, args.width)
+
+
+if __name__ == "__main__":
+    main()
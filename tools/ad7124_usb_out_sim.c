@@ -0,0 +1,162 @@
+/*
+ * Host check of the direct CDC output against the stdio byte stream.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -o ad7124_usb_out_sim \
+ *         tools/ad7124_usb_out_sim.c ad7124_usb_out.c
+ *
+ * Usage:
+ *     ad7124_usb_out_sim [--rows N] [--seed N]
+ *
+ * Writes stream rows of 4 channels, with lost conversion markers and
+ * trigger lines, through ad7124_usb_out and, as a reference, through the
+ * '\n' to "\r\n" translation pico stdio does. The CDC fifo holds 256 bytes
+ * and drains at random between writes, so flushes find it full at times.
+ * Checks that the bytes on the wire are identical and prints how the
+ * output was cut: the direct path's flushes and bytes per flush next to the
+ * printf calls of the stdio path, each of which pico_stdio_usb sends with a
+ * flush of its own. This shows the packet batching only, not throughput on
+ * the target; the 'U' menu item measures that. Exits nonzero on a
+ * difference or a dropped byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "ad7124_usb_out.h"
+#include "ad7124_trace.h"
+
+#define SIM_FIFO_SIZE		256
+#define SIM_DRAIN_MAX		200
+#define SIM_ROW_GAP_MAX_US	400
+
+static uint32_t now_us;
+static char *wire, *reference;
+static size_t wire_length, reference_length, capacity;
+static int fifo;
+static bool last_cr;
+static long stdio_calls;
+
+uint32_t time_us_32(void)
+{
+	// every call costs a microsecond, so a blocked flush times out
+	return ++now_us;
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+	return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+}
+
+void ad7124_trace(enum ad7124_trace_event type, uint16_t arg)
+{
+}
+
+bool tud_cdc_connected(void)
+{
+	return true;
+}
+
+uint32_t tud_cdc_write(const void *buffer, uint32_t size)
+{
+	uint32_t room;
+
+	fifo -= rand() % SIM_DRAIN_MAX;
+	if (fifo < 0)
+		fifo = 0;
+	room = SIM_FIFO_SIZE - fifo;
+	if (size > room)
+		size = room;
+	if (wire_length + size > capacity)
+		size = capacity - wire_length;
+	memcpy(wire + wire_length, buffer, size);
+	wire_length += size;
+	fifo += size;
+	return size;
+}
+
+uint32_t tud_cdc_write_flush(void)
+{
+	return 0;
+}
+
+/* The stdio path: one call, CRLF translated as pico stdio does */
+static void stdio_out(const char *text)
+{
+	stdio_calls++;
+	for (; *text && reference_length + 2 < capacity; text++) {
+		if (*text == '\n' && !last_cr)
+			reference[reference_length++] = '\r';
+		last_cr = *text == '\r';
+		reference[reference_length++] = *text;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const struct ad7124_usb_out_stats *stats = &ad7124_usb_out_stats;
+	long rows = 50000;
+	unsigned seed = 1;
+	char line[64];
+	bool identical;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+			rows = atol(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--rows N] [--seed N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(seed);
+	capacity = rows * 80 + 4096;
+	wire = malloc(capacity);
+	reference = malloc(capacity);
+	for (long r = 0; r < rows; r++) {
+		now_us += rand() % SIM_ROW_GAP_MAX_US;
+		snprintf(line, sizeof(line), "\n%09ld, %i, ", r, (int)(r & 0xFF));
+		stdio_out(line);
+		ad7124_usb_out_printf("\n%09ld, %i, ", r, (int)(r & 0xFF));
+		for (int ch = 0; ch < 4; ch++) {
+			if (ch) {
+				stdio_out(", ");
+				ad7124_usb_out_write(", ", 2);
+			}
+			if (r % 97 == ch) {
+				stdio_out("ovr");
+				ad7124_usb_out_write("ovr", 3);
+			} else {
+				snprintf(line, sizeof(line), "%.8f", (r * 7 + ch) / 1e5);
+				stdio_out(line);
+				ad7124_usb_out_printf("%.8f", (r * 7 + ch) / 1e5);
+			}
+		}
+		if (r % 5000 == 0) {
+			stdio_out("\nT, end\n");
+			ad7124_usb_out_write("\nT, end\n", 8);
+		}
+		ad7124_usb_out_poll();
+	}
+	ad7124_usb_out_flush();
+
+	identical = wire_length == reference_length && !memcmp(wire, reference, wire_length);
+	printf("%ld rows, %zu bytes, wire %s the stdio stream\n", rows, wire_length,
+	       identical ? "identical to" : "DIFFERS from");
+	printf("direct: %u flushes (%u full, %u on the timer), %u bytes per flush, "
+	       "%u waits, %u dropped\n", stats->flushes, stats->fill_flushes,
+	       stats->timer_flushes, stats->flushes ? stats->bytes / stats->flushes : 0,
+	       stats->waits, stats->dropped);
+	printf("stdio:  %ld calls, %zu bytes per call\n", stdio_calls,
+	       stdio_calls ? reference_length / stdio_calls : 0);
+	return !identical || stats->dropped;
+}
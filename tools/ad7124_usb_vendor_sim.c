@@ -0,0 +1,200 @@
+/*
+ * Host run of the vendor bulk stream against an endpoint that drains slowly.
+ *
+ * Build from the repository root:
+ *     gcc -O2 -std=gnu11 -I. -Itools/host -DAD7124_USB_VENDOR=1 \
+ *         -o ad7124_usb_vendor_sim tools/ad7124_usb_vendor_sim.c ad7124_usb_vendor.c
+ *
+ * Usage:
+ *     ad7124_usb_vendor_sim [--samples N] [--drain BYTES]
+ *
+ * The host starts the stream with 'S' and the stream puts a sample every
+ * 10 us, 4 channels, with a counting code, and polls every fourth sample.
+ * The 1 KiB endpoint fifo loses a fixed number of bytes to the host per
+ * poll; the stream needs 32.5. Without --drain the rates 0, 16, 28, 32, 36
+ * and 1024 bytes per poll are run, from a host that takes nothing to one
+ * faster than the stream.
+ * The frames on the wire are checked: magic, sequence without gaps and,
+ * with the dropped counts of the headers, every code accounted for as
+ * delivered or dropped, in order. A saturated count is taken from the
+ * codes and must be at least 65535. Exits nonzero on the first mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "ad7124_usb_vendor.h"
+#include "ad7124_command.h"
+#include "ad7124_trace.h"
+
+#define SIM_FIFO_SIZE		1024
+#define SIM_SAMPLE_US		10
+#define SIM_POLL_EVERY		4
+
+volatile uint32_t ad7124_command_head, ad7124_command_tail;
+
+static uint32_t now_us;
+static int fifo;
+static uint8_t *wire;
+static size_t wire_length, capacity;
+static bool start_request;
+
+uint32_t time_us_32(void)
+{
+	return now_us;
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+	return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+}
+
+void ad7124_trace(enum ad7124_trace_event type, uint16_t arg)
+{
+}
+
+int ad7124_command_take(void)
+{
+	return AD7124_COMMAND_NONE;
+}
+
+bool tusb_init(void)
+{
+	return true;
+}
+
+bool tud_vendor_mounted(void)
+{
+	return true;
+}
+
+uint32_t tud_vendor_available(void)
+{
+	return start_request;
+}
+
+uint32_t tud_vendor_read(void *buffer, uint32_t size)
+{
+	start_request = false;
+	*(uint8_t *)buffer = AD7124_USB_START;
+	return 1;
+}
+
+uint32_t tud_vendor_write_available(void)
+{
+	return SIM_FIFO_SIZE - fifo;
+}
+
+uint32_t tud_vendor_write(const void *buffer, uint32_t size)
+{
+	if (wire_length + size > capacity)
+		size = capacity - wire_length;
+	memcpy(wire + wire_length, buffer, size);
+	wire_length += size;
+	fifo += size;
+	return size;
+}
+
+uint32_t tud_vendor_write_flush(void)
+{
+	return 0;
+}
+
+static int run(long samples, int drain)
+{
+	const struct ad7124_usb_vendor_stats *stats = &ad7124_usb_vendor_stats;
+	long records = 0, dropped = 0;
+	uint16_t sequence = 0;
+	int32_t next = 0;
+
+	memset(&ad7124_usb_vendor_stats, 0, sizeof(ad7124_usb_vendor_stats));
+	wire_length = 0;
+	fifo = 0;
+	start_request = true;
+	ad7124_usb_vendor_init();
+	ad7124_usb_vendor_poll();
+	for (long i = 0; i < samples; i++) {
+		now_us += SIM_SAMPLE_US;
+		ad7124_usb_vendor_put(now_us, i & 3, i & 0xFFFFFF, 0);
+		if (i % SIM_POLL_EVERY == 0) {
+			fifo = fifo > drain ? fifo - drain : 0;
+			ad7124_usb_vendor_poll();
+		}
+	}
+	// the host reads everything while the stream stops
+	fifo = 0;
+	ad7124_usb_vendor_flush();
+
+	for (size_t offset = 0; offset < wire_length; offset += AD7124_USB_FRAME_SIZE) {
+		const struct ad7124_usb_frame *frame = (const void *)(wire + offset);
+
+		if (frame->magic != AD7124_USB_FRAME_MAGIC || frame->sequence != sequence) {
+			printf("frame at %zu: magic %04x sequence %u, expected %u\n", offset,
+			       frame->magic, frame->sequence, sequence);
+			return 1;
+		}
+		sequence++;
+		if (frame->dropped == UINT16_MAX && frame->count) {
+			int32_t skipped = (ad7124_usb_record_code(&frame->records[0]) - next) &
+					  0xFFFFFF;
+
+			if (skipped < UINT16_MAX) {
+				printf("frame %u: saturated count for %ld records\n",
+				       frame->sequence, (long)skipped);
+				return 1;
+			}
+			next += skipped;
+			dropped += skipped;
+		} else {
+			next += frame->dropped;
+			dropped += frame->dropped;
+		}
+		for (uint8_t r = 0; r < frame->count; r++, next++, records++) {
+			if (ad7124_usb_record_code(&frame->records[r]) != (next & 0xFFFFFF)) {
+				printf("frame %u record %u: code %06lx, expected %06lx\n",
+				       frame->sequence, r,
+				       (unsigned long)ad7124_usb_record_code(&frame->records[r]),
+				       (unsigned long)(next & 0xFFFFFF));
+				return 1;
+			}
+		}
+	}
+	printf("%5d bytes per poll: %ld delivered + %ld dropped = %ld of %ld, %u frames held, "
+	       "%u early\n", drain, records, dropped, records + dropped, samples,
+	       stats->held_frames, stats->early_frames);
+	// records dropped after the last frame are only in the stats
+	return records + (long)stats->dropped != samples || dropped > (long)stats->dropped;
+}
+
+int main(int argc, char **argv)
+{
+	static const int drains[] = {0, 16, 28, 32, 36, 1024};
+	long samples = 400000;
+	int chosen = -1, failed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			samples = atol(argv[++i]);
+		else if (strcmp(argv[i], "--drain") == 0 && i + 1 < argc)
+			chosen = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--samples N] [--drain BYTES]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	capacity = (samples / AD7124_USB_FRAME_RECORDS + 8) * AD7124_USB_FRAME_SIZE;
+	wire = malloc(capacity);
+	if (chosen >= 0)
+		return run(samples, chosen);
+	for (size_t d = 0; d < sizeof(drains) / sizeof(drains[0]); d++)
+		failed |= run(samples, drains[d]);
+	return failed;
+}
@@ -0,0 +1,21 @@
+/* Host stand-in, see tools/host/pico/stdlib.h */
+#ifndef TOOLS_HOST_HARDWARE_SPI_H_
+#define TOOLS_HOST_HARDWARE_SPI_H_
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spi_inst spi_inst_t;
+
+#define spi_default	((spi_inst_t *)0)
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TOOLS_HOST_HARDWARE_SPI_H_ */
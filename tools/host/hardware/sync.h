@@ -0,0 +1,2 @@
+/* Host stand-in, see tools/host/pico/stdlib.h */
+#include "pico/stdlib.h"
@@ -0,0 +1,75 @@
+/*
+ * Host stand-in for the parts of the Pico SDK that the firmware modules
+ * built by the host tools use. Only declarations: each tool defines the
+ * functions it needs with its own model of time, pins and the bus.
+ */
+
+#ifndef TOOLS_HOST_PICO_STDLIB_H_
+#define TOOLS_HOST_PICO_STDLIB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define __time_critical_func(f)	f
+#define __not_in_flash_func(f)	f
+
+#define GPIO_IN			0
+#define GPIO_OUT		1
+#define GPIO_FUNC_SPI		1
+#define GPIO_FUNC_SIO		5
+#define GPIO_IRQ_EDGE_FALL	0x4u
+#define GPIO_IRQ_EDGE_RISE	0x8u
+
+#define PICO_DEFAULT_SPI_SCK_PIN	18
+#define PICO_DEFAULT_SPI_TX_PIN		19
+#define PICO_DEFAULT_SPI_RX_PIN		16
+#define PICO_DEFAULT_SPI_CSN_PIN	17
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+absolute_time_t get_absolute_time(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t)
+{
+	return (uint32_t)(t / 1000);
+}
+
+static inline void tight_loop_contents(void)
+{
+}
+
+uint get_core_num(void);
+
+uint32_t gpio_get_all(void);
+void gpio_put(uint gpio, bool value);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_function(uint gpio, uint fn);
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled,
+					gpio_irq_callback_t callback);
+
+static inline void __dmb(void)
+{
+	__sync_synchronize();
+}
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TOOLS_HOST_PICO_STDLIB_H_ */
@@ -0,0 +1,31 @@
+/* Host stand-in for the TinyUSB device calls, see tools/host/pico/stdlib.h */
+#ifndef TOOLS_HOST_TUSB_H_
+#define TOOLS_HOST_TUSB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool tusb_init(void);
+void tud_task(void);
+
+bool tud_cdc_connected(void);
+uint32_t tud_cdc_write(const void *buffer, uint32_t size);
+uint32_t tud_cdc_write_flush(void);
+uint32_t tud_cdc_write_available(void);
+
+bool tud_vendor_mounted(void);
+uint32_t tud_vendor_available(void);
+uint32_t tud_vendor_read(void *buffer, uint32_t size);
+uint32_t tud_vendor_write(const void *buffer, uint32_t size);
+uint32_t tud_vendor_write_flush(void);
+uint32_t tud_vendor_write_available(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TOOLS_HOST_TUSB_H_ */
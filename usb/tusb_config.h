@@ -0,0 +1,34 @@
+/*!
+ *****************************************************************************
+  @file:  tusb_config.h
+
+  @brief: TinyUSB configuration of the composite device, CDC console and
+          vendor bulk stream
+
+  @details: Only on the include path with the AD7124_USB_VENDOR option,
+            otherwise pico_stdio_usb uses its own.
+ -----------------------------------------------------------------------------
+*/
+
+#ifndef _TUSB_CONFIG_H_
+#define _TUSB_CONFIG_H_
+
+#define CFG_TUSB_RHPORT0_MODE		OPT_MODE_DEVICE
+#define CFG_TUD_ENDPOINT0_SIZE		64
+
+#define CFG_TUD_CDC			1
+#define CFG_TUD_MSC			0
+#define CFG_TUD_HID			0
+#define CFG_TUD_MIDI			0
+#define CFG_TUD_VENDOR			1
+
+/* As pico_stdio_usb */
+#define CFG_TUD_CDC_RX_BUFSIZE		256
+#define CFG_TUD_CDC_TX_BUFSIZE		256
+
+/* Two 512 byte frames in flight, requests from the host are single bytes */
+#define CFG_TUD_VENDOR_EPSIZE		64
+#define CFG_TUD_VENDOR_TX_BUFSIZE	1024
+#define CFG_TUD_VENDOR_RX_BUFSIZE	64
+
+#endif /* _TUSB_CONFIG_H_ */
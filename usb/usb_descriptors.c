@@ -0,0 +1,110 @@
+/*!
+ *****************************************************************************
+  @file:  usb_descriptors.c
+
+  @brief: Descriptors of the composite device, CDC console and vendor bulk
+          stream
+
+  @details: Replace the ones of pico_stdio_usb with the AD7124_USB_VENDOR
+            option. The CDC interface is the same as the stdio one, so the
+            console and the 1200 baud reset to BOOTSEL keep working.
+ -----------------------------------------------------------------------------
+*/
+
+#include "tusb.h"
+#include "pico/unique_id.h"
+
+#include "ad7124_usb_frame.h"
+
+enum {
+	ITF_NUM_CDC = 0,
+	ITF_NUM_CDC_DATA,
+	ITF_NUM_VENDOR,
+	ITF_NUM_TOTAL
+};
+
+enum {
+	STRID_LANGID = 0,
+	STRID_MANUFACTURER,
+	STRID_PRODUCT,
+	STRID_SERIAL,
+	STRID_CDC,
+	STRID_VENDOR
+};
+
+#define EPNUM_CDC_NOTIF		0x81
+#define EPNUM_CDC_OUT		0x02
+#define EPNUM_CDC_IN		0x82
+
+#define CONFIG_TOTAL_LEN	(TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
+
+static const tusb_desc_device_t device_descriptor = {
+	.bLength = sizeof(tusb_desc_device_t),
+	.bDescriptorType = TUSB_DESC_DEVICE,
+	.bcdUSB = 0x0200,
+	// interface association, the CDC pair is a function of its own
+	.bDeviceClass = TUSB_CLASS_MISC,
+	.bDeviceSubClass = MISC_SUBCLASS_COMMON,
+	.bDeviceProtocol = MISC_PROTOCOL_IAD,
+	.bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+	.idVendor = AD7124_USB_VID,
+	.idProduct = AD7124_USB_PID,
+	.bcdDevice = 0x0100,
+	.iManufacturer = STRID_MANUFACTURER,
+	.iProduct = STRID_PRODUCT,
+	.iSerialNumber = STRID_SERIAL,
+	.bNumConfigurations = 1
+};
+
+static const uint8_t configuration_descriptor[] = {
+	TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 250),
+	TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT,
+			   EPNUM_CDC_IN, 64),
+	TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, STRID_VENDOR, AD7124_USB_EP_OUT,
+			      AD7124_USB_EP_IN, CFG_TUD_VENDOR_EPSIZE),
+};
+
+static const char *const strings[] = {
+	[STRID_MANUFACTURER] = "Raspberry Pi",
+	[STRID_PRODUCT] = "AD7124 acquisition",
+	[STRID_CDC] = "AD7124 console",
+	[STRID_VENDOR] = "AD7124 sample stream",
+};
+
+const uint8_t *tud_descriptor_device_cb(void)
+{
+	return (const uint8_t *)&device_descriptor;
+}
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index)
+{
+	(void)index;
+	return configuration_descriptor;
+}
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
+{
+	static uint16_t descriptor[1 + 32];
+	char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+	const char *string;
+	uint8_t len;
+
+	(void)langid;
+	if (index == STRID_LANGID) {
+		descriptor[1] = 0x0409;
+		len = 1;
+	} else {
+		if (index == STRID_SERIAL) {
+			pico_get_unique_board_id_string(serial, sizeof(serial));
+			string = serial;
+		} else if (index < sizeof(strings) / sizeof(strings[0]) && strings[index]) {
+			string = strings[index];
+		} else {
+			return NULL;
+		}
+		for (len = 0; string[len] && len < 32; len++)
+			descriptor[1 + len] = string[len];
+	}
+	descriptor[0] = (TUSB_DESC_STRING << 8) | (2 * len + 2);
+	return descriptor;
+}